@@ -254,12 +254,12 @@ void exportFuncs::export_depths(const char *filename, const bool selected_only)
 			continue;
 
 		FOR_EACH_PICTURE (dive) {
-			int n = dive->dc.samples;
-			struct sample *s = dive->dc.sample;
 			depth.mm = 0;
-			while (--n >= 0 && (int32_t)s->time.seconds <= picture->offset.seconds) {
-				depth.mm = s->depth.mm;
-				s++;
+			for (int n = 0; n < dive->dc.samples; n++) {
+				struct sample s = get_sample(&dive->dc, n);
+				if ((int32_t)s.time.seconds > picture->offset.seconds)
+					break;
+				depth.mm = s.depth.mm;
 			}
 			put_format(&buf, "%s\t%.1f", picture->filename, get_depth_units(depth.mm, NULL, &unit));
 			put_format(&buf, "%s\n", unit);
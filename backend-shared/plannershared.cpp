@@ -1,9 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "plannershared.h"
+#include "core/deco.h"
+#include "core/dive.h"
+#include "core/errorhelper.h"
+#include "core/file.h"
+#include "core/membuffer.h"
+#include "core/subsurface-string.h"
 #include "core/settings/qPrefDivePlanner.h"
 #include "core/settings/qPrefTechnicalDetails.h"
 #include "qt-models/diveplannermodel.h"
 #include "qt-models/cylindermodel.h"
+#include <QtConcurrent>
+#include <algorithm>
 
 plannerShared *plannerShared::instance()
 {
@@ -301,3 +309,173 @@ void plannerShared::set_display_variations(bool value)
 {
 	DivePlannerPointsModel::instance()->setDisplayVariations(value);
 }
+
+// Batch planning
+namespace {
+	// The preferences used by the batch, read once on the calling thread
+	struct MatrixSettings {
+		struct plan_config config;
+		int descrate;
+		pressure_t decopo2;
+	};
+
+	struct MatrixPlan {
+		PlanMatrixResult result;
+		gasmix bottomGas;
+		const std::vector<gasmix> *decoGases;
+		const MatrixSettings *settings;
+	};
+}
+
+static void computeMatrixPlan(MatrixPlan &matrixPlan)
+{
+	PlanMatrixResult &result = matrixPlan.result;
+	const MatrixSettings &settings = *matrixPlan.settings;
+	struct plan_config config = settings.config;
+	struct dive *dive = alloc_dive();
+	struct diveplan diveplan = {};
+	struct deco_state ds = {};
+	struct deco_state *cache = NULL;
+	struct decostop stoptable[60];
+
+	diveplan.salinity = SEAWATER_SALINITY;
+	diveplan.surface_pressure = SURFACE_PRESSURE;
+	diveplan.bottomsac = config.bottomsac;
+	diveplan.decosac = config.decosac;
+	diveplan.gflow = result.gflow;
+	diveplan.gfhigh = result.gfhigh;
+	diveplan.vpmb_conservatism = result.vpmbConservatism;
+
+	// Set the depth of the cylinders to the MOD, as reset_cylinders() would
+	get_or_create_cylinder(dive, 0)->gasmix = matrixPlan.bottomGas;
+	for (size_t i = 0; i < matrixPlan.decoGases->size(); i++)
+		get_or_create_cylinder(dive, i + 1)->gasmix = (*matrixPlan.decoGases)[i];
+	for (int i = 0; i < dive->cylinders.nr; i++) {
+		cylinder_t *cyl = get_cylinder(dive, i);
+		cyl->depth = gas_mod(cyl->gasmix, settings.decopo2, dive, config.metric_stops ? 3000 : feet_to_mm(10));
+	}
+	reset_cylinders(dive, true);
+	for (int i = 1; i < dive->cylinders.nr; i++)
+		plan_add_segment(&diveplan, 0, get_cylinder(dive, i)->depth.mm, i, 0, false, OC);
+	int descent = std::min(result.depth / settings.descrate, result.bottomTime);
+	plan_add_segment(&diveplan, descent, result.depth, 0, 0, true, OC);
+	plan_add_segment(&diveplan, result.bottomTime - descent, result.depth, 0, 0, true, OC);
+
+	config.deco.mode = result.decoMode;
+	plan(&ds, &diveplan, dive, &config, DECOTIMESTEP, stoptable, &cache, true, false);
+
+	result.runtime = dive->dc.duration.seconds;
+	for (const decostop *stop = stoptable; stop->depth; ++stop) {
+		if (stop->time)
+			result.stops.push_back(*stop);
+	}
+	for (int i = 0; i < dive->cylinders.nr; i++)
+		result.gasUsed.push_back(get_cylinder(dive, i)->gas_used.mliter);
+
+	free(cache);
+	free_dps(&diveplan);
+	free_dive(dive);
+}
+
+std::vector<PlanMatrixResult> plannerShared::computePlanMatrix(const PlanMatrix &matrix)
+{
+	struct DecoConfig {
+		deco_mode mode;
+		int gflow, gfhigh, conservatism;
+	};
+	std::vector<DecoConfig> configs;
+	for (const std::pair<int, int> &gf: matrix.gradientFactors)
+		configs.push_back({ BUEHLMANN, gf.first, gf.second, -1 });
+	for (int conservatism: matrix.vpmbConservatism)
+		configs.push_back({ VPMB, -1, -1, conservatism });
+
+	MatrixSettings settings;
+	init_plan_config(&settings.config, true);
+	settings.descrate = prefs.descrate;
+	settings.decopo2.mbar = prefs.decopo2;
+
+	static const std::vector<gasmix> noDecoGases;
+	int decoGasSets = std::max((int)matrix.decoGases.size(), 1);
+
+	std::vector<MatrixPlan> plans;
+	for (const DecoConfig &config: configs) {
+		for (size_t bottomGas = 0; bottomGas < matrix.bottomGases.size(); bottomGas++) {
+			for (int decoGases = 0; decoGases < decoGasSets; decoGases++) {
+				for (int depth: matrix.depths) {
+					for (int bottomTime: matrix.bottomTimes) {
+						MatrixPlan matrixPlan;
+						PlanMatrixResult &result = matrixPlan.result;
+						result.decoMode = config.mode;
+						result.gflow = config.gflow;
+						result.gfhigh = config.gfhigh;
+						result.vpmbConservatism = config.conservatism;
+						result.bottomGas = (int)bottomGas;
+						result.decoGases = matrix.decoGases.empty() ? -1 : decoGases;
+						result.depth = depth;
+						result.bottomTime = bottomTime;
+						result.runtime = 0;
+						matrixPlan.bottomGas = matrix.bottomGases[bottomGas];
+						matrixPlan.decoGases = matrix.decoGases.empty() ? &noDecoGases : &matrix.decoGases[decoGases];
+						matrixPlan.settings = &settings;
+						plans.push_back(std::move(matrixPlan));
+					}
+				}
+			}
+		}
+	}
+
+	QtConcurrent::blockingMap(plans, computeMatrixPlan);
+
+	std::vector<PlanMatrixResult> results;
+	results.reserve(plans.size());
+	for (MatrixPlan &matrixPlan: plans)
+		results.push_back(std::move(matrixPlan.result));
+	return results;
+}
+
+// One line per plan. Lists of stops and gases are separated by semicolons.
+void plannerShared::planMatrixToCSV(struct membuffer *b, const PlanMatrix &matrix, const std::vector<PlanMatrixResult> &results)
+{
+	const char *depth_unit, *volume_unit;
+	get_depth_units(0, NULL, &depth_unit);
+	get_volume_units(0, NULL, &volume_unit);
+
+	put_format(b, "model,gf_low,gf_high,conservatism,bottom_gas,deco_gases,depth [%s],bottom_time [min],runtime [min],stops [%s min],gas_used [%s]\n",
+		   depth_unit, depth_unit, volume_unit);
+	for (const PlanMatrixResult &result: results) {
+		if (result.decoMode == VPMB)
+			put_format(b, "VPM-B,,,%d,", result.vpmbConservatism);
+		else
+			put_format(b, "Buehlmann,%d,%d,,", result.gflow, result.gfhigh);
+		put_format(b, "%s,\"", gasname(matrix.bottomGases[result.bottomGas]));
+		if (result.decoGases >= 0) {
+			const std::vector<gasmix> &decoGases = matrix.decoGases[result.decoGases];
+			for (size_t i = 0; i < decoGases.size(); i++)
+				put_format(b, "%s%s", i ? "; " : "", gasname(decoGases[i]));
+		}
+		put_format(b, "\",%.0f,%d,%d:%02d,\"", get_depth_units(result.depth, NULL, NULL),
+			   result.bottomTime / 60, FRACTION(result.runtime, 60));
+		for (size_t i = 0; i < result.stops.size(); i++)
+			put_format(b, "%s%.0f %d:%02d", i ? "; " : "", get_depth_units(result.stops[i].depth, NULL, NULL),
+				   FRACTION(result.stops[i].time, 60));
+		put_string(b, "\",\"");
+		for (size_t i = 0; i < result.gasUsed.size(); i++)
+			put_format(b, "%s%.0f", i ? "; " : "", get_volume_units(result.gasUsed[i], NULL, NULL));
+		put_string(b, "\"\n");
+	}
+}
+
+void plannerShared::exportPlanMatrix(const char *filename, const PlanMatrix &matrix, const std::vector<PlanMatrixResult> &results)
+{
+	struct membuffer buf = {};
+	planMatrixToCSV(&buf, matrix, results);
+
+	FILE *f = subsurface_fopen(filename, "w+");
+	if (!f) {
+		report_error(qPrintable(tr("Can't open file %s")), filename);
+	} else {
+		flush_buffer(&buf, f);
+		fclose(f);
+	}
+	free_buffer(&buf);
+}
@@ -2,7 +2,36 @@
 #ifndef PLANNERSHARED_H
 #define PLANNERSHARED_H
 #include <QObject>
+#include <vector>
 #include "core/pref.h"
+#include "core/gas.h"
+#include "core/planner.h"
+
+// A grid of plans for contingency tables. Each combination of a deco model
+// configuration, bottom gas, set of deco gases, depth and bottom time is planned
+// as a single level open circuit dive. Everything else is taken from the planner
+// preferences. The deco gases are switched to at their MOD for the deco pO2.
+struct PlanMatrix {
+	std::vector<std::pair<int, int>> gradientFactors;	// GF low/high in %, planned with Bühlmann
+	std::vector<int> vpmbConservatism;			// planned with VPM-B
+	std::vector<gasmix> bottomGases;
+	std::vector<std::vector<gasmix>> decoGases;		// if empty, planned without deco gases
+	std::vector<int> depths;				// mm
+	std::vector<int> bottomTimes;				// seconds, including the descent
+};
+
+struct PlanMatrixResult {
+	deco_mode decoMode;
+	int gflow, gfhigh;			// Bühlmann only
+	int vpmbConservatism;			// VPM-B only
+	int bottomGas;				// index into PlanMatrix::bottomGases
+	int decoGases;				// index into PlanMatrix::decoGases, -1 if there are none
+	int depth;				// mm
+	int bottomTime;				// seconds
+	int runtime;				// seconds
+	std::vector<decostop> stops;		// stops of non-zero length, deepest first
+	std::vector<int> gasUsed;		// ml of the bottom gas, followed by the deco gases
+};
 
 // This is a shared class (mobile/desktop), and contains the core of the diveplanner
 // without UI entanglement.
@@ -96,6 +125,11 @@ public:
 	static bool verbatim_plan();
 	static bool display_variations();
 
+	// Batch planning, the plans are calculated in parallel
+	static std::vector<PlanMatrixResult> computePlanMatrix(const PlanMatrix &matrix);
+	static void planMatrixToCSV(struct membuffer *b, const PlanMatrix &matrix, const std::vector<PlanMatrixResult> &results);
+	static void exportPlanMatrix(const char *filename, const PlanMatrix &matrix, const std::vector<PlanMatrixResult> &results);
+
 public slots:
 	// Ascend/Descend data, converted to meter/feet depending on user selection
 	static void set_ascratelast6m(int value);
@@ -60,6 +60,7 @@ void DiveListBase::diveSiteCountChanged(struct dive_site *ds)
 // Returns pointer to added dive (which is owned by the backend!)
 dive *DiveListBase::addDive(DiveToAdd &d)
 {
+	pack_dive_samples(d.dive.get());	// The dives of the dive list keep their samples packed
 	if (d.trip)
 		add_dive_to_trip(d.dive.get(), d.trip);
 	if (d.site) {
@@ -162,6 +163,14 @@ DivesAndTripsToAdd DiveListBase::removeDives(DivesAndSitesToRemove &divesAndSite
 	if (oldShown != shown_dives)
 		emit diveListNotifier.numShownChanged();
 
+	// The removed dives are kept by the undo system until they are readded.
+	// They may outlive the loaded logbook, so move them out of the logbook arena.
+	// Edits may have unpacked their samples, so pack them again in the meantime.
+	for (DiveToAdd &entry: divesToAdd) {
+		detach_dive_from_arena(entry.dive.get());
+		pack_dive_samples(entry.dive.get());
+	}
+
 	return { std::move(divesToAdd), std::move(tripsToAdd), std::move(sitesToAdd) };
 }
 
@@ -4,6 +4,7 @@
 #include "core/divelist.h"
 #include "core/qthelper.h" // for copy_qstring
 #include "core/selection.h"
+#include "core/stringpool.h"
 #include "core/subsurface-string.h"
 #include "core/tag.h"
 #include "qt-models/weightsysteminfomodel.h"
@@ -165,8 +166,8 @@ DiveField EditNotes::fieldId() const
 // ***** Suit *****
 void EditSuit::set(struct dive *d, QString s) const
 {
-	free(d->suit);
-	d->suit = strdup(qPrintable(s));
+	release_string(d->suit);
+	d->suit = intern_qstring(s);
 }
 
 QString EditSuit::data(struct dive *d) const
@@ -382,7 +383,7 @@ void EditDuration::set(struct dive *d, int value) const
 	d->dc.duration.seconds = value;
 	d->duration = d->dc.duration;
 	d->dc.meandepth.mm = 0;
-	d->dc.samples = 0;
+	free_samples(&d->dc);
 }
 
 int EditDuration::data(struct dive *d) const
@@ -406,7 +407,7 @@ void EditDepth::set(struct dive *d, int value) const
 	d->dc.maxdepth.mm = value;
 	d->maxdepth = d->dc.maxdepth;
 	d->dc.meandepth.mm = 0;
-	d->dc.samples = 0;
+	free_samples(&d->dc);
 }
 
 int EditDepth::data(struct dive *d) const
@@ -715,8 +716,8 @@ QStringList EditBuddies::data(struct dive *d) const
 void EditBuddies::set(struct dive *d, const QStringList &v) const
 {
 	QString text = v.join(", ");
-	free(d->buddy);
-	d->buddy = copy_qstring(text);
+	release_string(d->buddy);
+	d->buddy = intern_qstring(text);
 }
 
 QString EditBuddies::fieldName() const
@@ -738,8 +739,8 @@ QStringList EditDiveMaster::data(struct dive *d) const
 void EditDiveMaster::set(struct dive *d, const QStringList &v) const
 {
 	QString text = v.join(", ");
-	free(d->divemaster);
-	d->divemaster = copy_qstring(text);
+	release_string(d->divemaster);
+	d->divemaster = intern_qstring(text);
 }
 
 QString EditDiveMaster::fieldName() const
@@ -755,7 +756,7 @@ DiveField EditDiveMaster::fieldId() const
 static void swapCandQString(QString &q, char *&c)
 {
 	QString tmp(c);
-	free(c);
+	release_string(c);
 	c = copy_qstring(q);
 	q = std::move(tmp);
 }
@@ -942,6 +943,10 @@ void ReplanDive::undo()
 	std::swap(d->salinity, salinity);
 	fixup_dive(d);
 
+	// The command now keeps the dive computers that were previously in the dive.
+	// They may outlive the loaded logbook, so move them out of the logbook arena.
+	detach_dc_from_arena(&dc);
+
 	QVector<dive *> divesToNotify = { d };
 	// Note that we have to emit cylindersReset before divesChanged, because the divesChanged
 	// updates the DivePlotDataModel, which is out-of-sync and gets confused.
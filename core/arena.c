@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0
+/* arena.c */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (1024 * 1024)
+
+/* Allocations are aligned suitably for any of the structures we put there */
+#define ARENA_ALIGN (sizeof(union { long double d; void *p; long long l; }))
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	char *pos, *end;
+};
+
+static size_t align_up(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static char *chunk_data(struct arena_chunk *chunk)
+{
+	return (char *)chunk + align_up(sizeof(struct arena_chunk));
+}
+
+static struct arena_chunk *new_chunk(struct arena *a, size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t chunk_size = a->chunk_size < ARENA_MIN_CHUNK ? ARENA_MIN_CHUNK : a->chunk_size;
+
+	/* Oversized allocations get a chunk of their own */
+	if (size > chunk_size)
+		chunk_size = size;
+	chunk = malloc(align_up(sizeof(struct arena_chunk)) + chunk_size);
+	if (!chunk)
+		exit(1);
+	chunk->pos = chunk_data(chunk);
+	chunk->end = chunk->pos + chunk_size;
+
+	/* Grow the chunks geometrically, so that large logbooks only need few of them */
+	if (a->chunk_size < ARENA_MAX_CHUNK)
+		a->chunk_size = a->chunk_size < ARENA_MIN_CHUNK ? 2 * ARENA_MIN_CHUNK : 2 * a->chunk_size;
+
+	chunk->next = a->chunks;
+	a->chunks = chunk;
+	return chunk;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+	struct arena_chunk *chunk = a->chunks;
+	void *res;
+
+	size = align_up(size ? size : 1);
+	if (!chunk || (size_t)(chunk->end - chunk->pos) < size)
+		chunk = new_chunk(a, size);
+	res = chunk->pos;
+	chunk->pos += size;
+	return res;
+}
+
+char *arena_strdup(struct arena *a, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *res = arena_alloc(a, len);
+	memcpy(res, s, len);
+	return res;
+}
+
+bool arena_owns(const struct arena *a, const void *p)
+{
+	const struct arena_chunk *chunk;
+	uintptr_t ptr = (uintptr_t)p;
+
+	for (chunk = a->chunks; chunk; chunk = chunk->next) {
+		if (ptr >= (uintptr_t)chunk && ptr < (uintptr_t)chunk->end)
+			return true;
+	}
+	return false;
+}
+
+/* Number of bytes handed out, for statistics and tests */
+size_t arena_size(const struct arena *a)
+{
+	const struct arena_chunk *chunk;
+	size_t res = 0;
+
+	for (chunk = a->chunks; chunk; chunk = chunk->next)
+		res += chunk->pos - chunk_data((struct arena_chunk *)chunk);
+	return res;
+}
+
+void arena_free_all(struct arena *a)
+{
+	struct arena_chunk *chunk = a->chunks;
+
+	while (chunk) {
+		struct arena_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	a->chunks = NULL;
+	a->chunk_size = 0;
+}
+
+static struct arena logbook_arena;
+
+/*
+ * The level is per thread: only the thread that loads the logbook allocates
+ * in the arena. Other threads, e.g. the planner and profile calculations,
+ * keep using malloc() while a logbook is being loaded.
+ */
+static _Thread_local int logbook_allocation_level;
+
+/* Calls may be nested. Outside of these calls, logbook_alloc() uses malloc(). */
+void begin_logbook_allocation(void)
+{
+	logbook_allocation_level++;
+}
+
+void end_logbook_allocation(void)
+{
+	if (logbook_allocation_level > 0)
+		logbook_allocation_level--;
+}
+
+void *logbook_alloc(size_t size)
+{
+	void *res;
+
+	if (logbook_allocation_level)
+		return arena_alloc(&logbook_arena, size);
+	res = malloc(size);
+	if (!res)
+		exit(1);
+	return res;
+}
+
+char *logbook_strdup(const char *s)
+{
+	char *res;
+
+	if (logbook_allocation_level)
+		return arena_strdup(&logbook_arena, s);
+	res = strdup(s);
+	if (!res)
+		exit(1);
+	return res;
+}
+
+bool logbook_owns(const void *p)
+{
+	return p && arena_owns(&logbook_arena, p);
+}
+
+/* Memory in the arena is released all at once by clear_logbook_arena() */
+void logbook_free(void *p)
+{
+	if (!logbook_owns(p))
+		free(p);
+}
+
+size_t logbook_arena_size(void)
+{
+	return arena_size(&logbook_arena);
+}
+
+/* Must only be called when no object of the logbook is left */
+void clear_logbook_arena(void)
+{
+	arena_free_all(&logbook_arena);
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Simple arena ("pool") allocator.
+ *
+ * Memory is handed out from large chunks by bumping a pointer. Single
+ * allocations are never freed, instead all memory of an arena is released
+ * at once with arena_free_all().
+ *
+ *     struct arena a = { 0 };
+ *     char *s = arena_strdup(&a, "something");
+ *     ...
+ *     arena_free_all(&a);
+ *
+ * The logbook arena is used for the many small objects (events, extra data)
+ * created while loading a logbook with parse_file(). These objects are owned
+ * by the loaded logbook and released in clear_dive_file_data(). Only the
+ * thread that loads the logbook allocates in the arena. Code that
+ * frees such objects must use logbook_free(), which ignores pointers into the
+ * arena. Objects that may outlive the logbook, such as dives kept by the undo
+ * system, have to be moved out of the arena first (see detach_dive_from_arena()).
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct arena_chunk;
+
+struct arena {
+	struct arena_chunk *chunks;	/* most recently allocated chunk first */
+	size_t chunk_size;		/* size of the next chunk to allocate */
+};
+
+extern void *arena_alloc(struct arena *a, size_t size);
+extern char *arena_strdup(struct arena *a, const char *s);
+extern bool arena_owns(const struct arena *a, const void *p);
+extern size_t arena_size(const struct arena *a);
+extern void arena_free_all(struct arena *a);
+
+/* The arena of the currently loaded logbook */
+extern void begin_logbook_allocation(void);
+extern void end_logbook_allocation(void);
+extern void *logbook_alloc(size_t size);
+extern char *logbook_strdup(const char *s);
+extern bool logbook_owns(const void *p);
+extern void logbook_free(void *p);
+extern size_t logbook_arena_size(void);
+extern void clear_logbook_arena(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENA_H
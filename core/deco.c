@@ -9,6 +9,8 @@
  * (C) Robert C. Helling 2013 and released under the GPLv2
  *
  * add_segment()	- add <seconds> at the given pressure, breathing gasmix
+ * add_segment_linear() - add <seconds> of a linear change of pressure, breathing gasmix
+ * ceiling_crossing_time() - estimated time at a pressure until the ceiling crosses a limit
  * deco_allowed_depth() - ceiling based on lead tissue, surface pressure, 3m increments or smooth
  * set_gf()		- set Buehlmann gradient factors
  * set_vpmb_conservatism() - set VPM-B conservatism value
@@ -20,6 +22,9 @@
 #include <math.h>
 #include <string.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "deco.h"
 #include "ssrf.h"
@@ -38,25 +43,23 @@
 #define subsurface_conservatism_factor 1.0
 
 //! Option structure for Buehlmann decompression.
+//! The gradient factors are set per calculation, see struct deco_config.
 struct buehlmann_config {
 	double satmult;			//! safety at inert gas accumulation as percentage of effect (more than 100).
 	double desatmult;		//! safety at inert gas depletion as percentage of effect (less than 100).
 	int last_deco_stop_in_mtr;	//! depth of last_deco_stop.
-	double gf_high;			//! gradient factor high (at surface).
-	double gf_low;			//! gradient factor low (at bottom/start of deco calculation).
 	double gf_low_position_min;	//! gf_low_position below surface_min_shallow.
 };
 
-struct buehlmann_config buehlmann_config = {
+static const struct buehlmann_config buehlmann_config = {
 	.satmult = 1.0,
 	.desatmult = 1.0,
 	.last_deco_stop_in_mtr =  0,
-	.gf_high = 0.75,
-	.gf_low = 0.35,
 	.gf_low_position_min = 1.0,
 };
 
 //! Option structure for VPM-B decompression.
+//! The conservatism is set per calculation, see struct deco_config.
 struct vpmb_config {
 	double crit_radius_N2;            //! Critical radius of N2 nucleon (microns).
 	double crit_radius_He;            //! Critical radius of He nucleon (microns).
@@ -66,10 +69,9 @@ struct vpmb_config {
 	double skin_compression_gammaC;   //! Skin compression gammaC (N / bar = m2).
 	double regeneration_time;         //! Time needed for the bubble to regenerate to the start radius (min).
 	double other_gases_pressure;      //! Always present pressure of other gasses in tissues (bar).
-	short conservatism;		  //! VPM-B conservatism level (0-4)
 };
 
-static struct vpmb_config vpmb_config = {
+static const struct vpmb_config vpmb_config = {
 	.crit_radius_N2 = 0.55,
 	.crit_radius_He = 0.45,
 	.crit_volume_lambda = 199.58,
@@ -77,8 +79,7 @@ static struct vpmb_config vpmb_config = {
 	.surface_tension_gamma = 0.18137175,	// = 0.0179 N/msw
 	.skin_compression_gammaC = 2.6040525,	// = 0.257 N/msw
 	.regeneration_time = 20160.0,
-	.other_gases_pressure = 0.1359888,
-	.conservatism = 3
+	.other_gases_pressure = 0.1359888
 };
 
 static const double buehlmann_N2_a[] = { 1.1696, 1.0, 0.8618, 0.7562,
@@ -155,20 +156,26 @@ static const double vpmb_conservatism_lvls[] = { 1.0, 1.05, 1.12, 1.22, 1.35 };
 
 #define TISSUE_ARRAY_SZ sizeof(ds->tissue_n2_sat)
 
-static double get_crit_radius_He()
+static double get_crit_radius_He(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->config.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[ds->config.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_He;
 }
 
-static double get_crit_radius_N2()
+static double get_crit_radius_N2(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->config.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[ds->config.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_N2;
 }
 
+/* Planned VPM-B dives use the Schreiner value */
+static double water_vapour_pressure(const struct deco_state *ds)
+{
+	return ds->config.planner && ds->config.mode == VPMB ? WV_PRESSURE_SCHREINER : WV_PRESSURE;
+}
+
 // Solve another cubic equation, this time
 // x^3 - B x - C == 0
 // Use trigonometric formula for negative discriminants (see Wikipedia for details)
@@ -221,8 +228,8 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
-	double gf_low = buehlmann_config.gf_low;
+	double gf_high = ds->config.gf_high;
+	double gf_low = ds->config.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
 	double tissue_lowest_ceiling[16];
@@ -232,7 +239,7 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
 	}
 
-	if (decoMode() != VPMB) {
+	if (ds->config.mode != VPMB) {
 		for (ci = 0; ci < 16; ci++) {
 
 			/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
@@ -322,9 +329,9 @@ static double factor(int period_in_seconds, int ci, enum inertgas gas)
 	return factor;
 }
 
-static double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
+static double calc_surface_phase(double surface_pressure, double wv_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
 {
-	double inspired_n2 = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	double inspired_n2 = (surface_pressure - wv_pressure) * NITROGEN_FRACTION;
 
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
@@ -357,7 +364,7 @@ void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_
 	deco_time /= 60.0;
 
 	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
+		desat_time = deco_time + calc_surface_phase(surface_pressure, water_vapour_pressure(ds), ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
 
 		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
 		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
@@ -401,11 +408,11 @@ void nuclear_regeneration(struct deco_state *ds, double time)
 	double crushing_radius_N2, crushing_radius_He;
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2(ds));
+		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He(ds));
 		//rs
-		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2(ds) - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He(ds) - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
 	}
 }
 
@@ -445,8 +452,8 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), ds->crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), ds->crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(ds), ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(ds), ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
@@ -457,14 +464,182 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 	ds->max_ambient_pressure = MAX(pressure, ds->max_ambient_pressure);
 }
 
+/*
+ * The exposition factors of all compartments for the period of the last
+ * segment are kept in the deco state, since consecutive segments usually
+ * have the same length.
+ */
+static void update_tissue_factors(struct deco_state *ds, int period_in_seconds)
+{
+	int ci;
+
+	if (ds->factor_period == period_in_seconds && period_in_seconds)
+		return;
+	if (period_in_seconds == 1) {
+		memcpy(ds->n2_factor, buehlmann_N2_factor_expositon_one_second, sizeof(ds->n2_factor));
+		memcpy(ds->he_factor, buehlmann_He_factor_expositon_one_second, sizeof(ds->he_factor));
+	} else {
+		for (ci = 0; ci < 16; ci++) {
+			ds->n2_factor[ci] = factor(period_in_seconds, ci, N2);
+			ds->he_factor[ci] = factor(period_in_seconds, ci, HE);
+		}
+	}
+	ds->factor_period = period_in_seconds;
+}
+
+/* Report ICD if N2 is more on-gasing than He off-gasing in leading tissue */
+static bool icd_in_guiding_tissue(const struct deco_state *ds, double pn2, double phe)
+{
+	int ci = ds->ci_pointing_to_guiding_tissue;
+	double pn2_oversat, phe_oversat, n2_satmult, he_satmult;
+
+	if (ci < 0 || ci >= 16)
+		return false;
+	pn2_oversat = pn2 - ds->tissue_n2_sat[ci];
+	phe_oversat = phe - ds->tissue_he_sat[ci];
+	n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+	he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+	return pn2_oversat > 0.0 && phe_oversat < 0.0 &&
+	       pn2_oversat * n2_satmult * ds->n2_factor[ci] + phe_oversat * he_satmult * ds->he_factor[ci] > 0;
+}
+
+/*
+ * Move the inert gas tensions of all compartments towards the inspired
+ * partial pressures, using the factors of update_tissue_factors().
+ * The SSE2 version does two compartments at a time. It performs the same
+ * operations in the same order as the scalar version, so that the results
+ * are bit-for-bit identical.
+ */
+static void update_tissues(struct deco_state *ds, double pn2, double phe)
+{
+	int ci;
+#ifdef __SSE2__
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d satmult = _mm_set1_pd(buehlmann_config.satmult);
+	const __m128d desatmult = _mm_set1_pd(buehlmann_config.desatmult);
+	const __m128d inspired_n2 = _mm_set1_pd(pn2);
+	const __m128d inspired_he = _mm_set1_pd(phe);
+
+	for (ci = 0; ci < 16; ci += 2) {
+		__m128d n2_sat = _mm_loadu_pd(ds->tissue_n2_sat + ci);
+		__m128d he_sat = _mm_loadu_pd(ds->tissue_he_sat + ci);
+		__m128d pn2_oversat = _mm_sub_pd(inspired_n2, n2_sat);
+		__m128d phe_oversat = _mm_sub_pd(inspired_he, he_sat);
+		__m128d n2_ongas = _mm_cmpgt_pd(pn2_oversat, zero);
+		__m128d he_ongas = _mm_cmpgt_pd(phe_oversat, zero);
+		__m128d n2_satmult = _mm_or_pd(_mm_and_pd(n2_ongas, satmult), _mm_andnot_pd(n2_ongas, desatmult));
+		__m128d he_satmult = _mm_or_pd(_mm_and_pd(he_ongas, satmult), _mm_andnot_pd(he_ongas, desatmult));
+
+		n2_sat = _mm_add_pd(n2_sat, _mm_mul_pd(_mm_mul_pd(n2_satmult, pn2_oversat), _mm_loadu_pd(ds->n2_factor + ci)));
+		he_sat = _mm_add_pd(he_sat, _mm_mul_pd(_mm_mul_pd(he_satmult, phe_oversat), _mm_loadu_pd(ds->he_factor + ci)));
+		_mm_storeu_pd(ds->tissue_n2_sat + ci, n2_sat);
+		_mm_storeu_pd(ds->tissue_he_sat + ci, he_sat);
+		_mm_storeu_pd(ds->tissue_inertgas_saturation + ci, _mm_add_pd(n2_sat, he_sat));
+	}
+#else
+	for (ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pn2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = phe - ds->tissue_he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * ds->n2_factor[ci];
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * ds->he_factor[ci];
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+#endif
+}
+
 /* add period_in_seconds at the given pressure and gas to the deco calculation */
 void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int sac)
+{
+	UNUSED(sac);
+	struct gas_pressures pressures;
+	bool icd;
+	fill_pressures(&pressures, pressure - water_vapour_pressure(ds),
+		       gasmix, (double) ccpo2 / 1000.0, divemode);
+
+	update_tissue_factors(ds, period_in_seconds);
+	icd = icd_in_guiding_tissue(ds, pressures.n2, pressures.he);
+	update_tissues(ds, pressures.n2, pressures.he);
+	if (ds->config.mode == VPMB)
+		calc_crushing_pressure(ds, pressure);
+	ds->icd_warning = icd;
+}
+
+/*
+ * Add a segment of period_in_seconds during which the ambient pressure changes
+ * linearly from start_pressure to end_pressure. The inspired inert gas pressures
+ * are then linear in time too, and the tissue tensions follow the Schreiner
+ * equation
+ *
+ *	P(t) = P0 + R * t + (Pi0 - R / k - P0) * (1 - exp(-k * t))
+ *
+ * where P0 is the initial tension, Pi0 the initial inspired pressure, R the
+ * rate of change of the inspired pressure and k = ln(2) / halflife. Thus, a
+ * whole ramp costs the same as a single call to add_segment(). For a constant
+ * pressure this is exactly add_segment().
+ *
+ * The equation assumes that the saturation and desaturation multipliers are
+ * equal. If not, the ramp is split into one-second steps.
+ */
+void add_segment_linear(struct deco_state *ds, double start_pressure, double end_pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int sac)
+{
+	struct gas_pressures start, end;
+	double wv_pressure = water_vapour_pressure(ds);
+	bool icd;
+	int ci;
+
+	if (period_in_seconds <= 0)
+		return;
+	if (start_pressure == end_pressure) {
+		add_segment(ds, end_pressure, gasmix, period_in_seconds, ccpo2, divemode, sac);
+		return;
+	}
+	if (buehlmann_config.satmult != buehlmann_config.desatmult) {
+		int t;
+		for (t = 1; t <= period_in_seconds; t++) {
+			double pressure = start_pressure + (end_pressure - start_pressure) * t / period_in_seconds;
+			add_segment(ds, pressure, gasmix, 1, ccpo2, divemode, sac);
+		}
+		return;
+	}
+
+	fill_pressures(&start, start_pressure - wv_pressure, gasmix, (double) ccpo2 / 1000.0, divemode);
+	fill_pressures(&end, end_pressure - wv_pressure, gasmix, (double) ccpo2 / 1000.0, divemode);
+	update_tissue_factors(ds, period_in_seconds);
+	icd = icd_in_guiding_tissue(ds, start.n2, start.he);
+
+	for (ci = 0; ci < 16; ci++) {
+		// time constants 1/k in seconds; ln(2)/60 = 1.155245301e-02
+		double n2_tau = buehlmann_N2_t_halflife[ci] / 1.155245301e-02;
+		double he_tau = buehlmann_He_t_halflife[ci] / 1.155245301e-02;
+		double n2_rate = (end.n2 - start.n2) / period_in_seconds;
+		double he_rate = (end.he - start.he) / period_in_seconds;
+
+		ds->tissue_n2_sat[ci] += buehlmann_config.satmult * (start.n2 - n2_rate * n2_tau - ds->tissue_n2_sat[ci]) * ds->n2_factor[ci] +
+					 (end.n2 - start.n2);
+		ds->tissue_he_sat[ci] += buehlmann_config.satmult * (start.he - he_rate * he_tau - ds->tissue_he_sat[ci]) * ds->he_factor[ci] +
+					 (end.he - start.he);
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+	if (ds->config.mode == VPMB)
+		calc_crushing_pressure(ds, end_pressure);
+	ds->icd_warning = icd;
+}
+
+/*
+ * The straightforward version of add_segment(), which looks up the factors
+ * of every compartment on every call. Only used to check and benchmark the
+ * optimized version above.
+ */
+void add_segment_reference(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int sac)
 {
 	UNUSED(sac);
 	int ci;
 	struct gas_pressures pressures;
 	bool icd = false;
-	fill_pressures(&pressures, pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
+	fill_pressures(&pressures, pressure - water_vapour_pressure(ds),
 		       gasmix, (double) ccpo2 / 1000.0, divemode);
 
 	for (ci = 0; ci < 16; ci++) {
@@ -485,12 +660,119 @@ void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, i
 		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
 
 	}
-	if (decoMode() == VPMB)
+	if (ds->config.mode == VPMB)
 		calc_crushing_pressure(ds, pressure);
 	ds->icd_warning = icd;
 	return;
 }
 
+/*
+ * The tissue pressure of a compartment in excess of the pressure that it tolerates at the
+ * given ambient pressure. As in tissue_tolerance_calc(), the tolerated tissue pressures
+ * are interpolated linearly between the M-values reduced by gf_high at the surface and
+ * by gf_low at the pressure of the first ceiling of the dive.
+ */
+static double compartment_excess(const struct deco_state *ds, int ci, double n2, double he, double pressure, double surface)
+{
+	double a = (buehlmann_N2_a[ci] * n2 + buehlmann_He_a[ci] * he) / (n2 + he);
+	double b = (buehlmann_N2_b[ci] * n2 + buehlmann_He_b[ci] * he) / (n2 + he);
+	double gf_low_pressure = ds->gf_low_pressure_this_dive;
+	double tolerated_surface = surface + ds->config.gf_high * (a + surface / b - surface);
+	double tolerated_gf_low = gf_low_pressure + ds->config.gf_low * (a + gf_low_pressure / b - gf_low_pressure);
+
+	return n2 + he - tolerated_surface - (tolerated_gf_low - tolerated_surface) * (pressure - surface) / (gf_low_pressure - surface);
+}
+
+static bool compartment_crossed(const struct deco_state *ds, int ci, double n2, double he, double limit_pressure, double surface, bool loading)
+{
+	double excess = compartment_excess(ds, ci, n2, he, limit_pressure, surface);
+	return loading ? excess > 0.0 : excess <= 0.0;
+}
+
+static double compartment_crossing_time(const struct deco_state *ds, int ci, const struct gas_pressures *inspired,
+					double limit_pressure, double surface, bool loading, double max_time)
+{
+	// time constants k in 1/s; ln(2)/60 = 1.155245301e-02
+	double n2_k = 1.155245301e-02 / buehlmann_N2_t_halflife[ci];
+	double he_k = 1.155245301e-02 / buehlmann_He_t_halflife[ci];
+	double n2 = ds->tissue_n2_sat[ci], he = ds->tissue_he_sat[ci];
+	double low = 0.0, high = max_time;
+
+	if (compartment_crossed(ds, ci, n2, he, limit_pressure, surface, loading))
+		return 0.0;
+
+	// Without helium the tolerated pressure is fixed: solve p(t) = p_insp + (p_0 - p_insp) * exp(-k * t) for it
+	if (he == 0.0 && inspired->he == 0.0) {
+		double tolerated = n2 - compartment_excess(ds, ci, n2, 0.0, limit_pressure, surface);
+		double ratio = (tolerated - inspired->n2) / (n2 - inspired->n2);
+		if (ratio <= 0.0 || ratio >= 1.0)
+			return max_time;
+		return MIN(-log(ratio) / n2_k, max_time);
+	}
+
+	// Otherwise, it depends on the ratio of the inert gases in the compartment
+	if (!compartment_crossed(ds, ci, inspired->n2 + (n2 - inspired->n2) * exp(-n2_k * high),
+				 inspired->he + (he - inspired->he) * exp(-he_k * high), limit_pressure, surface, loading))
+		return max_time;
+	while (high - low > 1.0) {
+		double t = (low + high) / 2.0;
+		if (compartment_crossed(ds, ci, inspired->n2 + (n2 - inspired->n2) * exp(-n2_k * t),
+					inspired->he + (he - inspired->he) * exp(-he_k * t), limit_pressure, surface, loading))
+			high = t;
+		else
+			low = t;
+	}
+	return high;
+}
+
+/*
+ * Estimate the time in seconds at the given ambient pressure until the Bühlmann
+ * ceiling crosses limit_pressure. For loading tissues (the no-deco limit), this
+ * is the time until the first compartment exceeds its tolerated pressure at
+ * limit_pressure, otherwise (a deco stop) the time until all compartments are
+ * below it. The result is capped at max_time. Returns a negative value for
+ * VPM-B, where the ceiling doesn't follow from the M-values.
+ */
+double ceiling_crossing_time(const struct deco_state *ds, const struct dive *dive, double pressure, struct gasmix gasmix, int ccpo2,
+			     enum divemode_t divemode, double limit_pressure, bool loading, double max_time)
+{
+	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
+	double time = loading ? max_time : 0.0;
+	struct gas_pressures inspired;
+	int ci;
+
+	if (ds->config.mode == VPMB)
+		return -1.0;
+	fill_pressures(&inspired, pressure - water_vapour_pressure(ds), gasmix, (double) ccpo2 / 1000.0, divemode);
+	for (ci = 0; ci < 16; ci++) {
+		double t = compartment_crossing_time(ds, ci, &inspired, limit_pressure, surface, loading, max_time);
+		time = loading ? MIN(time, t) : MAX(time, t);
+	}
+	return time;
+}
+
+/*
+ * Does the ceiling move in one direction only while staying at the given ambient
+ * pressure? This is the case if the nitrogen and the helium tension of every
+ * compartment rise or fall together. After a switch from trimix to a gas with less
+ * helium, helium leaves the compartments while nitrogen enters them, and the ceiling
+ * may first rise and then fall again.
+ */
+bool ceiling_is_monotonic(const struct deco_state *ds, double pressure, struct gasmix gasmix, int ccpo2, enum divemode_t divemode)
+{
+	struct gas_pressures inspired;
+	int ci;
+
+	fill_pressures(&inspired, pressure - water_vapour_pressure(ds), gasmix, (double) ccpo2 / 1000.0, divemode);
+	for (ci = 0; ci < 16; ci++) {
+		double n2 = inspired.n2 - ds->tissue_n2_sat[ci];
+		double he = inspired.he - ds->tissue_he_sat[ci];
+		if ((n2 > 0.0 && he < 0.0) || (n2 < 0.0 && he > 0.0))
+			return false;
+	}
+	return true;
+}
+
 #if DECO_CALC_DEBUG
 void dump_tissues(struct deco_state *ds)
 {
@@ -517,19 +799,22 @@ void clear_vpmb_state(struct deco_state *ds)
 	ds->max_bottom_ceiling_pressure.mbar = 0;
 }
 
+/* Reset the deco state to a diver saturated at the surface. The configuration is kept. */
 void clear_deco(struct deco_state *ds, double surface_pressure)
 {
 	int ci;
+	struct deco_config config = ds->config;
 
 	memset(ds, 0, sizeof(*ds));
+	ds->config = config;
 	clear_vpmb_state(ds);
 	for (ci = 0; ci < 16; ci++) {
-		ds->tissue_n2_sat[ci] = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
+		ds->tissue_n2_sat[ci] = (surface_pressure - water_vapour_pressure(ds)) * N2_IN_AIR / 1000;
 		ds->tissue_he_sat[ci] = 0.0;
 		ds->max_n2_crushing_pressure[ci] = 0.0;
 		ds->max_he_crushing_pressure[ci] = 0.0;
-		ds->n2_regen_radius[ci] = get_crit_radius_N2();
-		ds->he_regen_radius[ci] = get_crit_radius_He();
+		ds->n2_regen_radius[ci] = get_crit_radius_N2(ds);
+		ds->he_regen_radius[ci] = get_crit_radius_He(ds);
 	}
 	ds->gf_low_pressure_this_dive = surface_pressure + buehlmann_config.gf_low_position_min;
 	ds->max_ambient_pressure = 0.0;
@@ -583,29 +868,43 @@ int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const
 	return depth;
 }
 
-void set_gf(short gflow, short gfhigh)
+/*
+ * Set up the configuration of a calculation from the preferences, using the
+ * deco mode of the planner or of the dive log, respectively.
+ */
+void init_deco_config(struct deco_config *config, bool planner)
+{
+	config->mode = planner ? prefs.planner_deco_mode : prefs.display_deco_mode;
+	config->planner = planner;
+	config->gf_low = 0.35;
+	config->gf_high = 0.75;
+	set_gf(config, prefs.gflow, prefs.gfhigh);
+	set_vpmb_conservatism(config, prefs.vpmb_conservatism);
+}
+
+void set_gf(struct deco_config *config, short gflow, short gfhigh)
 {
 	if (gflow != -1)
-		buehlmann_config.gf_low = (double)gflow / 100.0;
+		config->gf_low = (double)gflow / 100.0;
 	if (gfhigh != -1)
-		buehlmann_config.gf_high = (double)gfhigh / 100.0;
+		config->gf_high = (double)gfhigh / 100.0;
 }
 
-void set_vpmb_conservatism(short conservatism)
+void set_vpmb_conservatism(struct deco_config *config, short conservatism)
 {
 	if (conservatism < 0)
-		vpmb_config.conservatism = 0;
+		config->vpmb_conservatism = 0;
 	else if (conservatism > 4)
-		vpmb_config.conservatism = 4;
+		config->vpmb_conservatism = 4;
 	else
-		vpmb_config.conservatism = conservatism;
+		config->vpmb_conservatism = conservatism;
 }
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	double gf_low = buehlmann_config.gf_low;
-	double gf_high = buehlmann_config.gf_high;
+	double gf_low = ds->config.gf_low;
+	double gf_high = ds->config.gf_high;
 	double gf;
 	if (ds->gf_low_pressure_this_dive > surface_pressure_bar)
 		gf = MAX((double)gf_low, (ambpressure_bar - surface_pressure_bar) /
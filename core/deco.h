@@ -5,6 +5,7 @@
 #include "units.h"
 #include "gas.h"
 #include "divemode.h"
+#include "pref.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,7 +15,21 @@ struct dive;
 struct divecomputer;
 struct decostop;
 
+/*
+ * The parameters of a decompression calculation. They are part of the deco
+ * state and not global, so that independent calculations, e.g. of several
+ * profiles or plan variations, can run concurrently.
+ */
+struct deco_config {
+	enum deco_mode mode;
+	bool planner;			// calculation for the planner; planned VPM-B dives use the Schreiner water vapour pressure
+	double gf_low;
+	double gf_high;
+	short vpmb_conservatism;	// 0-4
+};
+
 struct deco_state {
+	struct deco_config config;
 	double tissue_n2_sat[16];
 	double tissue_he_sat[16];
 	double tolerated_by_tissue[16];
@@ -45,6 +60,9 @@ struct deco_state {
 	long sumx, sumxx;
 	double sumy, sumxy;
 	int plot_depth;
+	int factor_period;                            // period of the cached exposition factors
+	double n2_factor[16];
+	double he_factor[16];
 };
 
 extern const double buehlmann_N2_t_halflife[];
@@ -54,8 +72,9 @@ extern int deco_allowed_depth(double tissues_tolerance, double surface_pressure,
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive);
 extern void clear_deco(struct deco_state *ds, double surface_pressure);
 extern void dump_tissues(struct deco_state *ds);
-extern void set_gf(short gflow, short gfhigh);
-extern void set_vpmb_conservatism(short conservatism);
+extern void init_deco_config(struct deco_config *config, bool planner);
+extern void set_gf(struct deco_config *config, short gflow, short gfhigh);
+extern void set_vpmb_conservatism(struct deco_config *config, short conservatism);
 extern void cache_deco_state(struct deco_state *source, struct deco_state **datap);
 extern void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
@@ -66,6 +85,11 @@ extern void calc_crushing_pressure(struct deco_state *ds, double pressure);
 extern void vpmb_start_gradient(struct deco_state *ds);
 extern void clear_vpmb_state(struct deco_state *ds);
 extern void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int setpoint, enum divemode_t divemode, int sac);
+extern void add_segment_linear(struct deco_state *ds, double start_pressure, double end_pressure, struct gasmix gasmix, int period_in_seconds, int setpoint, enum divemode_t divemode, int sac);
+extern void add_segment_reference(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int setpoint, enum divemode_t divemode, int sac);
+extern double ceiling_crossing_time(const struct deco_state *ds, const struct dive *dive, double pressure, struct gasmix gasmix, int setpoint,
+				    enum divemode_t divemode, double limit_pressure, bool loading, double max_time);
+extern bool ceiling_is_monotonic(const struct deco_state *ds, double pressure, struct gasmix gasmix, int setpoint, enum divemode_t divemode);
 
 extern double regressiona(const struct deco_state *ds);
 extern double regressionb(const struct deco_state *ds);
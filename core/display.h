@@ -8,6 +8,8 @@
 extern "C" {
 #endif
 
+struct deco_state;
+
 /* Plot info with smoothing, velocity indication
  * and one-, two- and three-minute minimums and maximums */
 struct plot_info {
@@ -23,6 +25,14 @@ struct plot_info {
 	double maxpp;
 	struct plot_data *entry;
 	struct plot_pressure_data *pressures; /* cylinders.nr blocks of nr entries. */
+	struct plot_deco_data *deco; /* nr entries, if the deco was calculated */
+	struct plot_gas_data *gas; /* nr entries, if the gas data were calculated */
+	/* The derived data that have been calculated (enum plot_channel) and the
+	 * dive they are calculated from, see plot_info_need() */
+	unsigned int channels;
+	struct dive *dive;
+	struct divecomputer *dc;
+	const struct deco_state *planner_ds;
 };
 
 extern struct divecomputer *select_dc(struct dive *);
@@ -11,10 +11,17 @@
 #include "device.h"
 #include "divelist.h"
 #include "divesite.h"
+#include "eventindex.h"
 #include "qthelper.h"
 #include "metadata.h"
 #include "membuffer.h"
+#include "samplecolumns.h"
+#include "sharedbuffer.h"
+#include "arena.h"
+#include "stringpool.h"
 #include "tag.h"
+#include "plotinfocache.h"
+#include "tissuecache.h"
 #include "trip.h"
 #include "structured_list.h"
 
@@ -92,12 +99,12 @@ int legacy_format_o2pressures(const struct dive *dive, const struct divecomputer
 
 	o2sensor = (dc->divemode == CCR) ? get_cylinder_idx_by_use(dive, OXYGEN) : -1;
 	for (i = 0; i < dc->samples; i++) {
-		const struct sample *s = dc->sample + i;
+		struct sample s = get_sample(dc, i);
 		int seen_pressure = 0, idx;
 
 		for (idx = 0; idx < MAX_SENSORS; idx++) {
-			int sensor = s->sensor[idx];
-			pressure_t p = s->pressure[idx];
+			int sensor = s.sensor[idx];
+			pressure_t p = s.pressure[idx];
 
 			if (!p.mbar)
 				continue;
@@ -130,9 +137,7 @@ struct event *add_event(struct divecomputer *dc, unsigned int time, int type, in
 	unsigned int size, len = strlen(name);
 
 	size = sizeof(*ev) + len + 1;
-	ev = malloc(size);
-	if (!ev)
-		return NULL;
+	ev = logbook_alloc(size);
 	memset(ev, 0, size);
 	memcpy(ev->name, name, len);
 	ev->time.seconds = time;
@@ -196,7 +201,7 @@ void remove_event(struct event *event)
 		 * dive (for instance the displayed_dive
 		 * that we use on the interface to show things). */
 		struct event *temp = (*ep)->next;
-		free(*ep);
+		logbook_free(*ep);
 		*ep = temp;
 	}
 }
@@ -221,7 +226,7 @@ void update_event_name(struct dive *d, struct event *event, const char *name)
 	remove = *removep;
 	*removep = (*removep)->next;
 	add_event(dc, event->time.seconds, event->type, event->flags, event->value, name);
-	free(remove);
+	logbook_free(remove);
 	invalidate_dive_cache(d);
 }
 
@@ -231,12 +236,10 @@ void add_extra_data(struct divecomputer *dc, const char *key, const char *value)
 
 	while (*ed)
 		ed = &(*ed)->next;
-	*ed = malloc(sizeof(struct extra_data));
-	if (*ed) {
-		(*ed)->key = strdup(key);
-		(*ed)->value = strdup(value);
-		(*ed)->next = NULL;
-	}
+	*ed = logbook_alloc(sizeof(struct extra_data));
+	(*ed)->key = logbook_strdup(key);
+	(*ed)->value = logbook_strdup(value);
+	(*ed)->next = NULL;
 }
 
 /* Find the divemode at time 'time' (in seconds) into the dive. Sequentially step through the divemode-change events,
@@ -247,6 +250,12 @@ enum divemode_t get_current_divemode(const struct divecomputer *dc, int time, co
 {
 	const struct event *ev = *evp;
 	if (*divemode == UNDEF_COMP_TYPE && dc) {
+		const struct event_index *modechanges = get_active_event_index(dc, "modechange");
+		if (modechanges) {
+			*divemode = get_divemode_indexed(dc, modechanges, time);
+			*evp = event_index_next_after(modechanges, time - 1);
+			return *divemode;
+		}
 		*divemode = dc->divemode;
 		ev = get_next_event(dc->events, "modechange");
 	} else {
@@ -295,6 +304,7 @@ struct dive *alloc_dive(void)
 
 static void free_dc(struct divecomputer *dc);
 static void free_dc_contents(struct divecomputer *dc);
+static void free_packed_samples(struct divecomputer *dc);
 
 /* copy an element in a list of dive computer extra data */
 static void copy_extra_data(struct extra_data *sed, struct extra_data *ded)
@@ -308,9 +318,9 @@ static void copy_extra_data(struct extra_data *sed, struct extra_data *ded)
 static void copy_dc(const struct divecomputer *sdc, struct divecomputer *ddc)
 {
 	*ddc = *sdc;
-	ddc->model = copy_string(sdc->model);
-	ddc->serial = copy_string(sdc->serial);
-	ddc->fw_version = copy_string(sdc->fw_version);
+	ddc->model = intern_string(sdc->model);
+	ddc->serial = intern_string(sdc->serial);
+	ddc->fw_version = intern_string(sdc->fw_version);
 	copy_samples(sdc, ddc);
 	copy_events(sdc, ddc);
 	STRUCTURED_LIST_COPY(struct extra_data, sdc->extra_data, ddc->extra_data, copy_extra_data);
@@ -355,10 +365,10 @@ static void free_dive_structures(struct dive *d)
 	if (!d)
 		return;
 	/* free the strings */
-	free(d->buddy);
-	free(d->divemaster);
+	release_string(d->buddy);
+	release_string(d->divemaster);
 	free(d->notes);
-	free(d->suit);
+	release_string(d->suit);
 	/* free tags, additional dive computers, and pictures */
 	taglist_free(d->tag_list);
 	free_dive_dcs(&d->dc);
@@ -399,11 +409,12 @@ static void copy_dive_nodc(const struct dive *s, struct dive *d)
 	*d = *s;
 	memset(&d->cylinders, 0, sizeof(d->cylinders));
 	memset(&d->weightsystems, 0, sizeof(d->weightsystems));
-	invalidate_dive_cache(d);
-	d->buddy = copy_string(s->buddy);
-	d->divemaster = copy_string(s->divemaster);
+	/* The copy is not part of the dive table, so only its git id has to be reset */
+	memset(d->git_id, 0, 20);
+	d->buddy = intern_string(s->buddy);
+	d->divemaster = intern_string(s->divemaster);
 	d->notes = copy_string(s->notes);
-	d->suit = copy_string(s->suit);
+	d->suit = intern_string(s->suit);
 	copy_cylinders(&s->cylinders, &d->cylinders);
 	copy_weights(&s->weightsystems, &d->weightsystems);
 	STRUCTURED_LIST_COPY(struct picture, s->picture_list, d->picture_list, copy_pl);
@@ -442,15 +453,19 @@ struct dive *move_dive(struct dive *s)
 	if (what._component)                \
 		d->_component = copy_string(s->_component)
 
+#define CONDITIONAL_INTERN_STRING(_component) \
+	if (what._component)                  \
+		d->_component = intern_string(s->_component)
+
 // copy elements, depending on bits in what that are set
 void selective_copy_dive(const struct dive *s, struct dive *d, struct dive_components what, bool clear)
 {
 	if (clear)
 		clear_dive(d);
 	CONDITIONAL_COPY_STRING(notes);
-	CONDITIONAL_COPY_STRING(divemaster);
-	CONDITIONAL_COPY_STRING(buddy);
-	CONDITIONAL_COPY_STRING(suit);
+	CONDITIONAL_INTERN_STRING(divemaster);
+	CONDITIONAL_INTERN_STRING(buddy);
+	CONDITIONAL_INTERN_STRING(suit);
 	if (what.rating)
 		d->rating = s->rating;
 	if (what.visibility)
@@ -467,6 +482,7 @@ void selective_copy_dive(const struct dive *s, struct dive *d, struct dive_compo
 		copy_weights(&s->weightsystems, &d->weightsystems);
 }
 #undef CONDITIONAL_COPY_STRING
+#undef CONDITIONAL_INTERN_STRING
 
 struct event *clone_event(const struct event *src_ev)
 {
@@ -539,6 +555,14 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 	 * over and over again, let's just copy the whole blob */
 	if (!s || !d)
 		return;
+	d->packed_samples = NULL;
+	if (s->packed_samples) {
+		/* the copy gets its samples in normal, unpacked form */
+		d->sample = alloc_shared_buffer(s->samples * sizeof(struct sample));
+		d->samples = d->alloc_samples = s->samples;
+		unpack_sample_columns(s->packed_samples, d->sample);
+		return;
+	}
 	int nr = s->samples;
 	d->samples = nr;
 	d->alloc_samples = nr;
@@ -550,33 +574,156 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 	if(!nr)
 		return;
 
-	d->sample = malloc(nr * sizeof(struct sample));
-	if (d->sample)
-		memcpy(d->sample, s->sample, nr * sizeof(struct sample));
+	/* The sample array is shared with the source and only copied
+	 * once either side writes to it. See unshare_samples(). */
+	d->sample = share_buffer(s->sample);
+}
+
+/* Replace a sample array that is shared with other dive computers by a
+ * private copy with room for at least num samples. */
+static void copy_shared_samples(struct divecomputer *dc, int num)
+{
+	struct sample *sample = alloc_shared_buffer(num * sizeof(struct sample));
+	memcpy(sample, dc->sample, dc->samples * sizeof(struct sample));
+	release_shared_buffer(dc->sample);
+	dc->sample = sample;
+	dc->alloc_samples = num;
+}
+
+static void unpack_dc_samples(struct divecomputer *dc);
+
+/*
+ * The sample array may be shared by copies of a dive computer (see
+ * copy_samples()) or the samples may be packed (see pack_dive_samples()).
+ * Code that writes to the samples in place must call this first. Functions
+ * that add samples do so automatically.
+ */
+void unshare_samples(struct divecomputer *dc)
+{
+	unpack_dc_samples(dc);
+	if (!shared_buffer_is_unique(dc->sample))
+		copy_shared_samples(dc, dc->alloc_samples > dc->samples ? dc->alloc_samples : dc->samples);
+}
+
+/* Pointer to the i-th sample, for writing. */
+static struct sample *writable_sample(struct divecomputer *dc, int i)
+{
+	unshare_samples(dc);
+	return dc->sample + i;
 }
 
 /* make room for num samples; if not enough space is available, the sample
- * array is reallocated and the existing samples are copied. */
+ * array is reallocated and the existing samples are copied. Since the
+ * samples are going to be written, a shared array is unshared. */
 void alloc_samples(struct divecomputer *dc, int num)
 {
+	unpack_dc_samples(dc);
 	if (num > dc->alloc_samples) {
 		dc->alloc_samples = (num * 3) / 2 + 10;
-		dc->sample = realloc(dc->sample, dc->alloc_samples * sizeof(struct sample));
-		if (!dc->sample)
-			dc->samples = dc->alloc_samples = 0;
+		if (shared_buffer_is_unique(dc->sample))
+			dc->sample = realloc_shared_buffer(dc->sample, dc->alloc_samples * sizeof(struct sample));
+		else
+			copy_shared_samples(dc, dc->alloc_samples);
+	} else {
+		unshare_samples(dc);
 	}
 }
 
 void free_samples(struct divecomputer *dc)
 {
 	if (dc) {
-		free(dc->sample);
+		release_shared_buffer(dc->sample);
 		dc->sample = 0;
 		dc->samples = 0;
 		dc->alloc_samples = 0;
+		free_packed_samples(dc);
+	}
+}
+
+static void free_packed_samples(struct divecomputer *dc)
+{
+	if (dc->packed_samples) {
+		free_sample_columns(dc->packed_samples);
+		free(dc->packed_samples);
+		dc->packed_samples = NULL;
 	}
 }
 
+/*
+ * The dives of the dive list and the dives kept by the undo system store
+ * their samples in the much more compact columnar form. While packed, a
+ * dive computer keeps its number of samples in dc->samples, but has no
+ * dc->sample array. The samples are read with get_sample(),
+ * get_sample_array() or get_sample_column(). Writing to the samples
+ * (see unshare_samples()) unpacks them. Copies of a packed dive are unpacked.
+ */
+static void pack_dc_samples(struct divecomputer *dc)
+{
+	if (dc->packed_samples || !dc->samples)
+		return;
+	dc->packed_samples = malloc(sizeof(struct sample_columns));
+	if (!dc->packed_samples)
+		exit(1);
+	pack_sample_columns(dc->packed_samples, dc->sample, dc->samples);
+	release_shared_buffer(dc->sample);
+	dc->sample = NULL;
+	dc->alloc_samples = 0;
+}
+
+static void unpack_dc_samples(struct divecomputer *dc)
+{
+	struct sample_columns *cols = dc->packed_samples;
+
+	if (!cols)
+		return;
+	dc->packed_samples = NULL;
+	dc->sample = alloc_shared_buffer(cols->nr * sizeof(struct sample));
+	dc->samples = dc->alloc_samples = cols->nr;
+	unpack_sample_columns(cols, dc->sample);
+	free_sample_columns(cols);
+	free(cols);
+}
+
+void pack_dive_samples(struct dive *d)
+{
+	struct divecomputer *dc;
+
+	for_each_dc (d, dc)
+		pack_dc_samples(dc);
+}
+
+/* The i-th sample of a dive computer, whether its samples are packed or not */
+struct sample get_sample(const struct divecomputer *dc, int idx)
+{
+	if (dc->packed_samples)
+		return get_sample_from_columns(dc->packed_samples, idx);
+	return dc->sample[idx];
+}
+
+/*
+ * The samples of a dive computer as an array, for code that walks them
+ * with pointers. Packed samples are unpacked into a temporary array,
+ * which is released by free_sample_array(). Don't write to the array.
+ */
+const struct sample *get_sample_array(const struct divecomputer *dc)
+{
+	struct sample *res;
+
+	if (!dc->packed_samples)
+		return dc->sample;
+	res = malloc(dc->samples * sizeof(struct sample));
+	if (!res)
+		exit(1);
+	unpack_sample_columns(dc->packed_samples, res);
+	return res;
+}
+
+void free_sample_array(const struct divecomputer *dc, const struct sample *samples)
+{
+	if (samples != dc->sample)
+		free((struct sample *)samples);
+}
+
 struct sample *prepare_sample(struct divecomputer *dc)
 {
 	if (dc) {
@@ -654,15 +801,16 @@ void fixup_dc_duration(struct divecomputer *dc)
 {
 	int duration, i;
 	int lasttime, lastdepth, depthtime;
+	struct sample_column times = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	struct sample_column depths = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
 
 	duration = 0;
 	lasttime = 0;
 	lastdepth = 0;
 	depthtime = 0;
 	for (i = 0; i < dc->samples; i++) {
-		struct sample *sample = dc->sample + i;
-		int time = sample->time.seconds;
-		int depth = sample->depth.mm;
+		int time = SAMPLE_VALUE(times, duration_t, i).seconds;
+		int depth = SAMPLE_VALUE(depths, depth_t, i).mm;
 
 		/* We ignore segments at the surface */
 		if (depth > SURFACE_THRESHOLD || lastdepth > SURFACE_THRESHOLD) {
@@ -799,12 +947,13 @@ void per_cylinder_mean_depth(const struct dive *dive, struct divecomputer *dc, i
 	if (!dc->samples)
 		fake_dc(dc);
 	const struct event *ev = get_next_event(dc->events, "gaschange");
+	struct sample_column times = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	struct sample_column depths = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
 	depthtime = malloc(dive->cylinders.nr * sizeof(*depthtime));
 	memset(depthtime, 0, dive->cylinders.nr * sizeof(*depthtime));
 	for (i = 0; i < dc->samples; i++) {
-		struct sample *sample = dc->sample + i;
-		uint32_t time = sample->time.seconds;
-		int depth = sample->depth.mm;
+		uint32_t time = SAMPLE_VALUE(times, duration_t, i).seconds;
+		int depth = SAMPLE_VALUE(depths, depth_t, i).mm;
 
 		/* Make sure to move the event past 'lasttime' */
 		while (ev && lasttime >= ev->time.seconds) {
@@ -864,7 +1013,7 @@ int explicit_first_cylinder(const struct dive *dive, const struct divecomputer *
 {
 	if (dc) {
 		const struct event *ev = get_next_event(dc->events, "gaschange");
-		if (ev && ((dc->sample && ev->time.seconds == dc->sample[0].time.seconds) || ev->time.seconds <= 1))
+		if (ev && ((dc->samples && ev->time.seconds == get_sample(dc, 0).time.seconds) || ev->time.seconds <= 1))
 			return get_cylinder_index(dive, ev);
 		else if (dc->divemode == CCR)
 			return MAX(get_cylinder_idx_by_use(dive, DILUENT), 0);
@@ -898,14 +1047,15 @@ void update_setpoint_events(const struct dive *dive, struct divecomputer *dc)
 
 		for (int i = 0; i < dc->samples; i++) {
 			struct gas_pressures pressures;
-			if (next && dc->sample[i].time.seconds >= next->time.seconds) {
+			struct sample sample = get_sample(dc, i);
+			if (next && sample.time.seconds >= next->time.seconds) {
 				ev = next;
 				gasmix = get_gasmix_from_event(dive, ev);
 				next = get_next_event(ev, "gaschange");
 			}
-			fill_pressures(&pressures, calculate_depth_to_mbar(dc->sample[i].depth.mm, dc->surface_pressure, 0), gasmix ,0, dc->divemode);
-			if (abs(dc->sample[i].setpoint.mbar - (int)(1000 * pressures.o2)) <= 50)
-				dc->sample[i].setpoint.mbar = 0;
+			fill_pressures(&pressures, calculate_depth_to_mbar(sample.depth.mm, dc->surface_pressure, 0), gasmix ,0, dc->divemode);
+			if (abs(sample.setpoint.mbar - (int)(1000 * pressures.o2)) <= 50)
+				writable_sample(dc, i)->setpoint.mbar = 0;
 		}
 	}
 
@@ -1206,7 +1356,7 @@ static void fixup_dc_events(struct divecomputer *dc)
 	while (event) {
 		if (event->next && event->next->deleted) {
 			struct event *nextnext = event->next->next;
-			free(event->next);
+			logbook_free(event->next);
 			event->next = nextnext;
 		} else {
 			event = event->next;
@@ -1244,6 +1394,7 @@ static void fixup_dc_depths(struct dive *dive, struct divecomputer *dc)
 
 		if (depth < 0) {
 			depth = interpolate_depth(dc, i, lastdepth, lasttime, time);
+			sample = writable_sample(dc, i);
 			sample->depth.mm = depth;
 		}
 
@@ -1272,7 +1423,7 @@ static void fixup_dc_ndl(struct divecomputer *dc)
 		if (sample->ndl.seconds != 0)
 			break;
 		if (sample->ndl.seconds == 0)
-			sample->ndl.seconds = -1;
+			writable_sample(dc, i)->ndl.seconds = -1;
 	}
 }
 
@@ -1291,10 +1442,12 @@ static void fixup_dc_temp(struct dive *dive, struct divecomputer *dc)
 			 * temperature readings, throw away
 			 * the redundant ones.
 			 */
-			if (lasttemp == temp)
+			if (lasttemp == temp) {
+				sample = writable_sample(dc, i);
 				sample->temperature.mkelvin = 0;
-			else
+			} else {
 				lasttemp = temp;
+			}
 
 			if (!mintemp || temp < mintemp)
 				mintemp = temp;
@@ -1323,8 +1476,10 @@ static void simplify_dc_pressures(struct divecomputer *dc)
 
 			if (index == lastindex[j]) {
 				/* Remove duplicate redundant pressure information */
-				if (pressure == lastpressure[j])
+				if (pressure == lastpressure[j]) {
+					sample = writable_sample(dc, i);
 					sample->pressure[j].mbar = 0;
+				}
 			}
 			lastindex[j] = index;
 			lastpressure[j] = pressure;
@@ -1488,6 +1643,10 @@ static void fixup_no_o2sensors(struct divecomputer *dc)
 
 static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 {
+	/* The fixups work on the sample array, but packed samples stay packed */
+	bool packed = dc->packed_samples != NULL;
+	unpack_dc_samples(dc);
+
 	/* Add device information to table */
 	if (dc->deviceid && (dc->serial || dc->fw_version))
 		create_device_node(dc->model, dc->deviceid, dc->serial, dc->fw_version, "");
@@ -1514,6 +1673,9 @@ static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 
 	/* Fixup CCR / PSCR dives with o2sensor values, but without no_o2sensors */
 	fixup_no_o2sensors(dc);
+
+	if (packed)
+		pack_dc_samples(dc);
 }
 
 struct dive *fixup_dive(struct dive *dive)
@@ -1627,8 +1789,10 @@ static void merge_samples(struct divecomputer *res,
 {
 	int asamples = a->samples;
 	int bsamples = b->samples;
-	struct sample *as = a->sample;
-	struct sample *bs = b->sample;
+	const struct sample *a_samples = get_sample_array(a);
+	const struct sample *b_samples = get_sample_array(b);
+	const struct sample *as = a_samples;
+	const struct sample *bs = b_samples;
 
 	/*
 	 * We want a positive sample offset, so that sample
@@ -1643,7 +1807,7 @@ static void merge_samples(struct divecomputer *res,
 		asamples = bsamples;
 		bsamples = a->samples;
 		as = bs;
-		bs = a->sample;
+		bs = a_samples;
 		cylinders_map_tmp = cylinders_map_a;
 		cylinders_map_a = cylinders_map_b;
 		cylinders_map_b = cylinders_map_tmp;
@@ -1655,14 +1819,14 @@ static void merge_samples(struct divecomputer *res,
 		struct sample sample = { .bearing.degrees = -1, .ndl.seconds = -1 };
 
 		if (!res)
-			return;
+			break;
 
 		at = asamples ? as->time.seconds : -1;
 		bt = bsamples ? bs->time.seconds + offset : -1;
 
 		/* No samples? All done! */
 		if (at < 0 && bt < 0)
-			return;
+			break;
 
 		/* Only samples from a? */
 		if (bt < 0) {
@@ -1728,6 +1892,8 @@ static void merge_samples(struct divecomputer *res,
 		asamples--;
 		bsamples--;
 	}
+	free_sample_array(a, a_samples);
+	free_sample_array(b, b_samples);
 }
 
 /*
@@ -1791,7 +1957,7 @@ static char *merge_text(const char *a, const char *b, const char *sep)
 		return copy_string(b);
 	if (!b || !*b)
 		return strdup(a);
-	if (!strcmp(a, b))
+	if (a == b || !strcmp(a, b))
 		return copy_string(a);
 	res = malloc(strlen(a) + strlen(b) + 32);
 	if (!res)
@@ -2024,7 +2190,7 @@ static void renumber_last_sample(struct divecomputer *dc, const int mapping[])
 	if (dc->samples <= 0)
 		return;
 	idx = dc->samples - 1;
-	sample_renumber(dc->sample + idx, idx, mapping);
+	sample_renumber(writable_sample(dc, idx), idx, mapping);
 }
 
 static void event_renumber(struct event *ev, const int mapping[])
@@ -2042,6 +2208,7 @@ static void dc_cylinder_renumber(struct dive *dive, struct divecomputer *dc, con
 	struct event *ev;
 
 	/* Remap or delete the sensor indexes */
+	unshare_samples(dc);
 	for (i = 0; i < dc->samples; i++)
 		sample_renumber(dc->sample + i, i, mapping);
 
@@ -2137,7 +2304,7 @@ static void merge_one_cylinder(struct cylinder_table *t, const cylinder_t *a, co
 	res->type.workingpressure.mbar = a->type.workingpressure.mbar ?
 		a->type.workingpressure.mbar : b->type.workingpressure.mbar;
 	res->type.description = !empty_string(a->type.description) ?
-		copy_string(a->type.description) : copy_string(b->type.description);
+		intern_string(a->type.description) : intern_string(b->type.description);
 	res->gasmix = a->gasmix;
 	res->start.mbar = a->start.mbar ?
 		a->start.mbar : b->start.mbar;
@@ -2662,27 +2829,94 @@ void free_events(struct event *ev)
 {
 	while (ev) {
 		struct event *next = ev->next;
-		free(ev);
+		logbook_free(ev);
 		ev = next;
 	}
 }
 
 static void free_extra_data(struct extra_data *ed)
 {
-	free((void *)ed->key);
-	free((void *)ed->value);
+	logbook_free((void *)ed->key);
+	logbook_free((void *)ed->value);
+	logbook_free(ed);
 }
 
 static void free_dc_contents(struct divecomputer *dc)
 {
-	free(dc->sample);
-	free((void *)dc->model);
-	free((void *)dc->serial);
-	free((void *)dc->fw_version);
+	release_shared_buffer(dc->sample);
+	free_packed_samples(dc);
+	release_string(dc->model);
+	release_string(dc->serial);
+	release_string(dc->fw_version);
 	free_events(dc->events);
 	STRUCTURED_LIST_FREE(struct extra_data, dc->extra_data, free_extra_data);
 }
 
+/*
+ * Events and extra data of a loaded logbook live in the logbook arena,
+ * which is released when the logbook is closed. Dives and dive computers
+ * that may outlive the logbook, notably the ones kept by the undo system,
+ * are moved out of the arena by replacing these objects with individually
+ * allocated copies. This handles the whole list of dive computers.
+ */
+void detach_dc_from_arena(struct divecomputer *dc)
+{
+	for (; dc; dc = dc->next) {
+		struct event **evp;
+		struct extra_data **edp;
+
+		for (evp = &dc->events; *evp; evp = &(*evp)->next) {
+			if (logbook_owns(*evp)) {
+				struct event *copy = clone_event(*evp);
+				copy->next = (*evp)->next;
+				*evp = copy;
+			}
+		}
+		for (edp = &dc->extra_data; *edp; edp = &(*edp)->next) {
+			struct extra_data *ed = *edp;
+			if (logbook_owns(ed)) {
+				ed = malloc(sizeof(struct extra_data));
+				if (!ed)
+					exit(1);
+				*ed = **edp;
+				*edp = ed;
+			}
+			if (logbook_owns(ed->key))
+				ed->key = copy_string(ed->key);
+			if (logbook_owns(ed->value))
+				ed->value = copy_string(ed->value);
+		}
+	}
+}
+
+void detach_dive_from_arena(struct dive *d)
+{
+	detach_dc_from_arena(&d->dc);
+}
+
+/*
+ * Replace the strings of a dive that are repeated throughout a logbook
+ * by their interned versions. Called by the parsers on every dive they load.
+ */
+void intern_dive_strings(struct dive *d)
+{
+	struct divecomputer *dc;
+	int i;
+
+	d->buddy = intern_owned_string(d->buddy);
+	d->divemaster = intern_owned_string(d->divemaster);
+	d->suit = intern_owned_string(d->suit);
+	for_each_dc (d, dc) {
+		dc->model = intern_owned_string((char *)dc->model);
+		dc->serial = intern_owned_string((char *)dc->serial);
+		dc->fw_version = intern_owned_string((char *)dc->fw_version);
+	}
+	for (i = 0; i < d->cylinders.nr; i++) {
+		cylinder_t *cyl = &d->cylinders.cylinders[i];
+		cyl->type.description = intern_owned_string((char *)cyl->type.description);
+	}
+}
+
 static void free_dc(struct divecomputer *dc)
 {
 	free_dc_contents(dc);
@@ -2697,7 +2931,7 @@ void free_picture(struct picture *picture)
 	}
 }
 
-static int same_sample(struct sample *a, struct sample *b)
+static int same_sample(const struct sample *a, const struct sample *b)
 {
 	if (a->time.seconds != b->time.seconds)
 		return 0;
@@ -2723,9 +2957,11 @@ static int same_dc(struct divecomputer *a, struct divecomputer *b)
 		return 0;
 	if (a->samples != b->samples)
 		return 0;
-	for (i = 0; i < a->samples; i++)
-		if (!same_sample(a->sample + i, b->sample + i))
+	for (i = 0; i < a->samples; i++) {
+		struct sample sa = get_sample(a, i), sb = get_sample(b, i);
+		if (!same_sample(&sa, &sb))
 			return 0;
+	}
 	eva = a->events;
 	evb = b->events;
 	while (eva && evb) {
@@ -2793,12 +3029,13 @@ static const struct divecomputer *find_matching_computer(const struct divecomput
 static void copy_dive_computer(struct divecomputer *res, const struct divecomputer *a)
 {
 	*res = *a;
-	res->model = copy_string(a->model);
-	res->serial = copy_string(a->serial);
-	res->fw_version = copy_string(a->fw_version);
+	res->model = intern_string(a->model);
+	res->serial = intern_string(a->serial);
+	res->fw_version = intern_string(a->fw_version);
 	STRUCTURED_LIST_COPY(struct extra_data, a->extra_data, res->extra_data, copy_extra_data);
 	res->samples = res->alloc_samples = 0;
 	res->sample = NULL;
+	res->packed_samples = NULL;
 	res->events = NULL;
 	res->next = NULL;
 }
@@ -2958,6 +3195,9 @@ struct dive *merge_dives(const struct dive *a, const struct dive *b, int offset,
 	MERGE_TXT(res, a, b, divemaster, ", ");
 	MERGE_MAX(res, a, b, rating);
 	MERGE_TXT(res, a, b, suit, ", ");
+	res->buddy = intern_owned_string(res->buddy);
+	res->divemaster = intern_owned_string(res->divemaster);
+	res->suit = intern_owned_string(res->suit);
 	MERGE_MAX(res, a, b, number);
 	MERGE_NONZERO(res, a, b, cns);
 	MERGE_NONZERO(res, a, b, visibility);
@@ -3079,6 +3319,8 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 	d1 = create_new_copy(dive);
 	d2 = create_new_copy(dive);
 	d1->divetrip = d2->divetrip = 0;
+	for_each_dc (d2, dc2)
+		unshare_samples(dc2);
 
 	/* now unselect the first first segment so we don't keep all
 	 * dives selected by mistake. But do keep the second one selected
@@ -3131,7 +3373,7 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 		*evp = NULL;
 		while (event) {
 			struct event *next = event->next;
-			free(event);
+			logbook_free(event);
 			event = next;
 		}
 
@@ -3140,7 +3382,7 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 		while ((event = *evp) != NULL) {
 			if (event->time.seconds < t) {
 				*evp = event->next;
-				free(event);
+				logbook_free(event);
 			} else {
 				event->time.seconds -= t;
 			}
@@ -3193,17 +3435,19 @@ int split_dive(const struct dive *dive, struct dive **new1, struct dive **new2)
 	int i;
 	int at_surface, surface_start;
 	const struct divecomputer *dc;
+	struct sample_column time, depth;
 
 	*new1 = *new2 = NULL;
 	if (!dive)
 		return -1;
 
 	dc = &dive->dc;
+	time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
 	surface_start = 0;
 	at_surface = 1;
 	for (i = 1; i < dc->samples; i++) {
-		struct sample *sample = dc->sample+i;
-		int surface_sample = sample->depth.mm < SURFACE_THRESHOLD;
+		int surface_sample = SAMPLE_VALUE(depth, depth_t, i).mm < SURFACE_THRESHOLD;
 
 		/*
 		 * We care about the transition from and to depth 0,
@@ -3223,7 +3467,7 @@ int split_dive(const struct dive *dive, struct dive **new1, struct dive **new2)
 		// the surface start.
 		if (!surface_start)
 			continue;
-		if (!should_split(dc, dc->sample[surface_start].time.seconds, sample[-1].time.seconds))
+		if (!should_split(dc, SAMPLE_VALUE(time, duration_t, surface_start).seconds, SAMPLE_VALUE(time, duration_t, i - 1).seconds))
 			continue;
 
 		return split_dive_at(dive, surface_start, i-1, new1, new2);
@@ -3238,10 +3482,9 @@ int split_dive_at_time(const struct dive *dive, duration_t time, struct dive **n
 	if (!dive)
 		return -1;
 
-	struct sample *sample = dive->dc.sample;
+	struct sample_column sample_time = get_sample_column(&dive->dc, SAMPLE_CHANNEL_TIME);
 	*new1 = *new2 = NULL;
-	while(sample->time.seconds < time.seconds) {
-		++sample;
+	while(SAMPLE_VALUE(sample_time, duration_t, i).seconds < time.seconds) {
 		++i;
 		if (dive->dc.samples == i)
 			return -1;
@@ -3261,11 +3504,12 @@ static inline int dc_totaltime(const struct divecomputer *dc)
 {
 	int time = dc->duration.seconds;
 	int nr = dc->samples;
+	struct sample_column sample_time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	struct sample_column depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
 
 	while (nr--) {
-		struct sample *s = dc->sample + nr;
-		time = s->time.seconds;
-		if (s->depth.mm >= SURFACE_THRESHOLD)
+		time = SAMPLE_VALUE(sample_time, duration_t, nr).seconds;
+		if (SAMPLE_VALUE(depth, depth_t, nr).mm >= SURFACE_THRESHOLD)
 			break;
 	}
 	return time;
@@ -3698,12 +3942,15 @@ void split_divecomputer(const struct dive *src, int num, struct dive **out1, str
 int get_depth_at_time(const struct divecomputer *dc, unsigned int time)
 {
 	int depth = 0;
-	if (dc && dc->sample)
+	if (dc && dc->samples) {
+		struct sample_column sample_time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+		struct sample_column sample_depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
 		for (int i = 0; i < dc->samples; i++) {
-			if (dc->sample[i].time.seconds > time)
+			if (SAMPLE_VALUE(sample_time, duration_t, i).seconds > time)
 				break;
-			depth = dc->sample[i].depth.mm;
+			depth = SAMPLE_VALUE(sample_depth, depth_t, i).mm;
 		}
+	}
 	return depth;
 }
 
@@ -3739,6 +3986,11 @@ fraction_t best_he(depth_t depth, const struct dive *dive, bool o2narcotic, frac
 void invalidate_dive_cache(struct dive *dive)
 {
 	memset(dive->git_id, 0, 20);
+	/* Copies of dives, such as the displayed dive, don't have cached tissues */
+	if (get_dive(get_divenr(dive)) == dive) {
+		invalidate_tissue_cache(dive);
+		invalidate_plot_info_cache(dive);
+	}
 }
 
 bool dive_cache_is_valid(const struct dive *dive)
@@ -3904,42 +4156,6 @@ struct divecomputer *get_dive_dc(struct dive *dive, int nr)
 	return dc;
 }
 
-struct dive *get_dive_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return dive;
-}
-
-int get_idx_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return i;
-}
-
 bool dive_site_has_gps_location(const struct dive_site *ds)
 {
 	return ds && has_location(&ds->location);
@@ -4011,6 +4227,11 @@ struct gasmix get_gasmix(const struct dive *dive, const struct divecomputer *dc,
 
 	if (!ev) {
 		/* on first invocation, get initial gas mix and first event (if any) */
+		const struct event_index *gaschanges = get_active_event_index(dc, "gaschange");
+		if (gaschanges) {
+			*evp = event_index_next_after(gaschanges, time);
+			return get_gasmix_indexed(dive, dc, gaschanges, time);
+		}
 		int cyl = explicit_first_cylinder(dive, dc);
 		res = get_cylinder(dive, cyl)->gasmix;
 		ev = dc ? get_next_event(dc->events, "gaschange") : NULL;
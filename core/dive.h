@@ -97,6 +97,8 @@ struct extra_data {
 	struct extra_data *next;
 };
 
+struct sample_columns;
+
 /*
  * NOTE! The deviceid and diveid are model-specific *hashes* of
  * whatever device identification that model may have. Different
@@ -123,6 +125,7 @@ struct divecomputer {
 	uint32_t deviceid, diveid;
 	int samples, alloc_samples;
 	struct sample *sample;
+	struct sample_columns *packed_samples;	// if non-null, samples are stored in columnar form and sample is NULL (see pack_dive_samples())
 	struct event *events;
 	struct extra_data *extra_data;
 	struct divecomputer *next;
@@ -346,6 +349,14 @@ extern struct dive *move_dive(struct dive *s);
 
 extern void alloc_samples(struct divecomputer *dc, int num);
 extern void free_samples(struct divecomputer *dc);
+extern void unshare_samples(struct divecomputer *dc);
+extern void pack_dive_samples(struct dive *d);
+extern struct sample get_sample(const struct divecomputer *dc, int idx);
+extern const struct sample *get_sample_array(const struct divecomputer *dc);
+extern void free_sample_array(const struct divecomputer *dc, const struct sample *samples);
+extern void detach_dc_from_arena(struct divecomputer *dc);
+extern void detach_dive_from_arena(struct dive *d);
+extern void intern_dive_strings(struct dive *d);
 extern struct sample *prepare_sample(struct divecomputer *dc);
 extern void finish_sample(struct divecomputer *dc);
 extern struct sample *add_sample(const struct sample *sample, int time, struct divecomputer *dc);
@@ -2,15 +2,20 @@
 /* divelist.c */
 
 #include "subsurface-string.h"
+#include "arena.h"
 #include "deco.h"
 #include "divesite.h"
+#include "eventindex.h"
 #include "divelist.h"
 #include "planner.h"
+#include "samplecolumns.h"
 #include "qthelper.h"
 #include "gettext.h"
 #include "git-access.h"
 #include "selection.h"
 #include "table.h"
+#include "plotinfocache.h"
+#include "tissuecache.h"
 #include "trip.h"
 
 /* This flag is set to true by operations that are not implemented in the
@@ -76,9 +81,9 @@ int total_weight(const struct dive *dive)
 	return total_grams;
 }
 
-static int active_o2(const struct dive *dive, const struct divecomputer *dc, duration_t time)
+static int active_o2(const struct dive *dive, const struct divecomputer *dc, const struct event_index *gaschanges, duration_t time)
 {
-	struct gasmix gas = get_gasmix_at_time(dive, dc, time);
+	struct gasmix gas = get_gasmix_indexed(dive, dc, gaschanges, time.seconds);
 	return get_o2(gas);
 }
 
@@ -94,24 +99,29 @@ static int calculate_otu(const struct dive *dive)
 	int i;
 	double otu = 0.0;
 	const struct divecomputer *dc = &dive->dc;
+	struct sample_column time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	struct sample_column depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+	struct sample_column o2sensor = get_sample_column(dc, SAMPLE_CHANNEL_O2SENSOR0);
+	struct sample_column setpoint = get_sample_column(dc, SAMPLE_CHANNEL_SETPOINT);
+	struct event_index gaschanges;
+
+	build_event_index(&gaschanges, dc, "gaschange");
 	for (i = 1; i < dc->samples; i++) {
 		int t;
 		int po2i, po2f;
 		double pm;
-		struct sample *sample = dc->sample + i;
-		struct sample *psample = sample - 1;
-		t = sample->time.seconds - psample->time.seconds;
-		if (sample->o2sensor[0].mbar) {			// if dive computer has o2 sensor(s) (CCR & PSCR) ..
-			po2i = psample->o2sensor[0].mbar;
-			po2f = sample->o2sensor[0].mbar;	// ... use data from the first o2 sensor
+		t = SAMPLE_VALUE(time, duration_t, i).seconds - SAMPLE_VALUE(time, duration_t, i - 1).seconds;
+		if (SAMPLE_VALUE(o2sensor, o2pressure_t, i).mbar) {	// if dive computer has o2 sensor(s) (CCR & PSCR) ..
+			po2i = SAMPLE_VALUE(o2sensor, o2pressure_t, i - 1).mbar;
+			po2f = SAMPLE_VALUE(o2sensor, o2pressure_t, i).mbar;	// ... use data from the first o2 sensor
 		} else {
 			if (dc->divemode == CCR) {
-				po2i = psample->setpoint.mbar;		// if CCR has no o2 sensors then use setpoint
-				po2f = sample->setpoint.mbar;
+				po2i = SAMPLE_VALUE(setpoint, o2pressure_t, i - 1).mbar;	// if CCR has no o2 sensors then use setpoint
+				po2f = SAMPLE_VALUE(setpoint, o2pressure_t, i).mbar;
 			} else {						// For OC and rebreather without o2 sensor/setpoint
-				int o2 = active_o2(dive, dc, psample->time);	// 	... calculate po2 from depth and FiO2.
-				po2i = lrint(o2 * depth_to_atm(psample->depth.mm, dive));	// (initial) po2 at start of segment
-				po2f = lrint(o2 * depth_to_atm(sample->depth.mm, dive));	// (final) po2 at end of segment
+				int o2 = active_o2(dive, dc, &gaschanges, SAMPLE_VALUE(time, duration_t, i - 1));	// 	... calculate po2 from depth and FiO2.
+				po2i = lrint(o2 * depth_to_atm(SAMPLE_VALUE(depth, depth_t, i - 1).mm, dive));	// (initial) po2 at start of segment
+				po2f = lrint(o2 * depth_to_atm(SAMPLE_VALUE(depth, depth_t, i).mm, dive));	// (final) po2 at end of segment
 			}
 		}
 		if ((po2i > 500) || (po2f > 500)) {			// If PO2 in segment is above 500 mbar then calculate otu
@@ -129,6 +139,7 @@ static int calculate_otu(const struct dive *dive)
 			otu += t / 60.0 * pow(pm, 5.0/6.0) * (1.0 - 5.0 * (po2f - po2i) * (po2f - po2i) / 216000000.0 / (pm * pm));
 		}
 	}
+	free_event_index(&gaschanges);
 	return lrint(otu);
 }
 
@@ -147,28 +158,33 @@ static double calculate_cns_dive(const struct dive *dive)
 	const struct divecomputer *dc = &dive->dc;
 	double cns = 0.0;
 	double rate;
+	struct sample_column time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	struct sample_column depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+	struct sample_column o2sensor = get_sample_column(dc, SAMPLE_CHANNEL_O2SENSOR0);
+	struct sample_column setpoint = get_sample_column(dc, SAMPLE_CHANNEL_SETPOINT);
+	struct event_index gaschanges;
+
+	build_event_index(&gaschanges, dc, "gaschange");
 	/* Calculate the CNS for each sample in this dive and sum them */
 	for (n = 1; n < dc->samples; n++) {
 		int t;
 		int po2i, po2f;
 		bool trueo2 = false;
-		struct sample *sample = dc->sample + n;
-		struct sample *psample = sample - 1;
-		t = sample->time.seconds - psample->time.seconds;
-		if (sample->o2sensor[0].mbar) {			// if dive computer has o2 sensor(s) (CCR & PSCR)
-			po2i = psample->o2sensor[0].mbar;
-			po2f = sample->o2sensor[0].mbar;	// then use data from the first o2 sensor
+		t = SAMPLE_VALUE(time, duration_t, n).seconds - SAMPLE_VALUE(time, duration_t, n - 1).seconds;
+		if (SAMPLE_VALUE(o2sensor, o2pressure_t, n).mbar) {	// if dive computer has o2 sensor(s) (CCR & PSCR)
+			po2i = SAMPLE_VALUE(o2sensor, o2pressure_t, n - 1).mbar;
+			po2f = SAMPLE_VALUE(o2sensor, o2pressure_t, n).mbar;	// then use data from the first o2 sensor
 			trueo2 = true;
 		}
 		if ((dc->divemode == CCR) && (!trueo2)) {
-			po2i = psample->setpoint.mbar;		// if CCR has no o2 sensors then use setpoint
-			po2f = sample->setpoint.mbar;
+			po2i = SAMPLE_VALUE(setpoint, o2pressure_t, n - 1).mbar;	// if CCR has no o2 sensors then use setpoint
+			po2f = SAMPLE_VALUE(setpoint, o2pressure_t, n).mbar;
 			trueo2 = true;
 		}
 		if (!trueo2) {
-			int o2 = active_o2(dive, dc, psample->time);			// For OC and rebreather without o2 sensor:
-			po2i = lrint(o2 * depth_to_atm(psample->depth.mm, dive));	// (initial) po2 at start of segment
-			po2f = lrint(o2 * depth_to_atm(sample->depth.mm, dive));	// (final) po2 at end of segment
+			int o2 = active_o2(dive, dc, &gaschanges, SAMPLE_VALUE(time, duration_t, n - 1));	// For OC and rebreather without o2 sensor:
+			po2i = lrint(o2 * depth_to_atm(SAMPLE_VALUE(depth, depth_t, n - 1).mm, dive));	// (initial) po2 at start of segment
+			po2f = lrint(o2 * depth_to_atm(SAMPLE_VALUE(depth, depth_t, n).mm, dive));	// (final) po2 at end of segment
 		}
 		po2i = (po2i + po2f) / 2;	// po2i now holds the mean po2 of initial and final po2 values of segment.
 		/* Don't increase CNS when po2 below 500 matm */
@@ -179,6 +195,7 @@ static double calculate_cns_dive(const struct dive *dive)
 		rate = po2i <= 1500 ? exp(-11.7853 + 0.00193873 * po2i) : exp(-23.6349 + 0.00980829 * po2i);
 		cns += (double) t * rate * 100.0;
 	}
+	free_event_index(&gaschanges);
 	return cns;
 }
 
@@ -243,6 +260,14 @@ static int calculate_cns(struct dive *dive)
 #endif
 			break;
 		}
+		/* The CNS after a dive that was replayed before? Start from there. */
+		if ((divenr < 0 || i < divenr) && get_cached_cns(pdive, dive->divetrip, &cns)) {
+#if DECO_CALC_DEBUG & 2
+			printf("Yes - use cached CNS\n");
+#endif
+			last_endtime = dive_endtime(pdive);
+			break;
+		}
 		last_starttime = pdive->when;
 #if DECO_CALC_DEBUG & 2
 		printf("Yes\n");
@@ -290,6 +315,9 @@ static int calculate_cns(struct dive *dive)
 #if DECO_CALC_DEBUG & 2
 		printf("CNS after previous dive: %f\n", cns);
 #endif
+		/* Dives after the copy of the dive were replayed without it */
+		if (divenr < 0 || i < divenr)
+			cache_cns(pdive, dive->divetrip, cns);
 
 		last_starttime = pdive->when;
 		last_endtime = dive_endtime(pdive);
@@ -369,46 +397,230 @@ static int calculate_sac(const struct dive *dive)
 }
 
 /* for now we do this based on the first divecomputer */
+/*
+ * The first time after 'time' and before 'end' at which the gas or the dive
+ * mode changes, or 'end' if there is no such change. Gas changes take effect
+ * at their time, mode changes one second later.
+ */
+static int next_gas_or_mode_change(const struct event_index *gaschanges, const struct event_index *modechanges, int time, int end)
+{
+	const struct event *ev = event_index_next_after(gaschanges, time);
+	if (ev && (int)ev->time.seconds < end)
+		end = ev->time.seconds;
+	ev = event_index_next_after(modechanges, time - 1);
+	if (ev && (int)ev->time.seconds + 1 < end)
+		end = ev->time.seconds + 1;
+	return end;
+}
+
 static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 {
 	struct divecomputer *dc = &dive->dc;
-	struct gasmix gasmix = gasmix_air;
+	struct sample_column time, depth, setpoint;
+	struct event_index gaschanges, modechanges;
 	int i;
-	const struct event *ev = NULL, *evd = NULL;
-	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
 
 	if (!dc)
 		return;
 
+	time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+	setpoint = get_sample_column(dc, SAMPLE_CHANNEL_SETPOINT);
+	build_event_index(&gaschanges, dc, "gaschange");
+	build_event_index(&modechanges, dc, "modechange");
+	/* Depths are linear between samples, so feed the tissue model whole ramps */
 	for (i = 1; i < dc->samples; i++) {
-		struct sample *psample = dc->sample + i - 1;
-		struct sample *sample = dc->sample + i;
-		int t0 = psample->time.seconds;
-		int t1 = sample->time.seconds;
-		int j;
-
-		for (j = t0; j < t1; j++) {
-			int depth = interpolate(psample->depth.mm, sample->depth.mm, j - t0, t1 - t0);
-			gasmix = get_gasmix(dive, dc, j, &ev, gasmix);
-			add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, sample->setpoint.mbar,
-				get_current_divemode(&dive->dc, j, &evd, &current_divemode), dive->sac);
+		int t0 = SAMPLE_VALUE(time, duration_t, i - 1).seconds;
+		int t1 = SAMPLE_VALUE(time, duration_t, i).seconds;
+		int pdepth = SAMPLE_VALUE(depth, depth_t, i - 1).mm;
+		int sdepth = SAMPLE_VALUE(depth, depth_t, i).mm;
+		int j, next;
+
+		for (j = t0; j < t1; j = next) {
+			int depth0 = interpolate(pdepth, sdepth, j - t0, t1 - t0);
+			int depth1;
+			next = next_gas_or_mode_change(&gaschanges, &modechanges, j, t1);
+			depth1 = interpolate(pdepth, sdepth, next - t0, t1 - t0);
+			add_segment_linear(ds, depth_to_bar(depth0, dive), depth_to_bar(depth1, dive),
+					   get_gasmix_indexed(dive, dc, &gaschanges, j), next - j, SAMPLE_VALUE(setpoint, o2pressure_t, i).mbar,
+					   get_divemode_indexed(dc, &modechanges, j), dive->sac);
 		}
 	}
+	free_event_index(&gaschanges);
+	free_event_index(&modechanges);
 }
 
-int get_divenr(const struct dive *dive)
+/*
+ * Hash index of the global dive table, mapping unique dive ids to
+ * indexes into the table. The table functions below call
+ * update_dive_id_index() (via dive_table_changed()) whenever entries
+ * move, which updates the index from that position on.
+ *
+ * The index is only modified together with the dive table. Lookups
+ * merely read it and may therefore be done from worker threads, such
+ * as the ones calculating plans, as long as the dive table itself is
+ * not modified at the same time.
+ *
+ * Entries of removed dives are not deleted, they simply become stale.
+ * Therefore, lookups check that the found dive actually has the
+ * searched-for id. Stale entries are dropped when the index is rebuilt.
+ */
+struct dive_id_entry {
+	int id;
+	int idx;		/* -1: empty slot */
+};
+
+static struct {
+	int size;		/* number of slots, zero or a power of two */
+	int used;		/* number of non-empty slots, including stale ones */
+	int valid;		/* entries for table positions below this are up to date */
+	struct dive_id_entry *entries;
+} dive_id_index;
+
+static unsigned int dive_id_hash(int id)
+{
+	/* Fibonacci hashing - ids are handed out in small increments */
+	return (unsigned int)id * 2654435761u;
+}
+
+static void dive_id_index_set(int id, int idx)
+{
+	unsigned int mask = dive_id_index.size - 1;
+	unsigned int slot = dive_id_hash(id) & mask;
+	struct dive_id_entry *entry;
+
+	while ((entry = &dive_id_index.entries[slot])->idx >= 0 && entry->id != id)
+		slot = (slot + 1) & mask;
+	if (entry->idx < 0)
+		dive_id_index.used++;
+	entry->id = id;
+	entry->idx = idx;
+}
+
+static void rebuild_dive_id_index()
+{
+	int i, size = 64;
+
+	while (size < 4 * dive_table.nr)
+		size *= 2;
+	if (size != dive_id_index.size) {
+		free(dive_id_index.entries);
+		dive_id_index.entries = malloc(size * sizeof(struct dive_id_entry));
+		if (!dive_id_index.entries)
+			exit(1);
+		dive_id_index.size = size;
+	}
+	for (i = 0; i < size; i++)
+		dive_id_index.entries[i].idx = -1;
+	dive_id_index.used = 0;
+	for (i = 0; i < dive_table.nr; i++)
+		dive_id_index_set(dive_table.dives[i]->id, i);
+	dive_id_index.valid = dive_table.nr;
+}
+
+static void refresh_dive_id_index()
 {
 	int i;
-	const struct dive *d;
-	// tempting as it may be, don't die when called with dive=NULL
-	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
+
+	if (dive_id_index.valid >= dive_table.nr && dive_id_index.size)
+		return;
+
+	/* Keep the load factor below 1/2, counting stale entries */
+	if (dive_id_index.valid == 0 ||
+	    2 * (dive_id_index.used + dive_table.nr - dive_id_index.valid) >= dive_id_index.size) {
+		rebuild_dive_id_index();
+		return;
+	}
+	for (i = dive_id_index.valid; i < dive_table.nr; i++)
+		dive_id_index_set(dive_table.dives[i]->id, i);
+	dive_id_index.valid = dive_table.nr;
+}
+
+/* Called via dive_table_changed(): the entries of "table" starting at
+ * position "idx" have changed. Only the global dive table is indexed. */
+static void update_dive_id_index(struct dive_table *table, int idx)
+{
+	if (table != &dive_table)
+		return;
+	if (idx < dive_id_index.valid)
+		dive_id_index.valid = idx;
+	refresh_dive_id_index();
+}
+
+/* Hook of the dive table functions: the entries of "table" starting at
+ * position "idx" have changed. Since the dives are sorted by time, the
+ * cached tissues and plot infos of the dives at and after that position
+ * are outdated. */
+static void dive_table_changed(struct dive_table *table, int idx)
+{
+	update_dive_id_index(table, idx);
+	if (table != &dive_table)
+		return;
+	if (idx == 0) {
+		clear_tissue_cache();
+		clear_plot_info_cache();
+	} else if (idx < table->nr) {
+		invalidate_tissue_cache_from(table->dives[idx]->when);
+		invalidate_plot_info_cache_from(table->dives[idx]->when);
+	}
+}
+
+/* Returns the index of the dive with the given id in the global
+ * dive table or -1 if there is no such dive. */
+static int lookup_dive_id_index(int id)
+{
+	unsigned int mask, slot;
+	const struct dive_id_entry *entry;
+
+	if (!dive_id_index.size)
+		return -1;
+	mask = dive_id_index.size - 1;
+	slot = dive_id_hash(id) & mask;
+	while ((entry = &dive_id_index.entries[slot])->idx >= 0) {
+		if (entry->id == id) {
+			if (entry->idx < dive_table.nr && dive_table.dives[entry->idx]->id == id)
+				return entry->idx;
+			return -1; /* stale entry of a removed dive */
 		}
+		slot = (slot + 1) & mask;
+	}
 	return -1;
 }
 
+int get_divenr(const struct dive *dive)
+{
+	// tempting as it may be, don't die when called with dive=NULL
+	if (!dive)
+		return -1;
+	// don't compare pointers, we could be passing in a copy of the dive
+	return lookup_dive_id_index(dive->id);
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	int idx = lookup_dive_id_index(id);
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx >= 0 ? dive_table.dives[idx] : NULL;
+}
+
+/* Note: for historical reasons, returns the number of dives if the id is not found */
+int get_idx_by_uniq_id(int id)
+{
+	int idx = lookup_dive_id_index(id);
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx >= 0 ? idx : dive_table.nr;
+}
+
 static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
 
 /* take into account previous dives until there is a 48h gap between dives */
@@ -475,6 +687,16 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 #endif
 			break;
 		}
+		/* The tissues after a dive that was replayed before? Start from there. */
+		if ((divenr < 0 || i < divenr) &&
+		    get_cached_tissues(pdive, dive->divetrip, dive->dc.divemode, prefs.decosac, ds)) {
+#if DECO_CALC_DEBUG & 2
+			printf("Yes - use cached tissues\n");
+#endif
+			deco_init = true;
+			last_endtime = dive_endtime(pdive);
+			break;
+		}
 		last_starttime = pdive->when;
 #if DECO_CALC_DEBUG & 2
 		printf("Yes\n");
@@ -543,6 +765,9 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 		last_starttime = pdive->when;
 		last_endtime = dive_endtime(pdive);
 		clear_vpmb_state(ds);
+		/* Dives after the copy of the dive were replayed without it */
+		if (divenr < 0 || i < divenr)
+			cache_tissues(pdive, dive->divetrip, dive->dc.divemode, prefs.decosac, ds);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after added dive #%d:\n", pdive->number);
 		dump_tissues(ds);
@@ -590,6 +815,139 @@ void update_cylinder_related_info(struct dive *dive)
 	}
 }
 
+/*
+ * A sequence of dives, as seen by the dives of a trip or, for trip == NULL,
+ * by dives outside of trips. None of the dives is more than 48 h after the
+ * end of the previous dive, i.e. the tissue loading of the dives only
+ * depends on the earlier dives of the chain.
+ */
+struct dive_chain {
+	const struct dive_trip *trip;
+	struct dive **dives;
+	int nr;
+};
+
+static bool has_sample_cns(const struct dive *dive)
+{
+	int i;
+	struct sample_column cns = get_sample_column(&dive->dc, SAMPLE_CHANNEL_CNS);
+
+	for (i = 0; i < dive->dc.samples; i++) {
+		if (SAMPLE_VALUE(cns, uint16_t, i))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Replay a chain like init_decompression() and calculate_cns() would do
+ * for the dive after each of its dives. The surface intervals are added in
+ * the divemode of the first dive, which is right for logs of one kind of
+ * dives. The derived data is only set for dives that see the chain, i.e.
+ * that belong to its trip.
+ */
+static void update_dive_chain(void *data)
+{
+	const struct dive_chain *chain = data;
+	struct deco_state ds;
+	enum divemode_t divemode = chain->dives[0]->dc.divemode;
+	timestamp_t last_endtime = 0;
+	double cns = 0.0;
+	bool cache = true;
+	int i;
+
+	init_deco_config(&ds.config, false);
+	for (i = 0; i < chain->nr; i++) {
+		struct dive *dive = chain->dives[i];
+		double surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
+
+		if (i == 0) {
+			clear_deco(&ds, surface_pressure);
+		} else {
+			int surface_time = dive->when - last_endtime;
+			/* Overlapping dives: there is no meaningful tissue state */
+			if (surface_time < 0)
+				cache = false;
+			else
+				add_segment(&ds, surface_pressure, air, surface_time, 0, divemode, prefs.decosac);
+			/* CNS reduced with 90min halftime during surface interval */
+			if (last_endtime + 12 * 60 * 60 < dive->when)
+				cns = 0.0;
+			else
+				cns /= pow(2, (dive->when - last_endtime) / (90.0 * 60.0));
+		}
+		cns += calculate_cns_dive(dive);
+		cache_cns(dive, chain->trip, cns);
+
+		if (dive->divetrip == chain->trip) {
+			dive->sac = calculate_sac(dive);
+			dive->otu = calculate_otu(dive);
+			if (!has_sample_cns(dive)) {
+				dive->cns = lrint(cns);
+				dive->maxcns = dive->cns;
+			}
+		}
+
+		/* The state after the last dive of the chain is never needed */
+		if (i < chain->nr - 1) {
+			add_dive_to_deco(&ds, dive);
+			clear_vpmb_state(&ds);
+			if (cache)
+				cache_tissues(dive, chain->trip, divemode, prefs.decosac, &ds);
+		}
+		last_endtime = dive_endtime(dive);
+	}
+}
+
+/* Split a time-sorted sequence of dives into chains and append them to the array */
+static int add_dive_chains(struct dive_chain **chains, int *allocated, int nr, const struct dive_trip *trip, struct dive **dives, int nr_dives)
+{
+	int i, start = 0;
+
+	for (i = 1; i <= nr_dives; i++) {
+		if (i < nr_dives && dives[i]->when <= dive_endtime(dives[i - 1]) + 48 * 60 * 60)
+			continue;
+		if (nr >= *allocated) {
+			*allocated = (nr + 16) * 3 / 2;
+			*chains = realloc(*chains, *allocated * sizeof(**chains));
+			if (!*chains)
+				exit(1);
+		}
+		(*chains)[nr].trip = trip;
+		(*chains)[nr].dives = dives + start;
+		(*chains)[nr].nr = i - start;
+		nr++;
+		start = i;
+	}
+	return nr;
+}
+
+/*
+ * Calculate SAC, OTU and CNS of all dives and fill the tissue cache in one
+ * pass over the dive log. Dives in trips only see the dives of their trip,
+ * the other dives see all dives. Since the tissue loading and the CNS are
+ * reset after 48 h without diving, these sequences fall apart into chains
+ * that are calculated in parallel.
+ */
+void update_all_derived_dive_data()
+{
+	struct dive_chain *chains = NULL;
+	int i, nr = 0, allocated = 0;
+
+	for (i = 0; i < trip_table.nr; i++) {
+		struct dive_trip *trip = trip_table.trips[i];
+		nr = add_dive_chains(&chains, &allocated, nr, trip, trip->dives.dives, trip->dives.nr);
+	}
+	for (i = 0; i < dive_table.nr; i++) {
+		if (!dive_table.dives[i]->divetrip) {
+			nr = add_dive_chains(&chains, &allocated, nr, NULL, dive_table.dives, dive_table.nr);
+			break;
+		}
+	}
+	run_in_parallel(update_dive_chain, chains, sizeof(*chains), nr);
+	free(chains);
+}
+
 #define MAX_GAS_STRING 80
 
 /* callers needs to free the string */
@@ -693,13 +1051,31 @@ int comp_dives(const struct dive *a, const struct dive *b)
 /* Dive table functions */
 static MAKE_GROW_TABLE(dive_table, struct dive *, dives)
 MAKE_GET_INSERTION_INDEX(dive_table, struct dive *, dives, dive_less_than)
-MAKE_ADD_TO(dive_table, struct dive *, dives)
-static MAKE_REMOVE_FROM(dive_table, dives)
-static MAKE_GET_IDX(dive_table, struct dive *, dives)
-MAKE_SORT(dive_table, struct dive *, dives, comp_dives)
+MAKE_ADD_TO_WITH_HOOK(dive_table, struct dive *, dives, dive_table_changed)
+static MAKE_REMOVE_FROM_WITH_HOOK(dive_table, dives, dive_table_changed)
+MAKE_SORT_WITH_HOOK(dive_table, struct dive *, dives, comp_dives, dive_table_changed)
+MAKE_ADD_ITEMS_WITH_HOOK(dive_table, struct dive *, dives, dive_less_than, dive_table_changed)
+
+/* Like the generic get_idx_in_*_table() function, but uses the
+ * id index if searching in the global dive table. */
+static int get_idx_in_dive_table(const struct dive_table *table, const struct dive *dive)
+{
+	int i;
+
+	if (table == &dive_table) {
+		i = lookup_dive_id_index(dive->id);
+		return i >= 0 && dive_table.dives[i] == dive ? i : -1;
+	}
+	for (i = 0; i < table->nr; ++i) {
+		if (table->dives[i] == dive)
+			return i;
+	}
+	return -1;
+}
+
 MAKE_REMOVE(dive_table, struct dive *, dive)
-MAKE_CLEAR_TABLE(dive_table, dives, dive)
-MAKE_MOVE_TABLE(dive_table, dives)
+MAKE_CLEAR_TABLE_WITH_HOOK(dive_table, dives, dive, dive_table_changed)
+MAKE_MOVE_TABLE_WITH_HOOK(dive_table, dives, dive_table_changed)
 
 void insert_dive(struct dive_table *table, struct dive *d)
 {
@@ -707,6 +1083,13 @@ void insert_dive(struct dive_table *table, struct dive *d)
 	add_to_dive_table(table, idx, d);
 }
 
+/* Insert a number of dives into a sorted table. This is much faster than
+ * calling insert_dive() for every dive. Note: the "dives" array is sorted. */
+void insert_dives(struct dive_table *table, struct dive **dives, int nr)
+{
+	add_items_to_dive_table(table, dives, nr);
+}
+
 /*
  * Walk the dives from the oldest dive in the given table, and see if we
  * can autogroup them. But only do this when the user selected autogrouping.
@@ -816,12 +1199,14 @@ void process_loaded_dives()
 	int i;
 	struct dive *dive;
 
-	/* Register dive computer nick names and count shown dives. */
+	/* Register dive computer nick names and count shown dives.
+	 * The dives of the dive list keep their samples packed. */
 	shown_dives = 0;
 	for_each_dive(i, dive) {
 		if (!dive->hidden_by_filter)
 			shown_dives++;
 		set_dc_nickname(dive);
+		pack_dive_samples(dive);
 	}
 
 	sort_dive_table(&dive_table);
@@ -829,6 +1214,8 @@ void process_loaded_dives()
 
 	/* Autogroup dives if desired by user. */
 	autogroup_dives(&dive_table, &trip_table);
+
+	update_all_derived_dive_data();
 }
 
 /*
@@ -1011,6 +1398,7 @@ void add_imported_dives(struct dive_table *import_table, struct trip_table *impo
 		d->dive_site = NULL;
 		add_dive_to_trip(d, trip);
 		add_dive_to_dive_site(d, site);
+		pack_dive_samples(d);
 	}
 
 	/* Remove old dives */
@@ -1021,18 +1409,15 @@ void add_imported_dives(struct dive_table *import_table, struct trip_table *impo
 	dives_to_remove.nr = 0;
 
 	/* Add new dives */
-	for (i = 0; i < dives_to_add.nr; i++)
-		insert_dive(&dive_table, dives_to_add.dives[i]);
+	insert_dives(&dive_table, dives_to_add.dives, dives_to_add.nr);
 	dives_to_add.nr = 0;
 
 	/* Add new trips */
-	for (i = 0; i < trips_to_add.nr; i++)
-		insert_trip(trips_to_add.trips[i], &trip_table);
+	insert_trips(trips_to_add.trips, trips_to_add.nr, &trip_table);
 	trips_to_add.nr = 0;
 
 	/* Add new dive sites */
-	for (i = 0; i < dive_sites_to_add.nr; i++)
-		register_dive_site(dive_sites_to_add.dive_sites[i]);
+	add_dive_sites_to_table(dive_sites_to_add.dive_sites, dive_sites_to_add.nr, &dive_site_table);
 	dive_sites_to_add.nr = 0;
 
 	/* We might have deleted the old selected dive.
@@ -1214,13 +1599,10 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		 * First, add dives to list of dives to add */
 		for (j = 0; j < trip_import->dives.nr; j++) {
 			struct dive *d = trip_import->dives.dives[j];
-
-			/* Add dive to list of dives to-be-added. */
-			insert_dive(dives_to_add, d);
 			sequence_changed |= !dive_is_after_last(d);
-
 			remove_dive(d, import_table);
 		}
+		insert_dives(dives_to_add, trip_import->dives.dives, trip_import->dives.nr);
 
 		/* Then, add trip to list of trips to add */
 		insert_trip(trip_import, trips_to_add);
@@ -1237,9 +1619,9 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		for (i = 0; i < import_table->nr; i++) {
 			struct dive *d = import_table->dives[i];
 			d->divetrip = new_trip;
-			insert_dive(dives_to_add, d);
 			sequence_changed |= !dive_is_after_last(d);
 		}
+		insert_dives(dives_to_add, import_table->dives, import_table->nr);
 
 		import_table->nr = 0; /* All dives were consumed */
 	} else if (import_table->nr > 0) {
@@ -1351,6 +1733,9 @@ void clear_dive_file_data()
 
 	clear_dive(&displayed_dive);
 
+	/* All objects of the logbook are gone - release their memory en bloc */
+	clear_logbook_arena();
+
 	reset_min_datafile_version();
 	clear_git_id();
 }
@@ -15,6 +15,7 @@ extern int shown_dives;
 #define DATAFORMAT_VERSION 3
 
 extern void update_cylinder_related_info(struct dive *);
+extern void update_all_derived_dive_data();
 extern void mark_divelist_changed(bool);
 extern int unsaved_changes(void);
 extern int init_decompression(struct deco_state *ds, struct dive *dive);
@@ -38,6 +39,7 @@ extern int dive_table_get_insertion_index(struct dive_table *table, struct dive
 extern void add_to_dive_table(struct dive_table *table, int idx, struct dive *dive);
 extern void append_dive(struct dive *dive);
 extern void insert_dive(struct dive_table *table, struct dive *d);
+extern void insert_dives(struct dive_table *table, struct dive **dives, int nr);
 extern void get_dive_gas(const struct dive *dive, int *o2_p, int *he_p, int *o2low_p);
 extern int get_divenr(const struct dive *dive);
 extern int remove_dive(const struct dive *dive, struct dive_table *table);
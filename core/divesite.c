@@ -25,14 +25,20 @@ int get_divesite_idx(const struct dive_site *ds, struct dive_site_table *ds_tabl
 	return -1;
 }
 
-// TODO: keep table sorted by UUID and do a binary search?
+/* dive site tables are sorted by uuid, so we can use binary search */
 struct dive_site *get_dive_site_by_uuid(uint32_t uuid, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, ds_table)
+	int lo = 0, hi = ds_table->nr;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		struct dive_site *ds = ds_table->dive_sites[mid];
 		if (ds->uuid == uuid)
-			return get_dive_site(i, ds_table);
+			return ds;
+		if (ds->uuid < uuid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 	return NULL;
 }
 
@@ -129,28 +135,33 @@ static MAKE_ADD_TO(dive_site_table, struct dive_site *, dive_sites)
 static MAKE_REMOVE_FROM(dive_site_table, dive_sites)
 static MAKE_GET_IDX(dive_site_table, struct dive_site *, dive_sites)
 MAKE_SORT(dive_site_table, struct dive_site *, dive_sites, compare_sites)
+MAKE_ADD_ITEMS(dive_site_table, struct dive_site *, dive_sites, site_less_than)
 static MAKE_REMOVE(dive_site_table, struct dive_site *, dive_site)
 MAKE_CLEAR_TABLE(dive_site_table, dive_sites, dive_site)
 MAKE_MOVE_TABLE(dive_site_table, dive_sites)
 
+/* If the site doesn't yet have an UUID, create a new one.
+ * Make this deterministic for testing. */
+static void create_dive_site_uuid(struct dive_site *ds)
+{
+	SHA_CTX ctx;
+	uint32_t csum[5];
+
+	SHA1_Init(&ctx);
+	if (ds->name)
+		SHA1_Update(&ctx, ds->name, strlen(ds->name));
+	if (ds->description)
+		SHA1_Update(&ctx, ds->description, strlen(ds->description));
+	if (ds->notes)
+		SHA1_Update(&ctx, ds->notes, strlen(ds->notes));
+	SHA1_Final((unsigned char *)csum, &ctx);
+	ds->uuid = csum[0];
+}
+
 int add_dive_site_to_table(struct dive_site *ds, struct dive_site_table *ds_table)
 {
-	/* If the site doesn't yet have an UUID, create a new one.
-	 * Make this deterministic for testing. */
-	if (!ds->uuid) {
-		SHA_CTX ctx;
-		uint32_t csum[5];
-
-		SHA1_Init(&ctx);
-		if (ds->name)
-			SHA1_Update(&ctx, ds->name, strlen(ds->name));
-		if (ds->description)
-			SHA1_Update(&ctx, ds->description, strlen(ds->description));
-		if (ds->notes)
-			SHA1_Update(&ctx, ds->notes, strlen(ds->notes));
-		SHA1_Final((unsigned char *)csum, &ctx);
-		ds->uuid = csum[0];
-	}
+	if (!ds->uuid)
+		create_dive_site_uuid(ds);
 
 	/* Take care to never have the same uuid twice. This could happen on
 	 * reimport of a log where the dive sites have diverged */
@@ -162,6 +173,37 @@ int add_dive_site_to_table(struct dive_site *ds, struct dive_site_table *ds_tabl
 	return idx;
 }
 
+/* Add a number of dive sites to a table. This is much faster than
+ * calling add_dive_site_to_table() for every site, but in the rare case
+ * of uuid collisions among the new sites, the uuids may be chosen
+ * differently. Note: the "sites" array is sorted. */
+void add_dive_sites_to_table(struct dive_site **sites, int nr, struct dive_site_table *ds_table)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct dive_site *ds = sites[i];
+		if (!ds->uuid)
+			create_dive_site_uuid(ds);
+		while (ds->uuid == 0 || get_dive_site_by_uuid(ds->uuid, ds_table) != NULL)
+			++ds->uuid;
+	}
+
+	/* Make the uuids unique among the new sites: sort them and
+	 * make sure that they are strictly increasing. */
+	qsort(sites, nr, sizeof(struct dive_site *), sortfn_dive_site_table);
+	for (i = 1; i < nr; i++) {
+		struct dive_site *ds = sites[i];
+		if (ds->uuid > sites[i - 1]->uuid)
+			continue;
+		ds->uuid = sites[i - 1]->uuid + 1;
+		while (ds->uuid == 0 || get_dive_site_by_uuid(ds->uuid, ds_table) != NULL)
+			++ds->uuid;
+	}
+
+	add_items_to_dive_site_table(ds_table, sites, nr);
+}
+
 struct dive_site *alloc_dive_site()
 {
 	struct dive_site *ds;
@@ -48,6 +48,7 @@ int get_divesite_idx(const struct dive_site *ds, struct dive_site_table *ds_tabl
 struct dive_site *get_dive_site_by_uuid(uint32_t uuid, struct dive_site_table *ds_table);
 void sort_dive_site_table(struct dive_site_table *ds_table);
 int add_dive_site_to_table(struct dive_site *ds, struct dive_site_table *ds_table);
+void add_dive_sites_to_table(struct dive_site **sites, int nr, struct dive_site_table *ds_table);
 struct dive_site *alloc_or_get_dive_site(uint32_t uuid, struct dive_site_table *ds_table);
 struct dive_site *alloc_dive_site();
 int nr_of_dives_at_dive_site(struct dive_site *ds);
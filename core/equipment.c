@@ -18,6 +18,7 @@
 #include "divelist.h"
 #include "subsurface-string.h"
 #include "table.h"
+#include "stringpool.h"
 
 /* Warning: this has strange semantics for C-code! Not the weightsystem object
  * is freed, but the data it references. The object itself is passed in by value.
@@ -31,7 +32,7 @@ void free_weightsystem(weightsystem_t ws)
 
 static void free_cylinder(cylinder_t c)
 {
-	free((void *)c.type.description);
+	release_string(c.type.description);
 	c.type.description = NULL;
 }
 
@@ -141,7 +142,7 @@ void add_cloned_weightsystem_at(struct weightsystem_table *t, weightsystem_t ws)
  * Cloned in means that the description-string is copied. */
 void add_cloned_cylinder(struct cylinder_table *t, cylinder_t cyl)
 {
-	cyl.type.description = copy_string(cyl.type.description);
+	cyl.type.description = intern_string(cyl.type.description);
 	add_to_cylinder_table(t, t->nr, cyl);
 }
 
@@ -320,7 +321,7 @@ static void copy_cylinder_type(const cylinder_t *s, cylinder_t *d)
 {
 	free_cylinder(*d);
 	d->type = s->type;
-	d->type.description = s->type.description ? strdup(s->type.description) : NULL;
+	d->type.description = intern_string(s->type.description);
 	d->gasmix = s->gasmix;
 	d->depth = s->depth;
 	d->cylinder_use = s->cylinder_use;
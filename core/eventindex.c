@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0
+/* eventindex.c */
+
+#include <stdlib.h>
+#include "eventindex.h"
+#include "subsurface-string.h"
+
+/* Only the name is compared, as in get_next_event(). name == NULL indexes all events. */
+static bool event_matches(const struct event *ev, const char *name)
+{
+	return !name || same_string(ev->name, name);
+}
+
+void build_event_index(struct event_index *idx, const struct divecomputer *dc, const char *name)
+{
+	const struct event *ev;
+	int nr = 0, i;
+	bool sorted = true;
+
+	idx->nr = 0;
+	idx->entries = NULL;
+	if (!dc)
+		return;
+	for (ev = dc->events; ev; ev = ev->next) {
+		if (event_matches(ev, name))
+			nr++;
+	}
+	if (!nr)
+		return;
+	idx->entries = malloc(nr * sizeof(*idx->entries));
+	if (!idx->entries)
+		exit(1);
+	for (ev = dc->events; ev; ev = ev->next) {
+		if (!event_matches(ev, name))
+			continue;
+		if (idx->nr && idx->entries[idx->nr - 1].time > (int)ev->time.seconds)
+			sorted = false;
+		idx->entries[idx->nr].time = ev->time.seconds;
+		idx->entries[idx->nr].ev = ev;
+		idx->nr++;
+	}
+
+	/*
+	 * The list is kept sorted by add_event(), but code that manipulates
+	 * it directly might not. Use a stable insertion sort, so that events
+	 * at the same time keep their order. This is linear for sorted input.
+	 */
+	if (!sorted) {
+		for (i = 1; i < idx->nr; i++) {
+			struct event_index_entry entry = idx->entries[i];
+			int j = i;
+			while (j > 0 && idx->entries[j - 1].time > entry.time) {
+				idx->entries[j] = idx->entries[j - 1];
+				j--;
+			}
+			idx->entries[j] = entry;
+		}
+	}
+}
+
+void free_event_index(struct event_index *idx)
+{
+	free(idx->entries);
+	idx->entries = NULL;
+	idx->nr = 0;
+}
+
+/* Index of the first event after 'time', or idx->nr if there is none */
+int event_index_upper_bound(const struct event_index *idx, int time)
+{
+	int lo = 0, hi = idx->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (time < idx->entries[mid].time)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/* Index of the first event at or after 'time' */
+static int event_index_lower_bound(const struct event_index *idx, int time)
+{
+	int lo = 0, hi = idx->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (idx->entries[mid].time < time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* The last event at or before 'time'. For multiple events at the same time, that's the last one in the list. */
+const struct event *event_index_last_at(const struct event_index *idx, int time)
+{
+	int i = event_index_upper_bound(idx, time);
+	return i > 0 ? idx->entries[i - 1].ev : NULL;
+}
+
+/* The last event strictly before 'time' */
+const struct event *event_index_last_before(const struct event_index *idx, int time)
+{
+	int i = event_index_lower_bound(idx, time);
+	return i > 0 ? idx->entries[i - 1].ev : NULL;
+}
+
+/* The first event strictly after 'time' */
+const struct event *event_index_next_after(const struct event_index *idx, int time)
+{
+	int i = event_index_upper_bound(idx, time);
+	return i < idx->nr ? idx->entries[i].ev : NULL;
+}
+
+/* Same as get_gasmix_at_time(), but using an index of the "gaschange" events */
+struct gasmix get_gasmix_indexed(const struct dive *dive, const struct divecomputer *dc, const struct event_index *gaschanges, int time)
+{
+	const struct event *ev;
+
+	/* if there is no cylinder, return air */
+	if (dive->cylinders.nr <= 0)
+		return gasmix_air;
+
+	ev = event_index_last_at(gaschanges, time);
+	if (ev)
+		return get_gasmix_from_event(dive, ev);
+	return get_cylinder(dive, explicit_first_cylinder(dive, dc))->gasmix;
+}
+
+/* The dive mode at 'time', given an index of the "modechange" events. Mode changes take effect after their time. */
+enum divemode_t get_divemode_indexed(const struct divecomputer *dc, const struct event_index *modechanges, int time)
+{
+	const struct event *ev = event_index_last_before(modechanges, time);
+	return ev ? (enum divemode_t)ev->value : dc->divemode;
+}
+
+/* The innermost active event lookups of this thread */
+static _Thread_local struct event_lookups *active_lookups;
+
+void begin_event_lookups(struct event_lookups *lookups, const struct divecomputer *dc)
+{
+	lookups->dc = dc;
+	build_event_index(&lookups->gaschanges, dc, "gaschange");
+	build_event_index(&lookups->modechanges, dc, "modechange");
+	lookups->outer = active_lookups;
+	active_lookups = lookups;
+}
+
+/* Lookups must be ended in the reverse order they were begun */
+void end_event_lookups(struct event_lookups *lookups)
+{
+	active_lookups = lookups->outer;
+	free_event_index(&lookups->gaschanges);
+	free_event_index(&lookups->modechanges);
+}
+
+/* The index of the "gaschange" or "modechange" events of an active lookup for dc, or NULL */
+const struct event_index *get_active_event_index(const struct divecomputer *dc, const char *name)
+{
+	struct event_lookups *lookups;
+
+	if (!dc)
+		return NULL;
+	for (lookups = active_lookups; lookups; lookups = lookups->outer) {
+		if (lookups->dc != dc)
+			continue;
+		if (same_string(name, "gaschange"))
+			return &lookups->gaschanges;
+		if (same_string(name, "modechange"))
+			return &lookups->modechanges;
+		return NULL;
+	}
+	return NULL;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Time index of the events of a dive computer.
+ *
+ * The events of a dive computer are kept in a time-sorted linked list, which
+ * is what most code iterates over. Looking up the event in effect at a given
+ * time means walking that list from the head. Code that does such lookups
+ * for every sample builds an event_index once, which is a contiguous,
+ * time-sorted array of the events (optionally of one type only) that is
+ * searched by bisection:
+ *
+ *     struct event_index gaschanges;
+ *     build_event_index(&gaschanges, dc, "gaschange");
+ *     for (i = 0; i < dc->samples; i++)
+ *         gasmix = get_gasmix_indexed(dive, dc, &gaschanges, dc->sample[i].time.seconds);
+ *     free_event_index(&gaschanges);
+ *
+ * The index refers to the events of the list and is invalidated by any
+ * modification of the list.
+ */
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include "dive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct event_index_entry {
+	int time;
+	const struct event *ev;
+};
+
+struct event_index {
+	int nr;
+	struct event_index_entry *entries;
+};
+
+extern void build_event_index(struct event_index *idx, const struct divecomputer *dc, const char *name);
+extern void free_event_index(struct event_index *idx);
+extern int event_index_upper_bound(const struct event_index *idx, int time);
+extern const struct event *event_index_last_at(const struct event_index *idx, int time);
+extern const struct event *event_index_last_before(const struct event_index *idx, int time);
+extern const struct event *event_index_next_after(const struct event_index *idx, int time);
+extern struct gasmix get_gasmix_indexed(const struct dive *dive, const struct divecomputer *dc, const struct event_index *gaschanges, int time);
+extern enum divemode_t get_divemode_indexed(const struct divecomputer *dc, const struct event_index *modechanges, int time);
+
+/*
+ * get_gasmix(), get_gasmix_at_time() and get_current_divemode() walk the event
+ * list from its head to find the gas or dive mode at a given time. While event
+ * lookups are active for a dive computer, they bisect indexes of its "gaschange"
+ * and "modechange" events instead. This is meant for code that does such lookups
+ * for every plot entry, like the profile calculation:
+ *
+ *     struct event_lookups lookups;
+ *     begin_event_lookups(&lookups, dc);
+ *     ...
+ *     end_event_lookups(&lookups);
+ *
+ * Event lookups are per thread and may be nested. The events of the dive
+ * computer must not be modified while they are active.
+ */
+struct event_lookups {
+	const struct divecomputer *dc;
+	struct event_index gaschanges;
+	struct event_index modechanges;
+	struct event_lookups *outer;
+};
+
+extern void begin_event_lookups(struct event_lookups *lookups, const struct divecomputer *dc);
+extern void end_event_lookups(struct event_lookups *lookups);
+extern const struct event_index *get_active_event_index(const struct divecomputer *dc, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENTINDEX_H
@@ -19,6 +19,7 @@
 #include "qthelper.h"
 #include "import-csv.h"
 #include "parse.h"
+#include "arena.h"
 
 /* For SAMPLE_* */
 #include <libdivecomputer/parser.h>
@@ -293,7 +294,7 @@ int check_git_sha(const char *filename, struct git_repository **git_p, const cha
 	return 1;
 }
 
-int parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
+static int parse_file_contents(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
 {
 	struct git_repository *git;
 	const char *branch = NULL;
@@ -370,3 +371,18 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 	free(mem.buffer);
 	return ret;
 }
+
+/*
+ * The small objects created while loading (events, extra data) are
+ * allocated in the logbook arena and released en bloc when the
+ * logbook is closed (see arena.h).
+ */
+int parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
+{
+	int ret;
+
+	begin_logbook_allocation();
+	ret = parse_file_contents(filename, table, trips, sites);
+	end_logbook_allocation();
+	return ret;
+}
@@ -4,18 +4,19 @@
  *  This file contains the routines to calculate the gas pressures in the cylinders.
  *  The functions below support the code in profile.c.
  *  The high-level function is populate_pressure_information(), called by function
- *  create_plot_info_new() in profile.c. The other functions below are, in turn,
+ *  plot_info_need() in profile.c. The other functions below are, in turn,
  *  called by populate_pressure_information(). The calling sequence is as follows:
  *
- *  populate_pressure_information() -> calc_pressure_time()
- *                                  -> fill_missing_tank_pressures() -> fill_missing_segment_pressures()
+ *  populate_pressure_information() -> analyze_pressure_entries()
+ *                                  -> populate_cylinder_pressures() -> fill_missing_tank_pressures()
+ *                                                                   -> fill_missing_segment_pressures()
  *                                                                   -> get_pr_interpolate_data()
  *
- *  The pr_track_t related functions below implement a linked list that is used by
- *  the majority of the functions below. The linked list covers a part of the dive profile
- *  for which there are no cylinder pressure data. Each element in the linked list
- *  represents a segment between two consecutive points on the dive profile.
- *  pr_track_t is defined in gaspressures.h
+ *  The data that do not depend on the cylinder are calculated in one pass over the plot
+ *  info for all cylinders. Then, for every cylinder, the profile is split into segments,
+ *  which are kept in an array of pr_track_t. The segments cover the parts of the dive
+ *  profile for which there are no cylinder pressure data. The scratch memory for these
+ *  arrays is kept per thread and reused for all cylinders and later calls.
  */
 
 #include "ssrf.h"
@@ -36,7 +37,6 @@ struct pr_track_struct {
 	int t_start;
 	int t_end;
 	int pressure_time;
-	pr_track_t *next;
 };
 
 typedef struct pr_interpolate_struct pr_interpolate_t;
@@ -49,61 +49,60 @@ struct pr_interpolate_struct {
 
 enum interpolation_strategy {SAC, TIME, CONSTANT};
 
-static pr_track_t *pr_track_alloc(int start, int t_start)
-{
-	pr_track_t *pt = malloc(sizeof(pr_track_t));
-	pt->start = start;
-	pt->end = 0;
-	pt->t_start = pt->t_end = t_start;
-	pt->pressure_time = 0;
-	pt->next = NULL;
-	return pt;
-}
+/*
+ * The data of the plot entries that are the same for all cylinders, and
+ * the memory for the segments of the cylinder that is being calculated.
+ */
+struct pressure_scratch {
+	int *gas_cylinder;	/* cylinder of the last gas change, -1 if none */
+	int *pressure_time;	/* pressure-time since the previous entry */
+	int *first, *last;	/* range of the sensor pressures of each cylinder */
+	pr_track_t *track;
+};
 
-/* poor man's linked list */
-static pr_track_t *list_last(pr_track_t *list)
-{
-	pr_track_t *tail = list;
-	if (!tail)
-		return NULL;
-	while (tail->next) {
-		tail = tail->next;
-	}
-	return tail;
-}
+/*
+ * The profile may be calculated in a background thread, so every thread
+ * has its own scratch memory. It only grows, for the largest plot info
+ * seen by the thread.
+ */
+static _Thread_local struct pressure_scratch scratch;
+static _Thread_local int scratch_entries, scratch_cylinders;
 
-static pr_track_t *list_add(pr_track_t *list, pr_track_t *element)
+static struct pressure_scratch *get_pressure_scratch(int nr, int nr_cylinders)
 {
-	pr_track_t *tail = list_last(list);
-	if (!tail)
-		return element;
-	tail->next = element;
-	return list;
+	if (nr > scratch_entries) {
+		scratch.gas_cylinder = realloc(scratch.gas_cylinder, nr * sizeof(*scratch.gas_cylinder));
+		scratch.pressure_time = realloc(scratch.pressure_time, nr * sizeof(*scratch.pressure_time));
+		scratch.track = realloc(scratch.track, nr * sizeof(*scratch.track));
+		scratch_entries = nr;
+	}
+	if (nr_cylinders > scratch_cylinders) {
+		scratch.first = realloc(scratch.first, nr_cylinders * sizeof(*scratch.first));
+		scratch.last = realloc(scratch.last, nr_cylinders * sizeof(*scratch.last));
+		scratch_cylinders = nr_cylinders;
+	}
+	return &scratch;
 }
 
-static void list_free(pr_track_t *list)
+static void pr_track_init(pr_track_t *pt, int start, int t_start)
 {
-	if (!list)
-		return;
-	list_free(list->next);
-	free(list);
+	pt->start = start;
+	pt->end = 0;
+	pt->t_start = pt->t_end = t_start;
+	pt->pressure_time = 0;
 }
 
 #ifdef DEBUG_PR_TRACK
-static void dump_pr_track(int cyl, pr_track_t *track_pr)
+static void dump_pr_track(int cyl, const pr_track_t *track_pr, int nr)
 {
-	pr_track_t *list;
-
 	printf("cyl%d:\n", cyl);
-	list = track_pr;
-	while (list) {
+	for (const pr_track_t *list = track_pr; list < track_pr + nr; list++) {
 		printf("   start %d end %d t_start %d:%02d t_end %d:%02d pt %d\n",
 		       mbar_to_PSI(list->start),
 		       mbar_to_PSI(list->end),
 		       FRACTION(list->t_start, 60),
 		       FRACTION(list->t_end, 60),
 		       list->pressure_time);
-		list = list->next;
 	}
 }
 #endif
@@ -126,11 +125,12 @@ static void dump_pr_track(int cyl, pr_track_t *track_pr)
  * segments according to how big of a time_pressure area
  * they have.
  */
-static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_strategy strategy)
+static void fill_missing_segment_pressures(pr_track_t *track, int nr, enum interpolation_strategy strategy)
 {
+	pr_track_t *list = track, *track_end = track + nr;
 	double magic;
 
-	while (list) {
+	while (list < track_end) {
 		int start = list->start, end;
 		pr_track_t *tmp = list;
 		int pt_sum = 0, pt = 0;
@@ -141,9 +141,9 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 			if (end)
 				break;
 			end = start;
-			if (!tmp->next)
+			if (tmp + 1 == track_end)
 				break;
-			tmp = tmp->next;
+			tmp++;
 		}
 
 		if (!start)
@@ -170,7 +170,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 				list->end = pressure;
 				if (list == tmp)
 					break;
-				list = list->next;
+				list++;
 				list->start = pressure;
 			}
 			break;
@@ -187,7 +187,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 		}
 
 		/* Ok, we've done that set of segments */
-		list = list->next;
+		list++;
 	}
 }
 
@@ -211,11 +211,14 @@ static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment,
 	interpolate.acc_pressure_time = 0;
 	interpolate.pressure_time = 0;
 
-	for (i = 0; i < pi->nr; i++) {
+	// The entries are sorted by time and entry 'cur' lies within the segment.
+	// Thus, we only have to go back to the start of the segment.
+	i = cur;
+	while (i > 0 && pi->entry[i - 1].sec >= segment->t_start)
+		i--;
+	for (; i < pi->nr; i++) {
 		entry = pi->entry + i;
 
-		if (entry->sec < segment->t_start)
-			continue;
 		interpolate.pressure_time += entry->pressure_time;
 		if (entry->sec >= segment->t_end)
 			break;
@@ -225,28 +228,29 @@ static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment,
 	return interpolate;
 }
 
-static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, pr_track_t *track_pr, int cyl)
+static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, pr_track_t *track_pr, int nr_track, int cyl)
 {
 	int i;
 	struct plot_data *entry;
 	pr_interpolate_t interpolate = { 0, 0, 0, 0 };
 	pr_track_t *last_segment = NULL;
+	pr_track_t *segment, *track_end = track_pr + nr_track;
 	int cur_pr;
 	enum interpolation_strategy strategy;
 
 	/* no segment where this cylinder is used */
-	if (!track_pr)
+	if (!nr_track)
 		return;
 
 	if (get_cylinder(dive, cyl)->cylinder_use == OC_GAS)
 		strategy = SAC;
 	else
 		strategy = TIME;
-	fill_missing_segment_pressures(track_pr, strategy); // Interpolate the missing tank pressure values ..
-	cur_pr = track_pr->start;			       // in the pr_track_t lists of structures
-							       // and keep the starting pressure for each cylinder.
+	fill_missing_segment_pressures(track_pr, nr_track, strategy); // Interpolate the missing tank pressure values ..
+	cur_pr = track_pr->start;				      // in the pr_track_t array of structures
+								      // and keep the starting pressure for each cylinder.
 #ifdef DEBUG_PR_TRACK
-	dump_pr_track(cyl, track_pr);
+	dump_pr_track(cyl, track_pr, nr_track);
 #endif
 
 	/* Transfer interpolated cylinder pressures from pr_track strucktures to plotdata
@@ -259,9 +263,9 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 	 *
 	 * The first two pi structures are "fillers", but in case we don't have a sample
 	 * at time 0 we need to process the second of them here, therefore i=1 */
+	segment = track_pr;
 	for (i = 1; i < pi->nr; i++) { // For each point on the profile:
 		double magic;
-		pr_track_t *segment;
 		int pressure;
 
 		entry = pi->entry + i;
@@ -275,12 +279,13 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		}
 		// If there is NO valid pressure value..
 		// Find the pressure segment corresponding to this entry..
-		segment = track_pr;
-		while (segment && segment->t_end < entry->sec) // Find the track_pr with end time..
-			segment = segment->next;	       // ..that matches the plot_info time (entry->sec)
+		// Both the entries and the segments are sorted by time,
+		// so continue the search where the last entry left off.
+		while (segment < track_end && segment->t_end < entry->sec) // Find the track_pr with end time..
+			segment++;					   // ..that matches the plot_info time (entry->sec)
 
 		// After last segment? All done.
-		if (!segment)
+		if (segment == track_end)
 			break;
 
 		// Before first segment, or between segments.. Go on, no interpolation.
@@ -353,47 +358,73 @@ static void debug_print_pressures(struct plot_info *pi)
 }
 #endif
 
-/* This function goes through the list of tank pressures, of structure plot_info for the dive profile where each
- * item in the list corresponds to one point (node) of the profile. It finds values for which there are no tank
- * pressures (pressure==0). For each missing item (node) of tank pressure it creates a pr_track_alloc structure
- * that represents a segment on the dive profile and that contains tank pressures. There is a linked list of
- * pr_track_alloc structures for each cylinder. These pr_track_alloc structures ultimately allow for filling
- * the missing tank pressure values on the dive profile using the depth_pressure of the dive. To do this, it
- * calculates the summed pressure-time value for the duration of the dive and stores these * in the pr_track_alloc
- * structures. This function is called by create_plot_info_new() in profile.c
+/*
+ * Go once through the plot info and collect the data that are the same for
+ * all cylinders: the cylinder in use according to the gas change events,
+ * the pressure-time of every entry, taking into account the dive mode, and
+ * the range of entries that have sensor pressures for every cylinder.
  */
-void populate_pressure_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, int sensor)
+static void analyze_pressure_entries(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, struct pressure_scratch *scratch)
 {
-	UNUSED(dc);
-	int first, last, cyl;
-	cylinder_t *cylinder = get_cylinder(dive, sensor);
-	pr_track_t *track = NULL;
-	pr_track_t *current = NULL;
 	const struct event *ev, *b_ev;
-	int missing_pr = 0, dense = 1;
+	int cyl = -1;
 	enum divemode_t dmode = dc->divemode;
 	const double gasfactor[5] = {1.0, 0.0, prefs.pscr_ratio/1000.0, 1.0, 1.0 };
 
-	if (sensor < 0 || sensor >= dive->cylinders.nr)
+	for (int c = 0; c < pi->nr_cylinders; c++)
+		scratch->first[c] = scratch->last[c] = -1;
+
+	ev = get_next_event(dc->events, "gaschange");
+	b_ev = get_next_event(dc->events, "modechange");
+	for (int i = 0; i < pi->nr; i++) {
+		struct plot_data *entry = pi->entry + i;
+		int time = entry->sec;
+
+		while (ev && ev->time.seconds <= time) { // Find 1st gaschange event after
+			cyl = get_cylinder_index(dive, ev); // the current gas change.
+			ev = get_next_event(ev->next, "gaschange");
+		}
+		scratch->gas_cylinder[i] = cyl < 0 ? -1 : cyl;
+
+		while (b_ev && b_ev->time.seconds <= time) { // Keep existing divemode, then
+			dmode = b_ev->value; // find 1st divemode change event after the current
+			b_ev = get_next_event(b_ev->next, "modechange"); // divemode change.
+		}
+
+		// calculate pressure-time, taking into account the dive mode for this specific segment.
+		scratch->pressure_time[i] = i > 0 ? (int)(calc_pressure_time(dive, entry - 1, entry) * gasfactor[dmode] + 0.5) : 0;
+
+		// Get a rough range of where we have any pressures at all
+		for (int c = 0; c < pi->nr_cylinders; c++) {
+			if (!get_plot_sensor_pressure(pi, i, c))
+				continue;
+			if (scratch->first[c] < 0)
+				scratch->first[c] = i;
+			scratch->last[c] = i;
+		}
+	}
+}
+
+static void populate_cylinder_pressures(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, int sensor,
+					const struct pressure_scratch *scratch)
+{
+	int first = scratch->first[sensor], last = scratch->last[sensor];
+	cylinder_t *cylinder;
+	pr_track_t *track = scratch->track;
+	pr_track_t *current = NULL;
+	int nr_track = 0;
+	int missing_pr = 0, dense = 1;
+	bool use_gaschanges;
+
+	if (sensor >= dive->cylinders.nr)
 		return;
+	cylinder = get_cylinder(dive, sensor);
 
 	/* if we have no pressure data whatsoever, this is pointless, so let's just return */
 	if (!cylinder->start.mbar && !cylinder->end.mbar &&
 	    !cylinder->sample_start.mbar && !cylinder->sample_end.mbar)
 		return;
 
-	/* Get a rough range of where we have any pressures at all */
-	first = last = -1;
-	for (int i = 0; i < pi->nr; i++) {
-		int pressure = get_plot_sensor_pressure(pi, i, sensor);
-
-		if (!pressure)
-			continue;
-		if (first < 0)
-			first = i;
-		last = i;
-	}
-
 	/* No sensor data at all? */
 	if (first == last)
 		return;
@@ -406,31 +437,15 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 	 * Note that we only look at gas switches if this cylinder
 	 * itself has a gas change event.
 	 */
-	cyl = sensor;
-	ev = NULL;
-	if (has_gaschange_event(dive, dc, sensor))
-		ev = get_next_event(dc->events, "gaschange");
-	b_ev = get_next_event(dc->events, "modechange");
+	use_gaschanges = has_gaschange_event(dive, dc, sensor);
 
 	for (int i = first; i <= last; i++) {
 		struct plot_data *entry = pi->entry + i;
 		int pressure = get_plot_sensor_pressure(pi, i, sensor);
-		int time = entry->sec;
-
-		while (ev && ev->time.seconds <= time) {   // Find 1st gaschange event after 
-			cyl = get_cylinder_index(dive, ev); // the current gas change.
-			if (cyl < 0)
-				cyl = sensor;
-			ev = get_next_event(ev->next, "gaschange");
-		}
+		int cyl = use_gaschanges && scratch->gas_cylinder[i] >= 0 ? scratch->gas_cylinder[i] : sensor;
 
-		while (b_ev && b_ev->time.seconds <= time) { // Keep existing divemode, then
-			dmode = b_ev->value; // find 1st divemode change event after the current 
-			b_ev = get_next_event(b_ev->next, "modechange"); // divemode change.
-		}
-
-		if (current) { // calculate pressure-time, taking into account the dive mode for this specific segment.
-			entry->pressure_time = (int)(calc_pressure_time(dive, entry - 1, entry) * gasfactor[dmode] + 0.5);
+		if (current) {
+			entry->pressure_time = scratch->pressure_time[i];
 			current->pressure_time += entry->pressure_time;
 			current->t_end = entry->sec;
 			if (pressure)
@@ -469,18 +484,38 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 		// missing entries that need to be interpolated.
 		// Or maybe we didn't have a previous one at all,
 		// and this is the first pressure entry.
-		current = pr_track_alloc(pressure, entry->sec);
-		track = list_add(track, current);
+		current = track + nr_track++;
+		pr_track_init(current, pressure, entry->sec);
 		dense = 1;
 	}
 
 	if (missing_pr) {
-		fill_missing_tank_pressures(dive, pi, track, sensor);
+		fill_missing_tank_pressures(dive, pi, track, nr_track, sensor);
 	}
+}
+
+/* This function goes through the list of tank pressures, of structure plot_info for the dive profile where each
+ * item in the list corresponds to one point (node) of the profile. It finds values for which there are no tank
+ * pressures (pressure==0). For each cylinder, it splits the profile into segments, represented by pr_track_t
+ * structures, that contain tank pressures. These pr_track_t structures ultimately allow for filling the missing
+ * tank pressure values on the dive profile using the depth_pressure of the dive. To do this, it calculates the
+ * summed pressure-time value for the duration of the dive and stores these in the pr_track_t structures.
+ * There can't be more segments than plot entries, so the memory for the segments is taken from the scratch
+ * memory of the thread and reused for all cylinders. This function is called by plot_info_need() in profile.c
+ */
+void populate_pressure_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi)
+{
+	struct pressure_scratch *scratch;
+
+	if (!pi->nr || pi->nr_cylinders <= 0)
+		return;
+
+	scratch = get_pressure_scratch(pi->nr, pi->nr_cylinders);
+	analyze_pressure_entries(dive, dc, pi, scratch);
+	for (int cyl = 0; cyl < pi->nr_cylinders; cyl++)
+		populate_cylinder_pressures(dive, dc, pi, cyl, scratch);
 
 #ifdef PRINT_PRESSURES_DEBUG
 	debug_print_pressures(pi);
 #endif
-
-	list_free(track);
 }
@@ -1199,6 +1199,7 @@ static void finish_active_dive(struct git_parser_state *state)
 
 	if (dive) {
 		state->active_dive = NULL;
+		intern_dive_strings(dive);
 		record_dive(dive);
 	}
 }
@@ -31,6 +31,7 @@
 #include "membuffer.h"
 #include "qthelper.h"
 #include "tag.h"
+#include "stringpool.h"
 
 int quit, force_root;
 int last_xml_version = -1;
@@ -1006,7 +1007,7 @@ static int divinglog_dive_match(struct dive *dive, const char *name, char *buf,
 	cylinder_t cyl = { 0 };
 	if (MATCH("tanktype", utf8_string, &cyl.type.description)) {
 		cylinder_t *cyl0 = get_or_create_cylinder(dive, 0);
-		free((void *)cyl0->type.description);
+		release_string(cyl0->type.description);
 		cyl0->type.description = cyl.type.description;
 		return 1;
 	}
@@ -14,6 +14,7 @@
 #include "trip.h"
 #include "device.h"
 #include "gettext.h"
+#include "stringpool.h"
 
 struct dive_table dive_table;
 
@@ -249,6 +250,7 @@ void dive_end(struct parser_state *state)
 	if (!is_dive(state)) {
 		free_dive(state->cur_dive);
 	} else {
+		intern_dive_strings(state->cur_dive);
 		record_dive_to_table(state->cur_dive, state->target_table);
 		if (state->cur_trip)
 			add_dive_to_trip(state->cur_dive, state->cur_trip);
@@ -398,7 +400,7 @@ void utf8_string(char *buffer, void *_res)
 {
 	char **res = _res;
 	int size;
-	free(*res);
+	release_string(*res);
 	size = trimspace(buffer);
 	if(size)
 		*res = strdup(buffer);
@@ -19,16 +19,19 @@
 #include "libdivecomputer/parser.h"
 #include "qthelper.h"
 #include "version.h"
+#include "arena.h"
+#include "eventindex.h"
+#include "samplecolumns.h"
 
 #define TIMESTEP 2 /* second */
 
-static int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 					30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 					60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 					90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 					180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 					320000, 340000, 360000, 380000 };
-static int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 					30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 					60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 					91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
@@ -92,28 +95,29 @@ int get_gasidx(struct dive *dive, struct gasmix mix)
 	return find_best_gasmix_match(mix, &dive->cylinders);
 }
 
-static void interpolate_transition(struct deco_state *ds, struct dive *dive, duration_t t0, duration_t t1, depth_t d0, depth_t d1, struct gasmix gasmix, o2pressure_t po2, enum divemode_t divemode)
+static void interpolate_transition(struct deco_state *ds, const struct plan_config *config, struct dive *dive, duration_t t0, duration_t t1, depth_t d0, depth_t d1, struct gasmix gasmix, o2pressure_t po2, enum divemode_t divemode)
 {
 	int32_t j;
 
 	for (j = t0.seconds; j < t1.seconds; j++) {
 		int depth = interpolate(d0.mm, d1.mm, j - t0.seconds, t1.seconds - t0.seconds);
-		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, divemode, prefs.bottomsac);
+		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, divemode, config->bottomsac);
 	}
 	if (d1.mm > d0.mm)
 		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
 }
 
 /* returns the tissue tolerance at the end of this (partial) dive */
-static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap)
+static int tissue_at_end(struct deco_state *ds, const struct plan_config *config, struct dive *dive, struct deco_state **cached_datap)
 {
 	struct divecomputer *dc;
-	struct sample *sample, *psample;
+	struct sample_column sample_time, sample_depth, sample_setpoint;
 	int i;
 	depth_t lastdepth = {};
 	duration_t t0 = {}, t1 = {};
 	struct gasmix gas;
 	int surface_interval = 0;
+	struct event_index gaschanges;
 
 	if (!dive)
 		return 0;
@@ -126,23 +130,27 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 	dc = &dive->dc;
 	if (!dc->samples)
 		return 0;
-	psample = sample = dc->sample;
+	sample_time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+	sample_depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+	sample_setpoint = get_sample_column(dc, SAMPLE_CHANNEL_SETPOINT);
+	build_event_index(&gaschanges, dc, "gaschange");
 
 	const struct event *evdm = NULL;
 	enum divemode_t divemode = UNDEF_COMP_TYPE;
 
-	for (i = 0; i < dc->samples; i++, sample++) {
+	for (i = 0; i < dc->samples; i++) {
 		o2pressure_t setpoint;
+		depth_t depth = SAMPLE_VALUE(sample_depth, depth_t, i);
 
 		if (i)
-			setpoint = sample[-1].setpoint;
+			setpoint = SAMPLE_VALUE(sample_setpoint, o2pressure_t, i - 1);
 		else
-			setpoint = sample[0].setpoint;
+			setpoint = SAMPLE_VALUE(sample_setpoint, o2pressure_t, 0);
 
-		t1 = sample->time;
-		gas = get_gasmix_at_time(dive, dc, t0);
+		t1 = SAMPLE_VALUE(sample_time, duration_t, i);
+		gas = get_gasmix_indexed(dive, dc, &gaschanges, t0.seconds);
 		if (i > 0)
-			lastdepth = psample->depth;
+			lastdepth = SAMPLE_VALUE(sample_depth, depth_t, i - 1);
 
 		/* The ceiling in the deeper portion of a multilevel dive is sometimes critical for the VPM-B
 		 * Boyle's law compensation.  We should check the ceiling prior to ascending during the bottom
@@ -153,7 +161,7 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode() == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((ds->config.mode == VPMB) && (lastdepth.mm > depth.mm)) {
 			pressure_t ceiling_pressure;
 			nuclear_regeneration(ds, t0.seconds);
 			vpmb_start_gradient(ds);
@@ -168,10 +176,10 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 		}
 
 		divemode = get_current_divemode(&dive->dc, t0.seconds + 1, &evdm, &divemode);
-		interpolate_transition(ds, dive, t0, t1, lastdepth, sample->depth, gas, setpoint, divemode);
-		psample = sample;
+		interpolate_transition(ds, config, dive, t0, t1, lastdepth, depth, gas, setpoint, divemode);
 		t0 = t1;
 	}
+	free_event_index(&gaschanges);
 	return surface_interval;
 }
 
@@ -208,7 +216,7 @@ void fill_default_cylinder(const struct dive *dive, cylinder_t *cyl)
 
 /* calculate the new end pressure of the cylinder, based on its current end pressure and the
  * latest segment. */
-static void update_cylinder_pressure(struct dive *d, int old_depth, int new_depth, int duration, int sac, cylinder_t *cyl, bool in_deco, enum divemode_t divemode)
+static void update_cylinder_pressure(const struct plan_config *config, struct dive *d, int old_depth, int new_depth, int duration, int sac, cylinder_t *cyl, bool in_deco, enum divemode_t divemode)
 {
 	volume_t gas_used;
 	pressure_t delta_p;
@@ -216,7 +224,7 @@ static void update_cylinder_pressure(struct dive *d, int old_depth, int new_dept
 	int factor = 1000;
 
 	if (divemode == PSCR)
-		factor = prefs.pscr_ratio;
+		factor = config->pscr_ratio;
 
 	if (!cyl)
 		return;
@@ -233,7 +241,7 @@ static void update_cylinder_pressure(struct dive *d, int old_depth, int new_dept
 
 /* overwrite the data in dive
  * return false if something goes wrong */
-static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive, bool track_gas)
+static void create_dive_from_plan(struct diveplan *diveplan, const struct plan_config *config, struct dive *dive, bool track_gas)
 {
 	struct divedatapoint *dp;
 	struct divecomputer *dc;
@@ -263,7 +271,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 	free_samples(dc);
 	while ((ev = dc->events)) {
 		dc->events = dc->events->next;
-		free(ev);
+		logbook_free(ev);
 	}
 	dp = diveplan->dp;
 	/* Create first sample at time = 0, not based on dp because
@@ -271,7 +279,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 	 * O2 setpoint for this sample will be filled later from next dp */
 	cyl = get_or_create_cylinder(dive, 0);
 	sample = prepare_sample(dc);
-	sample->sac.mliter = prefs.bottomsac;
+	sample->sac.mliter = config->bottomsac;
 	if (track_gas && cyl->type.workingpressure.mbar)
 		sample->pressure[0].mbar = cyl->end.mbar;
 	sample->manually_entered = true;
@@ -309,7 +317,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 			sample->time.seconds = lasttime + 1;
 			sample->depth = lastdepth;
 			sample->manually_entered = dp->entered;
-			sample->sac.mliter = dp->entered ? prefs.bottomsac : prefs.decosac;
+			sample->sac.mliter = dp->entered ? config->bottomsac : config->decosac;
 			finish_sample(dc);
 			lastcylid = dp->cylinderid;
 		}
@@ -328,9 +336,9 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 		if (dp->entered) last_manual_point = dp->time;
 		sample->depth = lastdepth = depth;
 		sample->manually_entered = dp->entered;
-		sample->sac.mliter = dp->entered ? prefs.bottomsac : prefs.decosac;
+		sample->sac.mliter = dp->entered ? config->bottomsac : config->decosac;
 		if (track_gas && !sample[-1].setpoint.mbar) {    /* Don't track gas usage for CCR legs of dive */
-			update_cylinder_pressure(dive, sample[-1].depth.mm, depth.mm, time - sample[-1].time.seconds,
+			update_cylinder_pressure(config, dive, sample[-1].depth.mm, depth.mm, time - sample[-1].time.seconds,
 					dp->entered ? diveplan->bottomsac : diveplan->decosac, cyl, !dp->entered, type);
 			if (cyl->type.workingpressure.mbar)
 				sample->pressure[0].mbar = cyl->end.mbar;
@@ -503,38 +511,48 @@ static int *sort_stops(int *dstops, int dnr, struct gaschanges *gstops, int gnr)
 	return stoplevels;
 }
 
-int ascent_velocity(int depth, int avg_depth, int bottom_time)
+static int ascent_rate(int depth, int avg_depth, int ascrate75, int ascrate50, int ascratestops, int ascratelast6m)
 {
-	UNUSED(bottom_time);
 	/* We need to make this configurable */
 
 	/* As an example (and possibly reasonable default) this is the Tech 1 provedure according
 	 * to http://www.globalunderwaterexplorers.org/files/Standards_and_Procedures/SOP_Manual_Ver2.0.2.pdf */
 
 	if (depth * 4 > avg_depth * 3) {
-		return prefs.ascrate75;
+		return ascrate75;
 	} else {
 		if (depth * 2 > avg_depth) {
-			return prefs.ascrate50;
+			return ascrate50;
 		} else {
 			if (depth > 6000)
-				return prefs.ascratestops;
+				return ascratestops;
 			else
-				return prefs.ascratelast6m;
+				return ascratelast6m;
 		}
 	}
 }
 
-static void track_ascent_gas(int depth, struct dive *dive, int cylinder_id, int avg_depth, int bottom_time, bool safety_stop, enum divemode_t divemode)
+int ascent_velocity(int depth, int avg_depth, int bottom_time)
+{
+	UNUSED(bottom_time);
+	return ascent_rate(depth, avg_depth, prefs.ascrate75, prefs.ascrate50, prefs.ascratestops, prefs.ascratelast6m);
+}
+
+static int plan_ascent_velocity(const struct plan_config *config, int depth, int avg_depth)
+{
+	return ascent_rate(depth, avg_depth, config->ascrate75, config->ascrate50, config->ascratestops, config->ascratelast6m);
+}
+
+static void track_ascent_gas(const struct plan_config *config, int depth, struct dive *dive, int cylinder_id, int avg_depth, bool safety_stop, enum divemode_t divemode)
 {
 	cylinder_t *cylinder = get_cylinder(dive, cylinder_id);
 	while (depth > 0) {
-		int deltad = ascent_velocity(depth, avg_depth, bottom_time) * TIMESTEP;
+		int deltad = plan_ascent_velocity(config, depth, avg_depth) * TIMESTEP;
 		if (deltad > depth)
 			deltad = depth;
-		update_cylinder_pressure(dive, depth, depth - deltad, TIMESTEP, prefs.decosac, cylinder, true, divemode);
+		update_cylinder_pressure(config, dive, depth, depth - deltad, TIMESTEP, config->decosac, cylinder, true, divemode);
 		if (depth <= 5000 && depth >= (5000 - deltad) && safety_stop) {
-			update_cylinder_pressure(dive, 5000, 5000, 180, prefs.decosac, cylinder, true, divemode);
+			update_cylinder_pressure(config, dive, 5000, 5000, 180, config->decosac, cylinder, true, divemode);
 			safety_stop = false;
 		}
 		depth -= deltad;
@@ -542,58 +560,50 @@ static void track_ascent_gas(int depth, struct dive *dive, int cylinder_id, int
 }
 
 // Determine whether ascending to the next stop will break the ceiling.  Return true if the ascent is ok, false if it isn't.
-static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int stoplevel, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, struct dive *dive, enum divemode_t divemode)
+// The trial is run on a copy of the deco state, i.e. ds is not modified.
+static bool trial_ascent(const struct deco_state *ds, const struct plan_config *config, int wait_time, int trial_depth, int stoplevel, int avg_depth, struct gasmix gasmix, int po2, double surface_pressure, struct dive *dive, enum divemode_t divemode)
 {
-
-	bool clear_to_ascend = true;
-	struct deco_state *trial_cache = NULL;
+	struct deco_state trial_state = *ds;
 
 	// For consistency with other VPM-B implementations, we should not start the ascent while the ceiling is
 	// deeper than the next stop (thus the offgasing during the ascent is ignored).
 	// However, we still need to make sure we don't break the ceiling due to on-gassing during ascent.
-	cache_deco_state(ds, &trial_cache);
 	if (wait_time)
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial_state, depth_to_bar(trial_depth, dive),
 			    gasmix,
-			    wait_time, po2, divemode, prefs.decosac);
-	if (decoMode() == VPMB) {
-		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive));
-		update_regression(ds, dive);
-		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel) {
-			restore_deco_state(trial_cache, ds, false);
-			free(trial_cache);
+			    wait_time, po2, divemode, config->decosac);
+	if (trial_state.config.mode == VPMB) {
+		double tolerance_limit = tissue_tolerance_calc(&trial_state, dive, depth_to_bar(stoplevel, dive));
+		update_regression(&trial_state, dive);
+		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel)
 			return false;
-		}
 	}
 
 	while (trial_depth > stoplevel) {
 		double tolerance_limit;
-		int deltad = ascent_velocity(trial_depth, avg_depth, bottom_time) * TIMESTEP;
+		int deltad = plan_ascent_velocity(config, trial_depth, avg_depth) * TIMESTEP;
 		if (deltad > trial_depth) /* don't test against depth above surface */
 			deltad = trial_depth;
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial_state, depth_to_bar(trial_depth, dive),
 			    gasmix,
-			    TIMESTEP, po2, divemode, prefs.decosac);
-		tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive));
-		if (decoMode() == VPMB)
-			update_regression(ds, dive);
+			    TIMESTEP, po2, divemode, config->decosac);
+		tolerance_limit = tissue_tolerance_calc(&trial_state, dive, depth_to_bar(trial_depth, dive));
+		if (trial_state.config.mode == VPMB)
+			update_regression(&trial_state, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
-			clear_to_ascend = false;
-			break;
+			return false;
 		}
 		trial_depth -= deltad;
 	}
-	restore_deco_state(trial_cache, ds, false);
-	free(trial_cache);
-	return clear_to_ascend;
+	return true;
 }
 
 /* Determine if there is enough gas for the dive.  Return true if there is enough.
  * Also return true if this cannot be calculated because the cylinder doesn't have
  * size or a starting pressure.
  */
-static bool enough_gas(const struct dive *dive, int current_cylinder)
+static bool enough_gas(const struct plan_config *config, const struct dive *dive, int current_cylinder)
 {
 	cylinder_t *cyl;
 	if (current_cylinder < 0 || current_cylinder >= dive->cylinders.nr)
@@ -603,31 +613,56 @@ static bool enough_gas(const struct dive *dive, int current_cylinder)
 	if (!cyl->start.mbar)
 		return true;
 	if (cyl->type.size.mliter)
-		return (cyl->end.mbar - prefs.reserve_gas) / 1000.0 * cyl->type.size.mliter > cyl->deco_gas_used.mliter;
+		return (cyl->end.mbar - config->reserve_gas) / 1000.0 * cyl->type.size.mliter > cyl->deco_gas_used.mliter;
 	else
 		return true;
 }
 
-/* Do a binary search for the time the ceiling is clear to ascent to target_depth.
- * Minimal solution is min + 1, and the solution should be an integer multiple of stepsize.
- * leap is a guess for the maximum but there is no guarantee that leap is an upper limit.
- * So we always test at the upper bundary, not in the middle!
+/* Find the time the ceiling is clear to ascend to target_depth, i.e. the first multiple of
+ * stepsize after clock for which trial_ascent() succeeds. Each trial replays the ascent from
+ * the deco state, so keep their number low: starting from leap, a guess for the length of
+ * the stop, bracket the solution by doubling the step and then bisect the bracket. As long
+ * as waiting longer doesn't make the ascent harder, the trial fails before and succeeds after
+ * the solution and bisecting finds the same stop length as trying every candidate in turn.
+ * On trimix dives tissues may take up nitrogen while they release helium, so this isn't
+ * guaranteed, but the stop tables of deep trimix plans with nitrox deco gases agree with
+ * those of the exhaustive search (see the stop table tests in TestPlan). Falling back to
+ * the exhaustive search whenever ceiling_is_monotonic() fails would hit almost every stop
+ * of such plans.
+ * Stops of more than two days are reported as 50 hours.
  */
-static int wait_until(struct deco_state *ds, struct dive *dive, int clock, int min, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, enum divemode_t divemode)
+static int wait_until(const struct deco_state *ds, const struct plan_config *config, struct dive *dive, int clock, int leap, int stepsize, int depth, int target_depth, int avg_depth, struct gasmix gasmix, int po2, double surface_pressure, enum divemode_t divemode)
 {
-	// When a deco stop exceeds two days, there is something wrong...
-	if (min >= 48 * 3600)
-		return 50 * 3600;
-	// Round min + leap up to the next multiple of stepsize
-	int upper = min + leap + stepsize - 1 - (min + leap - 1) % stepsize;
-	// Is the upper boundary too small?
-	if (!trial_ascent(ds, upper - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode))
-		return wait_until(ds, dive, clock, upper, leap, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
-
-	if (upper - min <= stepsize)
-		return upper;
-
-	return wait_until(ds, dive, clock, min, leap / 2, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
+	int lower = clock, upper;
+
+	// Bracket: the trial fails at lower (or lower is the start of the stop) and succeeds at upper
+	for (;;) {
+		// When a deco stop exceeds two days, there is something wrong...
+		if (lower >= 48 * 3600)
+			return 50 * 3600;
+		// Round lower + leap up to the next multiple of stepsize
+		upper = lower + leap + stepsize - 1 - (lower + leap - 1) % stepsize;
+		if (trial_ascent(ds, config, upper - clock, depth, target_depth, avg_depth, gasmix, po2, surface_pressure, dive, divemode))
+			break;
+		lower = upper;
+		leap *= 2;
+	}
+
+	// Bisect until no multiple of stepsize is left between the bounds
+	while (upper - lower > stepsize) {
+		int middle = (lower + upper) / 2;
+		middle += stepsize - 1 - (middle - 1) % stepsize;
+		if (middle >= upper)
+			middle = upper - stepsize;
+		if (trial_ascent(ds, config, middle - clock, depth, target_depth, avg_depth, gasmix, po2, surface_pressure, dive, divemode)) {
+			upper = middle;
+		} else {
+			lower = middle;
+			if (lower >= 48 * 3600)
+				return 50 * 3600;
+		}
+	}
+	return upper;
 }
 
 static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_depth)
@@ -656,7 +691,33 @@ static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_de
 		*avg_depth = *max_depth = 0;
 }
 
-bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
+/*
+ * Set up the configuration of a plan from the preferences, using the deco mode
+ * of the planner or of the dive log, respectively.
+ */
+void init_plan_config(struct plan_config *config, bool planner)
+{
+	init_deco_config(&config->deco, planner);
+	config->metric_stops = prefs.units.length == METERS;
+	config->last_stop = prefs.last_stop;
+	config->safetystop = prefs.safetystop;
+	config->dobailout = prefs.dobailout;
+	config->doo2breaks = prefs.doo2breaks;
+	config->switch_at_req_stop = prefs.switch_at_req_stop;
+	config->min_switch_duration = prefs.min_switch_duration;
+	config->surface_segment = prefs.surface_segment;
+	config->ascrate75 = prefs.ascrate75;
+	config->ascrate50 = prefs.ascrate50;
+	config->ascratestops = prefs.ascratestops;
+	config->ascratelast6m = prefs.ascratelast6m;
+	config->bottomsac = prefs.bottomsac;
+	config->decosac = prefs.decosac;
+	config->reserve_gas = prefs.reserve_gas;
+	config->pscr_ratio = prefs.pscr_ratio;
+}
+
+/* The gradient factors and the conservatism of the diveplan take precedence over the ones of the config. */
+bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, const struct plan_config *config, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
 {
 
 	int bottom_depth;
@@ -666,7 +727,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int bottom_time;
 	int previous_deco_time;
 	struct deco_state *bottom_cache = NULL;
-	struct sample *sample;
+	struct sample sample;
 	int po2;
 	int transitiontime, gi;
 	int current_cylinder, stop_cylinder;
@@ -674,8 +735,9 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int depth;
 	struct gaschanges *gaschanges = NULL;
 	int gaschangenr;
-	int *decostoplevels;
-	int decostoplevelcount;
+	/* A copy of the stop levels, since the last stop is set per plan */
+	int decostoplevels[sizeof(decostoplevels_metric) / sizeof(int)];
+	int decostoplevelcount = sizeof(decostoplevels) / sizeof(int);
 	int *stoplevels = NULL;
 	bool stopping = false;
 	bool pendinggaschange = false;
@@ -695,58 +757,56 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int decostopcounter = 0;
 	enum divemode_t divemode = dive->dc.divemode;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	ds->config = config->deco;
+	set_gf(&ds->config, diveplan->gflow, diveplan->gfhigh);
+	set_vpmb_conservatism(&ds->config, diveplan->vpmb_conservatism);
 	if (!diveplan->surface_pressure)
 		diveplan->surface_pressure = SURFACE_PRESSURE;
 	dive->surface_pressure.mbar = diveplan->surface_pressure;
 	clear_deco(ds, dive->surface_pressure.mbar / 1000.0);
 	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
-	create_dive_from_plan(diveplan, dive, is_planner);
+	create_dive_from_plan(diveplan, config, dive, is_planner);
 
 	// Do we want deco stop array in metres or feet?
-	if (prefs.units.length == METERS ) {
-		decostoplevels = decostoplevels_metric;
-		decostoplevelcount = sizeof(decostoplevels_metric) / sizeof(int);
-	} else {
-		decostoplevels = decostoplevels_imperial;
-		decostoplevelcount = sizeof(decostoplevels_imperial) / sizeof(int);
-	}
+	if (config->metric_stops)
+		memcpy(decostoplevels, decostoplevels_metric, sizeof(decostoplevels));
+	else
+		memcpy(decostoplevels, decostoplevels_imperial, sizeof(decostoplevels));
 
 	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop.
 	 * Otherwise reinstate the last stop 3m/10' stop.
 	 */
-	if (prefs.last_stop)
+	if (config->last_stop)
 		*(decostoplevels + 1) = 0;
 	else
-		*(decostoplevels + 1) = M_OR_FT(3,10);
+		*(decostoplevels + 1) = config->metric_stops ? 3000 : feet_to_mm(10);
 
 	/* Let's start at the last 'sample', i.e. the last manually entered waypoint. */
-	sample = &dive->dc.sample[dive->dc.samples - 1];
+	sample = get_sample(&dive->dc, dive->dc.samples - 1);
 
 	/* Keep time during the ascend */
-	bottom_time = clock = previous_point_time = dive->dc.sample[dive->dc.samples - 1].time.seconds;
+	bottom_time = clock = previous_point_time = sample.time.seconds;
 
-	current_cylinder = get_cylinderid_at_time(dive, &dive->dc, sample->time);
+	current_cylinder = get_cylinderid_at_time(dive, &dive->dc, sample.time);
 	// Find the divemode at the end of the dive
 	const struct event *ev = NULL;
 	divemode = UNDEF_COMP_TYPE;
 	divemode = get_current_divemode(&dive->dc, bottom_time, &ev, &divemode);
 	gas = get_cylinder(dive, current_cylinder)->gasmix;
 
-	po2 = sample->setpoint.mbar;
-	depth = dive->dc.sample[dive->dc.samples - 1].depth.mm;
+	po2 = sample.setpoint.mbar;
+	depth = sample.depth.mm;
 	average_max_depth(diveplan, &avg_depth, &max_depth);
-	last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
+	last_ascend_rate = plan_ascent_velocity(config, depth, avg_depth);
 
 	/* if all we wanted was the dive just get us back to the surface */
 	if (!is_planner) {
 		/* Attn: for manually entered dives, we depend on the last segment having the
 		 * same ascent rate as in fake_dc(). If you change it here, also change it there.
 		 */
-		transitiontime = lrint(depth / (double)prefs.ascratelast6m);
+		transitiontime = lrint(depth / (double)config->ascratelast6m);
 		plan_add_segment(diveplan, transitiontime, 0, current_cylinder, po2, false, divemode);
-		create_dive_from_plan(diveplan, dive, is_planner);
+		create_dive_from_plan(diveplan, config, dive, is_planner);
 		return false;
 	}
 
@@ -759,7 +819,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	best_first_ascend_cylinder = current_cylinder;
 	/* Find the gases available for deco */
 
-	if (divemode == CCR && !prefs.dobailout) {	// Don't change gas in CCR mode
+	if (divemode == CCR && !config->dobailout) {	// Don't change gas in CCR mode
 		gaschanges = NULL;
 		gaschangenr = 0;
 	} else {
@@ -778,38 +838,38 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	gi = gaschangenr - 1;
 
 	/* Set tissue tolerance and initial vpmb gradient at start of ascent phase */
-	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap);
+	diveplan->surface_interval = tissue_at_end(ds, config, dive, cached_datap);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
-	if (decoMode() == RECREATIONAL) {
-		bool safety_stop = prefs.safetystop && max_depth >= 10000;
-		track_ascent_gas(depth, dive, current_cylinder, avg_depth, bottom_time, safety_stop, divemode);
+	if (ds->config.mode == RECREATIONAL) {
+		bool safety_stop = config->safetystop && max_depth >= 10000;
+		track_ascent_gas(config, depth, dive, current_cylinder, avg_depth, safety_stop, divemode);
 		// How long can we stay at the current depth and still directly ascent to the surface?
 		do {
 			add_segment(ds, depth_to_bar(depth, dive),
 				    get_cylinder(dive, current_cylinder)->gasmix,
-				    timestep, po2, divemode, prefs.bottomsac);
-			update_cylinder_pressure(dive, depth, depth, timestep, prefs.bottomsac, get_cylinder(dive, current_cylinder), false, divemode);
+				    timestep, po2, divemode, config->bottomsac);
+			update_cylinder_pressure(config, dive, depth, depth, timestep, config->bottomsac, get_cylinder(dive, current_cylinder), false, divemode);
 			clock += timestep;
-		} while (trial_ascent(ds, 0, depth, 0, avg_depth, bottom_time, get_cylinder(dive, current_cylinder)->gasmix,
+		} while (trial_ascent(ds, config, 0, depth, 0, avg_depth, get_cylinder(dive, current_cylinder)->gasmix,
 				      po2, diveplan->surface_pressure / 1000.0, dive, divemode) &&
-			 enough_gas(dive, current_cylinder) && clock < 6 * 3600);
+			 enough_gas(config, dive, current_cylinder) && clock < 6 * 3600);
 
 		// We did stay one DECOTIMESTEP too many.
 		// In the best of all worlds, we would roll back also the last add_segment in terms of caching deco state, but
 		// let's ignore that since for the eventual ascent in recreational mode, nobody looks at the ceiling anymore,
 		// so we don't really have to compute the deco state.
-		update_cylinder_pressure(dive, depth, depth, -timestep, prefs.bottomsac, get_cylinder(dive, current_cylinder), false, divemode);
+		update_cylinder_pressure(config, dive, depth, depth, -timestep, config->bottomsac, get_cylinder(dive, current_cylinder), false, divemode);
 		clock -= timestep;
 		plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, true, divemode);
 		previous_point_time = clock;
 		do {
 			/* Ascend to surface */
-			int deltad = ascent_velocity(depth, avg_depth, bottom_time) * TIMESTEP;
-			if (ascent_velocity(depth, avg_depth, bottom_time) != last_ascend_rate) {
+			int deltad = plan_ascent_velocity(config, depth, avg_depth) * TIMESTEP;
+			if (plan_ascent_velocity(config, depth, avg_depth) != last_ascend_rate) {
 				plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, false, divemode);
 				previous_point_time = clock;
-				last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
+				last_ascend_rate = plan_ascent_velocity(config, depth, avg_depth);
 			}
 			if (depth - deltad < 0)
 				deltad = depth;
@@ -826,7 +886,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			}
 		} while (depth > 0);
 		plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false, divemode);
-		create_dive_from_plan(diveplan, dive, is_planner);
+		create_dive_from_plan(diveplan, config, dive, is_planner);
 		add_plan_to_notes(diveplan, dive, show_disclaimer, error);
 		fixup_dc_duration(&dive->dc);
 
@@ -846,15 +906,15 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 
 	// VPM-B or Buehlmann Deco
-	tissue_at_end(ds, dive, cached_datap);
-	if ((divemode == CCR || divemode == PSCR) && prefs.dobailout) {
+	tissue_at_end(ds, config, dive, cached_datap);
+	if ((divemode == CCR || divemode == PSCR) && config->dobailout) {
 		divemode = OC;
 		po2 = 0;
 		add_segment(ds, depth_to_bar(depth, dive),
 			get_cylinder(dive, current_cylinder)->gasmix,
-			prefs.min_switch_duration, po2, divemode, prefs.bottomsac);
-		plan_add_segment(diveplan, prefs.min_switch_duration, depth, current_cylinder, po2, false, divemode);
-		clock += prefs.min_switch_duration;
+			config->min_switch_duration, po2, divemode, config->bottomsac);
+		plan_add_segment(diveplan, config->min_switch_duration, depth, current_cylinder, po2, false, divemode);
+		clock += config->min_switch_duration;
 		last_segment_min_switch = true;
 	}
 	previous_deco_time = 100000000;
@@ -868,7 +928,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	//CVA
 	do {
 		decostopcounter = 0;
-		is_final_plan = (decoMode() == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
+		is_final_plan = (ds->config.mode == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
 		if (ds->deco_time != 10000000)
 			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0);
 
@@ -890,7 +950,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		if (ds->max_bottom_ceiling_pressure.mbar > ds->first_ceiling_pressure.mbar)
 			ds->first_ceiling_pressure.mbar = ds->max_bottom_ceiling_pressure.mbar;
 
-		last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
+		last_ascend_rate = plan_ascent_velocity(config, depth, avg_depth);
 		/* Always prefer the best_first_ascend_cylinder if it has the right gasmix.
 		 * Otherwise take first cylinder from list with rightgasmix  */
 		if (same_gasmix(gas, get_cylinder(dive, best_first_ascend_cylinder)->gasmix))
@@ -906,20 +966,20 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			/* We will break out when we hit the surface */
 			do {
 				/* Ascend to next stop depth */
-				int deltad = ascent_velocity(depth, avg_depth, bottom_time) * TIMESTEP;
-				if (ascent_velocity(depth, avg_depth, bottom_time) != last_ascend_rate) {
+				int deltad = plan_ascent_velocity(config, depth, avg_depth) * TIMESTEP;
+				if (plan_ascent_velocity(config, depth, avg_depth) != last_ascend_rate) {
 					if (is_final_plan)
 						plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, false, divemode);
 					previous_point_time = clock;
 					stopping = false;
-					last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
+					last_ascend_rate = plan_ascent_velocity(config, depth, avg_depth);
 				}
 				if (depth - deltad < stoplevels[stopidx])
 					deltad = depth - stoplevels[stopidx];
 
 				add_segment(ds, depth_to_bar(depth, dive),
 								get_cylinder(dive, current_cylinder)->gasmix,
-								TIMESTEP, po2, divemode, prefs.decosac);
+								TIMESTEP, po2, divemode, config->decosac);
 				last_segment_min_switch = false;
 				clock += TIMESTEP;
 				depth -= deltad;
@@ -941,8 +1001,8 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 				 * If current gas is hypoxic, we want to switch asap */
 
 				if (current_cylinder != gaschanges[gi].gasidx) {
-					if (!prefs.switch_at_req_stop ||
-							!trial_ascent(ds, 0, depth, stoplevels[stopidx - 1], avg_depth, bottom_time,
+					if (!config->switch_at_req_stop ||
+							!trial_ascent(ds, config, 0, depth, stoplevels[stopidx - 1], avg_depth,
 							get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, dive, divemode) || get_o2(get_cylinder(dive, current_cylinder)->gasmix) < 160) {
 						if (is_final_plan)
 							plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, false, divemode);
@@ -958,8 +1018,8 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 						if (!last_segment_min_switch && get_o2(get_cylinder(dive, current_cylinder)->gasmix) != 1000) {
 							add_segment(ds, depth_to_bar(depth, dive),
 								get_cylinder(dive, current_cylinder)->gasmix,
-								prefs.min_switch_duration, po2, divemode, prefs.decosac);
-							clock += prefs.min_switch_duration;
+								config->min_switch_duration, po2, divemode, config->decosac);
+							clock += config->min_switch_duration;
 							last_segment_min_switch = true;
 						}
 					} else {
@@ -976,7 +1036,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			/* Save the current state and try to ascend to the next stopdepth */
 			while (1) {
 				/* Check if ascending to next stop is clear, go back and wait if we hit the ceiling on the way */
-				if (trial_ascent(ds, 0, depth, stoplevels[stopidx], avg_depth, bottom_time,
+				if (trial_ascent(ds, config, 0, depth, stoplevels[stopidx], avg_depth,
 						get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, dive, divemode)) {
 					decostoptable[decostopcounter].depth = depth;
 					decostoptable[decostopcounter].time = 0;
@@ -1012,15 +1072,15 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					if (!last_segment_min_switch && get_o2(get_cylinder(dive, current_cylinder)->gasmix) != 1000) {
 						add_segment(ds, depth_to_bar(depth, dive),
 							get_cylinder(dive, current_cylinder)->gasmix,
-							prefs.min_switch_duration, po2, divemode, prefs.decosac);
-						clock += prefs.min_switch_duration;
+							config->min_switch_duration, po2, divemode, config->decosac);
+						clock += config->min_switch_duration;
 						last_segment_min_switch = true;
 					}
 					pendinggaschange = false;
 				}
 
-				int new_clock = wait_until(ds, dive, clock, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth,
-					bottom_time, get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, divemode);
+				int new_clock = wait_until(ds, config, dive, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth,
+					get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, divemode);
 				laststoptime = new_clock - clock;
 				/* Finish infinite deco */
 				if (laststoptime >= 48 * 3600 && depth >= 6000) {
@@ -1030,7 +1090,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 
 				o2breaking = false;
 				stop_cylinder = current_cylinder;
-				if (prefs.doo2breaks && prefs.last_stop) {
+				if (config->doo2breaks && config->last_stop) {
 					/* The backgas breaks option limits time on oxygen to 12 minutes, followed by 6 minutes on
 					 * backgas.  This could be customized if there were demand.
 					 */
@@ -1068,7 +1128,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					}
 				}
 				add_segment(ds, depth_to_bar(depth, dive), get_cylinder(dive, stop_cylinder)->gasmix,
-					    laststoptime, po2, divemode, prefs.decosac);
+					    laststoptime, po2, divemode, config->decosac);
 				last_segment_min_switch = false;
 				decostoptable[decostopcounter].depth = depth;
 				decostoptable[decostopcounter].time = laststoptime;
@@ -1095,21 +1155,21 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	decostoptable[decostopcounter].depth = 0;
 
 	plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false, divemode);
-	if (decoMode() == VPMB) {
+	if (ds->config.mode == VPMB) {
 		diveplan->eff_gfhigh = lrint(100.0 * regressionb(ds));
 		diveplan->eff_gflow = lrint(100.0 * (regressiona(ds) * first_stop_depth + regressionb(ds)));
 	}
 
-	if (prefs.surface_segment != 0) {
+	if (config->surface_segment != 0) {
 		// Switch to an empty air cylinder for breathing air at the surface
 		// If no empty cylinder is found, keep using last deco gas
 		cylinder_t cyl = { 0 };
 		cyl.cylinder_use = NOT_USED;
 		add_to_cylinder_table(&dive->cylinders, dive->cylinders.nr, cyl);
 		current_cylinder = dive->cylinders.nr - 1;
-		plan_add_segment(diveplan, prefs.surface_segment, 0, current_cylinder, 0, false, OC);
+		plan_add_segment(diveplan, config->surface_segment, 0, current_cylinder, 0, false, OC);
 	}
-	create_dive_from_plan(diveplan, dive, is_planner);
+	create_dive_from_plan(diveplan, config, dive, is_planner);
 	add_plan_to_notes(diveplan, dive, show_disclaimer, error);
 	fixup_dc_duration(&dive->dc);
 
@@ -7,6 +7,7 @@
 
 #include "units.h"
 #include "divemode.h"
+#include "deco.h"
 
 /* this should be converted to use our types */
 struct divedatapoint {
@@ -66,7 +67,30 @@ struct decostop {
 	int depth;
 	int time;
 };
-extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
+
+/*
+ * The settings a dive is planned with. They are passed to plan() instead of
+ * being read from the preferences, so that plans calculated concurrently,
+ * such as the variations of a plan, don't see the preferences change.
+ */
+struct plan_config {
+	struct deco_config deco;
+	bool metric_stops;		// deco stops every 3m instead of every 10ft
+	bool last_stop;			// last stop at 6m/20ft
+	bool safetystop;
+	bool dobailout;
+	bool doo2breaks;
+	bool switch_at_req_stop;
+	int min_switch_duration;	// seconds
+	int surface_segment;		// seconds
+	int ascrate75, ascrate50, ascratestops, ascratelast6m;	// mm/sec
+	int bottomsac, decosac;		// ml/min
+	int reserve_gas;		// mbar
+	int pscr_ratio;			// 1/1000
+};
+
+extern void init_plan_config(struct plan_config *config, bool planner);
+extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, const struct plan_config *config, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
 
 #ifdef __cplusplus
 }
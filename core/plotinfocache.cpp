@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "plotinfocache.h"
+#include "pref.h"
+#include "profile.h"
+
+#include <iterator>
+#include <list>
+
+namespace {
+	// The preferences that the calculation of the plot info depends on
+	struct PlotPrefs {
+		enum deco_mode deco_mode;
+		int gflow, gfhigh;
+		int vpmb_conservatism;
+		bool calcndltts;
+		bool calcceiling3m;
+		bool zoomed_plot;
+		bool show_icd;
+		int bottomsac, decosac;
+		int pscr_ratio;
+		int o2consumption;
+		double modpO2;
+		// ascent rates of the NDL/TTS calculation
+		int ascrate75, ascrate50, ascratestops, ascratelast6m;
+	};
+
+	struct PlotInfoCacheEntry {
+		int id;
+		int dc_nr;
+		// The fields of the dive that the plot info was calculated with, as a
+		// safeguard against modifications that did not invalidate the cache.
+		timestamp_t when;
+		int duration;
+		int samples;
+		PlotPrefs prefs;
+		struct plot_info pi;
+	};
+}
+
+// Every entry holds the data of a whole profile, so keep only a few
+static const size_t max_entries = 8;
+
+// Sorted by last access, most recent first
+static std::list<PlotInfoCacheEntry> cache;
+static int hits, misses;
+
+static PlotPrefs current_plot_prefs()
+{
+	PlotPrefs res;
+	res.deco_mode = prefs.display_deco_mode;
+	res.gflow = prefs.gflow;
+	res.gfhigh = prefs.gfhigh;
+	res.vpmb_conservatism = prefs.vpmb_conservatism;
+	res.calcndltts = prefs.calcndltts;
+	res.calcceiling3m = prefs.calcceiling3m;
+	res.zoomed_plot = prefs.zoomed_plot;
+	res.show_icd = prefs.show_icd;
+	res.bottomsac = prefs.bottomsac;
+	res.decosac = prefs.decosac;
+	res.pscr_ratio = prefs.pscr_ratio;
+	res.o2consumption = prefs.o2consumption;
+	res.modpO2 = prefs.modpO2;
+	res.ascrate75 = prefs.ascrate75;
+	res.ascrate50 = prefs.ascrate50;
+	res.ascratestops = prefs.ascratestops;
+	res.ascratelast6m = prefs.ascratelast6m;
+	return res;
+}
+
+static bool same_prefs(const PlotPrefs &p1, const PlotPrefs &p2)
+{
+	return p1.deco_mode == p2.deco_mode && p1.gflow == p2.gflow && p1.gfhigh == p2.gfhigh &&
+	       p1.vpmb_conservatism == p2.vpmb_conservatism && p1.calcndltts == p2.calcndltts &&
+	       p1.calcceiling3m == p2.calcceiling3m && p1.zoomed_plot == p2.zoomed_plot &&
+	       p1.show_icd == p2.show_icd && p1.bottomsac == p2.bottomsac && p1.decosac == p2.decosac &&
+	       p1.pscr_ratio == p2.pscr_ratio && p1.o2consumption == p2.o2consumption && p1.modpO2 == p2.modpO2 &&
+	       p1.ascrate75 == p2.ascrate75 && p1.ascrate50 == p2.ascrate50 &&
+	       p1.ascratestops == p2.ascratestops && p1.ascratelast6m == p2.ascratelast6m;
+}
+
+static bool same_dive(const PlotInfoCacheEntry &entry, const struct dive *dive)
+{
+	return entry.when == dive->when && entry.duration == (int)dive->dc.duration.seconds &&
+	       entry.samples == dive->dc.samples;
+}
+
+static std::list<PlotInfoCacheEntry>::iterator find_entry(int id, int dc_nr)
+{
+	for (auto it = cache.begin(); it != cache.end(); ++it) {
+		if (it->id == id && it->dc_nr == dc_nr)
+			return it;
+	}
+	return cache.end();
+}
+
+static std::list<PlotInfoCacheEntry>::iterator erase_entry(std::list<PlotInfoCacheEntry>::iterator it)
+{
+	free_plot_info_data(&it->pi);
+	return cache.erase(it);
+}
+
+extern "C" bool get_cached_plot_info(struct dive *dive, struct divecomputer *dc, int dc_nr, unsigned int channels, struct plot_info *pi)
+{
+	auto it = find_entry(dive->id, dc_nr);
+	if (it == cache.end() || !same_dive(*it, dive) || !same_prefs(it->prefs, current_plot_prefs()) ||
+	    (channels & ~it->pi.channels)) {
+		++misses;
+		return false;
+	}
+	++hits;
+	cache.splice(cache.begin(), cache, it);
+	copy_plot_info_data(pi, &it->pi);
+	pi->dive = dive;
+	pi->dc = dc;
+	return true;
+}
+
+extern "C" void cache_plot_info(const struct dive *dive, int dc_nr, const struct plot_info *pi)
+{
+	auto it = find_entry(dive->id, dc_nr);
+	if (it != cache.end())
+		erase_entry(it);
+	while (cache.size() >= max_entries)
+		erase_entry(std::prev(cache.end()));
+
+	cache.emplace_front();
+	PlotInfoCacheEntry &entry = cache.front();
+	entry.id = dive->id;
+	entry.dc_nr = dc_nr;
+	entry.when = dive->when;
+	entry.duration = dive->dc.duration.seconds;
+	entry.samples = dive->dc.samples;
+	entry.prefs = current_plot_prefs();
+	init_plot_info(&entry.pi);
+	copy_plot_info_data(&entry.pi, pi);
+	// The copy must not refer to the dive it was calculated from
+	entry.pi.dive = NULL;
+	entry.pi.dc = NULL;
+	entry.pi.planner_ds = NULL;
+}
+
+extern "C" void invalidate_plot_info_cache(const struct dive *dive)
+{
+	// If the start time of the dive changed, the dives between the old
+	// and the new time are also affected.
+	timestamp_t when = dive->when;
+	for (const PlotInfoCacheEntry &entry: cache) {
+		if (entry.id == dive->id && entry.when < when)
+			when = entry.when;
+	}
+	invalidate_plot_info_cache_from(when);
+}
+
+extern "C" void invalidate_plot_info_cache_from(timestamp_t when)
+{
+	for (auto it = cache.begin(); it != cache.end(); ) {
+		if (it->when >= when)
+			it = erase_entry(it);
+		else
+			++it;
+	}
+}
+
+extern "C" void clear_plot_info_cache()
+{
+	while (!cache.empty())
+		erase_entry(cache.begin());
+}
+
+extern "C" void get_plot_info_cache_stats(int *hits_out, int *misses_out)
+{
+	*hits_out = hits;
+	*misses_out = misses;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Cache of the plot info of the most recently shown dives.
+ *
+ * Calculating the deco data of a profile takes long. To make switching
+ * between dives or dive computers cheap, the profile stores the plot
+ * info of the last few dives it has shown. An entry is found by dive id
+ * and dive computer number and is only returned if it was calculated
+ * with the current profile-relevant preferences and contains the
+ * requested channels (see enum plot_channel).
+ *
+ * The plot info of a dive depends on the tissue loading, i.e. on all
+ * dives before it. Therefore, like the tissue cache, when a dive changes
+ * all entries of dives starting at or after that dive are dropped.
+ *
+ * Unlike the tissue cache, this cache is only accessed from the GUI thread.
+ */
+#ifndef PLOTINFOCACHE_H
+#define PLOTINFOCACHE_H
+
+#include "display.h"
+#include "dive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* On success, the copy in pi refers to the passed dive and dive computer */
+extern bool get_cached_plot_info(struct dive *dive, struct divecomputer *dc, int dc_nr, unsigned int channels, struct plot_info *pi);
+extern void cache_plot_info(const struct dive *dive, int dc_nr, const struct plot_info *pi);
+extern void invalidate_plot_info_cache(const struct dive *dive);
+extern void invalidate_plot_info_cache_from(timestamp_t when);
+extern void clear_plot_info_cache(void);
+extern void get_plot_info_cache_stats(int *hits, int *misses);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLOTINFOCACHE_H
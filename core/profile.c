@@ -12,9 +12,11 @@
 #include "subsurface-string.h"
 #include "display.h"
 #include "divelist.h"
+#include "eventindex.h"
 
 #include "profile.h"
 #include "gaspressures.h"
+#include "samplecolumns.h"
 #include "deco.h"
 #include "libdivecomputer/parser.h"
 #include "libdivecomputer/version.h"
@@ -198,48 +200,6 @@ static int get_local_sac(struct plot_info *pi, int idx1, int idx2, struct dive *
 }
 
 #define HALF_INTERVAL 9 * 30
-/*
- * Run the min/max calculations: over a 9 minute interval
- * around the entry point (indices 0, 1, 2 respectively).
- */
-static void analyze_plot_info_minmax(struct plot_info *pi, int entry_index)
-{
-	struct plot_data *plot_entry = pi->entry + entry_index;  // fixed
-	struct plot_data *p = plot_entry;  // moves with 'entry'
-	int start = p->sec - HALF_INTERVAL, end = p->sec + HALF_INTERVAL;
-	int min, max;
-
-	/* Go back 'seconds' in time */
-	while (entry_index > 0) {
-		if (p[-1].sec < start)
-			break;
-		entry_index--;
-		p--;
-	}
-
-	// indexes to the min/max entries
-	min = max = entry_index;
-
-	/* Then go forward until we hit an entry past the time */
-	while (entry_index < pi->nr) {
-		int time = p->sec;
-		int depth = p->depth;
-
-		if (time > end)
-			break;
-
-		if (depth < pi->entry[min].depth)
-			min = entry_index;
-		if (depth > pi->entry[max].depth)
-			max = entry_index;
-
-		p++;
-		entry_index++;
-	}
-
-	plot_entry->min = min;
-	plot_entry->max = max;
-}
 
 static velocity_t velocity(int speed)
 {
@@ -269,43 +229,81 @@ static velocity_t velocity(int speed)
 	return v;
 }
 
+/*
+ * Smooth the depth, calculate the vertical velocity and run the min/max
+ * calculations over a 9 minute interval around every entry in one pass.
+ *
+ * For the min/max, the entries of the interval are kept in two queues of
+ * indices with monotonic depths. The first elements of these queues are
+ * the earliest minimum and maximum of the interval. Since the intervals
+ * only move forward, every entry is added and removed at most once.
+ */
 struct plot_info *analyze_plot_info(struct plot_info *pi)
 {
 	int i;
 	int nr = pi->nr;
+	int *minq, *maxq;
+	int min_head = 0, min_tail = 0, max_head = 0, max_tail = 0;
+	int next = 0; /* the next entry to enter the min/max interval */
+
+	if (nr <= 0)
+		return pi;
+	minq = malloc(nr * sizeof(*minq));
+	maxq = malloc(nr * sizeof(*maxq));
 
-	/* Smoothing function: 5-point triangular smooth */
-	for (i = 2; i < nr; i++) {
+	for (i = 0; i < nr; i++) {
 		struct plot_data *entry = pi->entry + i;
-		int depth;
 
-		if (i < nr - 2) {
-			depth = entry[-2].depth + 2 * entry[-1].depth + 3 * entry[0].depth + 2 * entry[1].depth + entry[2].depth;
-			entry->smoothed = (depth + 4) / 9;
-		}
-		/* vertical velocity in mm/sec */
-		/* Linus wants to smooth this - let's at least look at the samples that aren't FAST or CRAZY */
-		if (entry[0].sec - entry[-1].sec) {
-			entry->speed = (entry[0].depth - entry[-1].depth) / (entry[0].sec - entry[-1].sec);
-			entry->velocity = velocity(entry->speed);
-			/* if our samples are short and we aren't too FAST*/
-			if (entry[0].sec - entry[-1].sec < 15 && entry->velocity < FAST) {
-				int past = -2;
-				while (i + past > 0 && entry[0].sec - entry[past].sec < 15)
-					past--;
-				entry->velocity = velocity((entry[0].depth - entry[past].depth) /
-							   (entry[0].sec - entry[past].sec));
+		if (i >= 2) {
+			int depth;
+
+			/* Smoothing function: 5-point triangular smooth */
+			if (i < nr - 2) {
+				depth = entry[-2].depth + 2 * entry[-1].depth + 3 * entry[0].depth + 2 * entry[1].depth + entry[2].depth;
+				entry->smoothed = (depth + 4) / 9;
+			}
+			/* vertical velocity in mm/sec */
+			/* Linus wants to smooth this - let's at least look at the samples that aren't FAST or CRAZY */
+			if (entry[0].sec - entry[-1].sec) {
+				entry->speed = (entry[0].depth - entry[-1].depth) / (entry[0].sec - entry[-1].sec);
+				entry->velocity = velocity(entry->speed);
+				/* if our samples are short and we aren't too FAST*/
+				if (entry[0].sec - entry[-1].sec < 15 && entry->velocity < FAST) {
+					int past = -2;
+					while (i + past > 0 && entry[0].sec - entry[past].sec < 15)
+						past--;
+					entry->velocity = velocity((entry[0].depth - entry[past].depth) /
+								   (entry[0].sec - entry[past].sec));
+				}
+			} else {
+				entry->velocity = STABLE;
+				entry->speed = 0;
 			}
-		} else {
-			entry->velocity = STABLE;
-			entry->speed = 0;
 		}
-	}
 
-	/* get minmax data */
-	for (i = 0; i < nr; i++)
-		analyze_plot_info_minmax(pi, i);
+		/* get minmax data: first add the entries up to the end of the interval... */
+		while (next < nr && (next <= i || pi->entry[next].sec <= entry->sec + HALF_INTERVAL)) {
+			int depth = pi->entry[next].depth;
+			while (min_tail > min_head && pi->entry[minq[min_tail - 1]].depth > depth)
+				min_tail--;
+			minq[min_tail++] = next;
+			while (max_tail > max_head && pi->entry[maxq[max_tail - 1]].depth < depth)
+				max_tail--;
+			maxq[max_tail++] = next;
+			next++;
+		}
+		/* ...then remove the entries before its start */
+		while (min_head < min_tail - 1 && pi->entry[minq[min_head]].sec < entry->sec - HALF_INTERVAL)
+			min_head++;
+		while (max_head < max_tail - 1 && pi->entry[maxq[max_head]].sec < entry->sec - HALF_INTERVAL)
+			max_head++;
+
+		entry->min = minq[min_head];
+		entry->max = maxq[max_head];
+	}
 
+	free(minq);
+	free(maxq);
 	return pi;
 }
 
@@ -426,16 +424,21 @@ static void calculate_max_limits_new(struct dive *dive, struct divecomputer *giv
 	do {
 		if (dc == given_dc)
 			seen = true;
-		int i = dc->samples;
+		int i;
 		int lastdepth = 0;
-		struct sample *s = dc->sample;
+		struct sample_column sample_time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+		struct sample_column sample_depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+		struct sample_column sample_pressure = get_sample_column(dc, SAMPLE_CHANNEL_PRESSURE0);
+		struct sample_column sample_temperature = get_sample_column(dc, SAMPLE_CHANNEL_TEMPERATURE);
+		struct sample_column sample_heartbeat = get_sample_column(dc, SAMPLE_CHANNEL_HEARTBEAT);
 		struct event *ev;
 
-		while (--i >= 0) {
-			int depth = s->depth.mm;
-			int pressure = s->pressure[0].mbar;
-			int temperature = s->temperature.mkelvin;
-			int heartbeat = s->heartbeat;
+		for (i = 0; i < dc->samples; i++) {
+			int depth = SAMPLE_VALUE(sample_depth, depth_t, i).mm;
+			int pressure = SAMPLE_VALUE(sample_pressure, pressure_t, i).mbar;
+			int temperature = SAMPLE_VALUE(sample_temperature, temperature_t, i).mkelvin;
+			int heartbeat = SAMPLE_VALUE(sample_heartbeat, uint8_t, i);
+			int time = SAMPLE_VALUE(sample_time, duration_t, i).seconds;
 
 			if (!mintemp && temperature < mintemp)
 				mintemp = temperature;
@@ -452,12 +455,11 @@ static void calculate_max_limits_new(struct dive *dive, struct divecomputer *giv
 				minhr = heartbeat;
 
 			if (depth > maxdepth)
-				maxdepth = s->depth.mm;
+				maxdepth = depth;
 			if ((depth > SURFACE_THRESHOLD || lastdepth > SURFACE_THRESHOLD || in_planner()) &&
-			    s->time.seconds > maxtime)
-				maxtime = s->time.seconds;
+			    time > maxtime)
+				maxtime = time;
 			lastdepth = depth;
-			s++;
 		}
 
 		/* Make sure we can fit all events */
@@ -511,7 +513,34 @@ void free_plot_info_data(struct plot_info *pi)
 {
 	free(pi->entry);
 	free(pi->pressures);
+	free(pi->deco);
+	free(pi->gas);
 	pi->entry = NULL;
+	pi->pressures = NULL;
+	pi->deco = NULL;
+	pi->gas = NULL;
+	pi->channels = 0;
+}
+
+static void *copy_plot_array(const void *src, size_t size)
+{
+	void *res;
+	if (!src)
+		return NULL;
+	res = malloc(size);
+	memcpy(res, src, size);
+	return res;
+}
+
+/* Replaces the data of dst by a copy of the data of src */
+void copy_plot_info_data(struct plot_info *dst, const struct plot_info *src)
+{
+	free_plot_info_data(dst);
+	*dst = *src;
+	dst->entry = copy_plot_array(src->entry, src->nr * sizeof(struct plot_data));
+	dst->pressures = copy_plot_array(src->pressures, src->nr_cylinders * src->nr * sizeof(struct plot_pressure_data));
+	dst->deco = copy_plot_array(src->deco, src->nr * sizeof(struct plot_deco_data));
+	dst->gas = copy_plot_array(src->gas, src->nr * sizeof(struct plot_gas_data));
 }
 
 static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, struct plot_info *pi)
@@ -549,11 +578,11 @@ static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, st
 		ev = ev->next;
 	for (i = 0; i < dc->samples; i++) {
 		struct plot_data *entry = plot_data + idx;
-		struct sample *sample = dc->sample + i;
-		int time = sample->time.seconds;
+		struct sample sample = get_sample(dc, i);
+		int time = sample.time.seconds;
 		int offset, delta;
-		int depth = sample->depth.mm;
-		int sac = sample->sac.mliter;
+		int depth = sample.depth.mm;
+		int sac = sample.sac.mliter;
 
 		/* Add intermediate plot entries if required */
 		delta = time - lasttime;
@@ -595,33 +624,33 @@ static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, st
 		entry->depth = depth;
 
 		entry->running_sum = (entry - 1)->running_sum + (time - (entry - 1)->sec) * (depth + (entry - 1)->depth) / 2;
-		entry->stopdepth = sample->stopdepth.mm;
-		entry->stoptime = sample->stoptime.seconds;
-		entry->ndl = sample->ndl.seconds;
-		entry->tts = sample->tts.seconds;
-		entry->in_deco = sample->in_deco;
-		entry->cns = sample->cns;
+		entry->stopdepth = sample.stopdepth.mm;
+		entry->stoptime = sample.stoptime.seconds;
+		entry->ndl = sample.ndl.seconds;
+		entry->tts = sample.tts.seconds;
+		entry->in_deco = sample.in_deco;
+		entry->cns = sample.cns;
 		if (dc->divemode == CCR || (dc->divemode == PSCR && dc->no_o2sensors)) {
-			entry->o2pressure.mbar = entry->o2setpoint.mbar = sample->setpoint.mbar;     // for rebreathers
-			entry->o2sensor[0].mbar = sample->o2sensor[0].mbar; // for up to three rebreather O2 sensors
-			entry->o2sensor[1].mbar = sample->o2sensor[1].mbar;
-			entry->o2sensor[2].mbar = sample->o2sensor[2].mbar;
+			entry->o2pressure.mbar = entry->o2setpoint.mbar = sample.setpoint.mbar;     // for rebreathers
+			entry->o2sensor[0].mbar = sample.o2sensor[0].mbar; // for up to three rebreather O2 sensors
+			entry->o2sensor[1].mbar = sample.o2sensor[1].mbar;
+			entry->o2sensor[2].mbar = sample.o2sensor[2].mbar;
 		} else {
-			entry->pressures.o2 = sample->setpoint.mbar / 1000.0;
+			entry->pressures.o2 = sample.setpoint.mbar / 1000.0;
 		}
-		if (sample->pressure[0].mbar)
-			set_plot_pressure_data(pi, idx, SENSOR_PR, sample->sensor[0], sample->pressure[0].mbar);
-		if (sample->pressure[1].mbar)
-			set_plot_pressure_data(pi, idx, SENSOR_PR, sample->sensor[1], sample->pressure[1].mbar);
-		if (sample->temperature.mkelvin)
-			entry->temperature = lasttemp = sample->temperature.mkelvin;
+		if (sample.pressure[0].mbar)
+			set_plot_pressure_data(pi, idx, SENSOR_PR, sample.sensor[0], sample.pressure[0].mbar);
+		if (sample.pressure[1].mbar)
+			set_plot_pressure_data(pi, idx, SENSOR_PR, sample.sensor[1], sample.pressure[1].mbar);
+		if (sample.temperature.mkelvin)
+			entry->temperature = lasttemp = sample.temperature.mkelvin;
 		else
 			entry->temperature = lasttemp;
-		entry->heartbeat = sample->heartbeat;
-		entry->bearing = sample->bearing.degrees;
-		entry->sac = sample->sac.mliter;
-		if (sample->rbt.seconds)
-			entry->rbt = sample->rbt.seconds;
+		entry->heartbeat = sample.heartbeat;
+		entry->bearing = sample.bearing.degrees;
+		entry->sac = sample.sac.mliter;
+		if (sample.rbt.seconds)
+			entry->rbt = sample.rbt.seconds;
 		/* skip events that happened at this time */
 		while (ev && (int)ev->time.seconds == time)
 			ev = ev->next;
@@ -946,8 +975,134 @@ static void setup_gas_sensor_pressure(const struct dive *dive, const struct dive
 }
 
 #ifndef SUBSURFACE_MOBILE
+/* The step counts of the previous NDL/TTS calculation, which are the starting points of the
+ * next one in VPM-B mode, where the ceiling crossing times can't be estimated from the M-values */
+struct ndl_tts_hint {
+	int ndl_steps;
+	int nr_stops;
+	int *stop_steps;	// indexed by stop depth / deco step size
+};
+
+static void free_ndl_tts_hint(struct ndl_tts_hint *hint)
+{
+	free(hint->stop_steps);
+}
+
+static int *stop_steps_hint(struct ndl_tts_hint *hint, int stop)
+{
+	if (stop >= hint->nr_stops) {
+		hint->stop_steps = realloc(hint->stop_steps, (stop + 1) * sizeof(*hint->stop_steps));
+		while (hint->nr_stops <= stop)
+			hint->stop_steps[hint->nr_stops++] = 1;
+	}
+	return &hint->stop_steps[stop];
+}
+
+/* Has the ceiling crossed limit_depth after the given number of time steps at the constant depth?
+ * Loading tissues cross when the ceiling is below the limit, unloading ones when it is at or above it. */
+static bool ceiling_crossed_after(const struct deco_state *ds, struct deco_state *trial, const struct dive *dive, int depth, int steps,
+				  int time_stepsize, int limit_depth, bool loading, struct gasmix gasmix, int ccpo2, enum divemode_t divemode,
+				  double surface_pressure)
+{
+	int ceiling;
+
+	*trial = *ds;
+	add_segment(trial, depth_to_bar(depth, dive), gasmix, steps * time_stepsize, ccpo2, divemode, loading ? prefs.bottomsac : prefs.decosac);
+	ceiling = deco_allowed_depth(tissue_tolerance_calc(trial, dive, depth_to_bar(depth, dive)), surface_pressure, dive, 1);
+	return loading ? ceiling > limit_depth : ceiling <= limit_depth;
+}
+
+/* Add one time step after the other until the ceiling crosses limit_depth */
+static int scan_steps_to_ceiling_crossing(struct deco_state *ds, const struct dive *dive, int depth, int time_stepsize, int limit_depth, bool loading,
+					  struct gasmix gasmix, int ccpo2, enum divemode_t divemode, double surface_pressure, int max_steps)
+{
+	struct deco_state trial = *ds;
+	int steps, ceiling;
+
+	for (steps = 1; steps <= max_steps; steps++) {
+		add_segment(&trial, depth_to_bar(depth, dive), gasmix, time_stepsize, ccpo2, divemode, loading ? prefs.bottomsac : prefs.decosac);
+		ceiling = deco_allowed_depth(tissue_tolerance_calc(&trial, dive, depth_to_bar(depth, dive)), surface_pressure, dive, 1);
+		if (loading ? ceiling > limit_depth : ceiling <= limit_depth) {
+			*ds = trial;
+			return steps;
+		}
+	}
+	return max_steps + 1;
+}
+
+/*
+ * The number of time steps at the constant depth, at least one, until the ceiling crosses limit_depth.
+ * The tissues after n steps follow from a single segment of n steps. Therefore, instead of adding one
+ * step after another, the first crossing is bracketed around the estimate and then bisected.
+ * This needs a ceiling that moves in one direction only. Otherwise, as after a switch from trimix to
+ * nitrox, the steps are added one after the other.
+ * Returns max_steps + 1 if the ceiling doesn't cross within max_steps. Otherwise, ds is advanced by
+ * the returned number of steps.
+ */
+static int steps_to_ceiling_crossing(struct deco_state *ds, const struct dive *dive, int depth, int time_stepsize, int limit_depth, bool loading,
+				     struct gasmix gasmix, int ccpo2, enum divemode_t divemode, double surface_pressure, int estimate, int max_steps)
+{
+	struct deco_state trial, crossed;
+	int lower = 0, upper, step = 1;
+
+	if (max_steps < 1)
+		return max_steps + 1;
+	if (!ceiling_is_monotonic(ds, depth_to_bar(depth, dive), gasmix, ccpo2, divemode))
+		return scan_steps_to_ceiling_crossing(ds, dive, depth, time_stepsize, limit_depth, loading, gasmix, ccpo2, divemode,
+						      surface_pressure, max_steps);
+	estimate = MIN(MAX(estimate, 1), max_steps);
+	if (ceiling_crossed_after(ds, &crossed, dive, depth, estimate, time_stepsize, limit_depth, loading, gasmix, ccpo2, divemode, surface_pressure)) {
+		upper = estimate;
+		while (upper - step > lower) {
+			if (!ceiling_crossed_after(ds, &trial, dive, depth, upper - step, time_stepsize, limit_depth, loading, gasmix, ccpo2, divemode, surface_pressure)) {
+				lower = upper - step;
+				break;
+			}
+			upper -= step;
+			crossed = trial;
+			step *= 2;
+		}
+	} else {
+		lower = estimate;
+		for (;;) {
+			if (lower == max_steps)
+				return max_steps + 1;
+			upper = MIN(lower + step, max_steps);
+			if (ceiling_crossed_after(ds, &crossed, dive, depth, upper, time_stepsize, limit_depth, loading, gasmix, ccpo2, divemode, surface_pressure))
+				break;
+			lower = upper;
+			step *= 2;
+		}
+	}
+	while (upper - lower > 1) {
+		int middle = (lower + upper) / 2;
+		if (ceiling_crossed_after(ds, &trial, dive, depth, middle, time_stepsize, limit_depth, loading, gasmix, ccpo2, divemode, surface_pressure)) {
+			upper = middle;
+			crossed = trial;
+		} else {
+			lower = middle;
+		}
+	}
+	*ds = crossed;
+	return upper;
+}
+
+/* The estimated number of steps to the ceiling crossing from the M-values, or the hint in VPM-B mode */
+static int estimate_steps_to_ceiling_crossing(const struct deco_state *ds, const struct dive *dive, int depth, int time_stepsize, int limit_depth, bool loading,
+					      struct gasmix gasmix, int ccpo2, enum divemode_t divemode, int hint, int max_steps)
+{
+	double limit_pressure = depth_to_bar(limit_depth, dive);
+	double time = ceiling_crossing_time(ds, dive, depth_to_bar(depth, dive), gasmix, ccpo2, divemode, limit_pressure,
+					    loading, (max_steps + 1) * time_stepsize);
+
+	if (time < 0.0)
+		return hint;
+	return (int)ceil(time / time_stepsize);
+}
+
 /* calculate DECO STOP / TTS / NDL */
-static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, struct plot_data *entry, struct gasmix gasmix, double surface_pressure,enum divemode_t divemode)
+static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, struct plot_data *entry, struct gasmix gasmix, double surface_pressure,
+			      enum divemode_t divemode, struct ndl_tts_hint *hint)
 {
 	/* should this be configurable? */
 	/* ascent speed up to first deco stop */
@@ -962,25 +1117,30 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 					 surface_pressure, dive, 1), deco_stepsize);
 	int ascent_depth = entry->depth;
 	/* at what time should we give up and say that we got enuff NDL? */
-	/* If iterating through a dive, entry->tts_calc needs to be reset */
+	/* If iterating through a dive, the results of the previous iteration need to be reset */
 	entry->tts_calc = 0;
+	entry->ndl_calc = 0;
+	entry->in_deco_calc = false;
+	entry->stoptime_calc = 0;
+	entry->stopdepth_calc = 0;
 
 	/* If we don't have a ceiling yet, calculate ndl. Don't try to calculate
 	 * a ndl for lower values than 3m it would take forever */
 	if (next_stop == 0) {
+		const int max_steps = MAX_PROFILE_DECO / time_stepsize;
+		int estimate, steps;
+
 		if (entry->depth < 3000) {
 			entry->ndl = MAX_PROFILE_DECO;
 			return;
 		}
 		/* stop if the ndl is above max_ndl seconds, and call it plenty of time */
-		while (entry->ndl_calc < MAX_PROFILE_DECO &&
-		       deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)),
-					  surface_pressure, dive, 1) <= 0
-		       ) {
-			entry->ndl_calc += time_stepsize;
-			add_segment(ds, depth_to_bar(entry->depth, dive),
-				    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.bottomsac);
-		}
+		estimate = estimate_steps_to_ceiling_crossing(ds, dive, entry->depth, time_stepsize, 0, true, gasmix, entry->o2pressure.mbar, divemode,
+							      hint->ndl_steps, max_steps);
+		steps = steps_to_ceiling_crossing(ds, dive, entry->depth, time_stepsize, 0, true, gasmix, entry->o2pressure.mbar, divemode,
+						  surface_pressure, estimate, max_steps);
+		hint->ndl_steps = steps;
+		entry->ndl_calc = MIN(steps, max_steps) * time_stepsize;
 		/* we don't need to calculate anything else */
 		return;
 	}
@@ -1004,37 +1164,77 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 
 	/* And how long is the total TTS */
 	while (next_stop >= 0) {
+		/* the stop ends when the ceiling is at the next stop, or gives up after MAX_PROFILE_DECO */
+		int max_steps = MAX(MAX_PROFILE_DECO - entry->tts_calc, 0) / time_stepsize;
+		int *stop_hint = stop_steps_hint(hint, ascent_depth / deco_stepsize);
+		int estimate = estimate_steps_to_ceiling_crossing(ds, dive, ascent_depth, time_stepsize, next_stop, false, gasmix, entry->o2pressure.mbar,
+								  divemode, *stop_hint, max_steps);
+		int steps = steps_to_ceiling_crossing(ds, dive, ascent_depth, time_stepsize, next_stop, false, gasmix, entry->o2pressure.mbar, divemode,
+						      surface_pressure, estimate, max_steps);
+
 		/* save the time for the first stop to show in the graph */
 		if (ascent_depth == entry->stopdepth_calc)
-			entry->stoptime_calc += time_stepsize;
-
-		entry->tts_calc += time_stepsize;
-		if (entry->tts_calc > MAX_PROFILE_DECO)
+			entry->stoptime_calc += steps * time_stepsize;
+		entry->tts_calc += steps * time_stepsize;
+		if (steps > max_steps)
 			break;
-		add_segment(ds, depth_to_bar(ascent_depth, dive),
-			    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.decosac);
-
-		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth,dive)), surface_pressure, dive, 1) <= next_stop) {
-			/* move to the next stop and add the travel between stops */
-			for (; ascent_depth > next_stop; ascent_depth -= ascent_s_per_deco_step * ascent_velocity(ascent_depth, entry->running_sum / entry->sec, 0), entry->tts_calc += ascent_s_per_deco_step)
-				add_segment(ds, depth_to_bar(ascent_depth, dive),
-					    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, divemode, prefs.decosac);
-			ascent_depth = next_stop;
-			next_stop -= deco_stepsize;
-		}
+		*stop_hint = steps;
+
+		/* move to the next stop and add the travel between stops */
+		for (; ascent_depth > next_stop; ascent_depth -= ascent_s_per_deco_step * ascent_velocity(ascent_depth, entry->running_sum / entry->sec, 0), entry->tts_calc += ascent_s_per_deco_step)
+			add_segment(ds, depth_to_bar(ascent_depth, dive),
+				    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, divemode, prefs.decosac);
+		ascent_depth = next_stop;
+		next_stop -= deco_stepsize;
+	}
+}
+
+/* The inert gas loadings of the compartments at a plot entry. They don't depend on the
+ * VPM-B gradients, so the CVA iterations take them from the first pass over the plot. */
+struct tissue_loading {
+	double n2[16];
+	double he[16];
+};
+
+static void save_tissue_loading(const struct deco_state *ds, struct tissue_loading *loading)
+{
+	memcpy(loading->n2, ds->tissue_n2_sat, sizeof(loading->n2));
+	memcpy(loading->he, ds->tissue_he_sat, sizeof(loading->he));
+}
+
+static void restore_tissue_loading(struct deco_state *ds, const struct tissue_loading *loading)
+{
+	int ci;
+
+	for (ci = 0; ci < 16; ci++) {
+		ds->tissue_n2_sat[ci] = loading->n2[ci];
+		ds->tissue_he_sat[ci] = loading->he[ci];
+		ds->tissue_inertgas_saturation[ci] = loading->n2[ci] + loading->he[ci];
 	}
 }
 
 /* Let's try to do some deco calculations.
+ * If cancelled is not NULL, it is polled for every plot entry and the calculation is abandoned
+ * as soon as it returns true. Returns false in that case; the deco data are then incomplete.
  */
-void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_ds, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode)
+bool calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_ds, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode,
+				bool (*cancelled)(void *), void *cancel_data)
 {
 	int i, count_iteration = 0;
+	bool aborted = false;
 	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
 	bool first_iteration = true;
 	int prev_deco_time = 10000000, time_deep_ceiling = 0;
-
-	if (!in_planner() || !planner_ds) {
+	bool cva = ds->config.mode == VPMB && !ds->config.planner;
+	bool replay = false, checkpoint_first_iteration = true;
+	int checkpoint_time_deep_ceiling = 0;
+	struct deco_state *checkpoint = NULL, *end_of_first_pass = NULL;
+	struct tissue_loading *loadings = NULL;
+	struct ndl_tts_hint hint = { 0 };
+
+	if (!pi->deco)
+		pi->deco = calloc(pi->nr, sizeof(*pi->deco));
+	if (!ds->config.planner || !planner_ds) {
 		ds->deco_time = 0;
 		ds->first_ceiling_pressure.mbar = 0;
 	} else {
@@ -1042,17 +1242,29 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
 	}
 	struct deco_state *cache_data_initial = NULL;
-	lock_planner();
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
-	if (decoMode() == VPMB) {
+	if (ds->config.mode == VPMB) {
 		cache_deco_state(ds, &cache_data_initial);
 	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
-	 * Set maximum number of iterations to 10 just in case */
-
-	while ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10)) {
+	 * Set maximum number of iterations to 10 just in case.
+	 * Only the TTS of the last data point is needed for the CVA calculation and the NDL/TTS of the other
+	 * data points are overwritten by the next iteration. Therefore, the iterations skip them and the
+	 * converged iteration is replayed from its checkpoint to calculate them.
+	 * Only the gradients change between the iterations, not the tissue loadings. Therefore, only the
+	 * first pass adds the segments. The following passes, including the replay, take the loadings of
+	 * every entry from it and only re-evaluate the ceilings and the NDL/TTS. */
+	if (cva)
+		loadings = malloc(pi->nr * sizeof(*loadings));
+
+	while (replay || ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10))) {
 		int last_ndl_tts_calc_time = 0, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
-		if (decoMode() == VPMB)
+		if (cva && prefs.calcndltts && !print_mode && !replay) {
+			cache_deco_state(ds, &checkpoint);
+			checkpoint_time_deep_ceiling = time_deep_ceiling;
+			checkpoint_first_iteration = first_iteration;
+		}
+		if (ds->config.mode == VPMB)
 			ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
 		struct gasmix gasmix = gasmix_invalid;
 		const struct event *ev = NULL, *evd = NULL;
@@ -1060,38 +1272,44 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 
 		for (i = 1; i < pi->nr; i++) {
 			struct plot_data *entry = pi->entry + i;
+			struct plot_deco_data *deco = pi->deco + i;
 			int j, t0 = (entry - 1)->sec, t1 = entry->sec;
-			int time_stepsize = 20;
+
+			if (cancelled && cancelled(cancel_data)) {
+				aborted = true;
+				break;
+			}
 
 			current_divemode = get_current_divemode(dc, entry->sec, &evd, &current_divemode);
 			gasmix = get_gasmix(dive, dc, t1, &ev, gasmix);
-			entry->ambpressure = depth_to_bar(entry->depth, dive);
-			entry->gfline = get_gf(ds, entry->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
+			deco->ambpressure = depth_to_bar(entry->depth, dive);
+			deco->gfline = get_gf(ds, deco->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
 			if (t0 > t1) {
 				fprintf(stderr, "non-monotonous dive stamps %d %d\n", t0, t1);
 				int xchg = t1;
 				t1 = t0;
 				t0 = xchg;
 			}
-			if (t0 != t1 && t1 - t0 < time_stepsize)
-				time_stepsize = t1 - t0;
-			for (j = t0 + time_stepsize; j <= t1; j += time_stepsize) {
-				int depth = interpolate(entry[-1].depth, entry[0].depth, j - t0, t1 - t0);
-				add_segment(ds, depth_to_bar(depth, dive),
-					    gasmix, time_stepsize, entry->o2pressure.mbar, current_divemode, entry->sac);
-				entry->icd_warning = ds->icd_warning;
-				if ((t1 - j < time_stepsize) && (j < t1))
-					time_stepsize = t1 - j;
+			if (loadings && !first_iteration) {
+				restore_tissue_loading(ds, loadings + i);
+			} else {
+				if (t0 != t1) {
+					add_segment_linear(ds, depth_to_bar(entry[-1].depth, dive), deco->ambpressure,
+							   gasmix, t1 - t0, entry->o2pressure.mbar, current_divemode, entry->sac);
+					entry->icd_warning = ds->icd_warning;
+				}
+				if (loadings)
+					save_tissue_loading(ds, loadings + i);
 			}
 			if (t0 == t1) {
 				entry->ceiling = (entry - 1)->ceiling;
 			} else {
 				/* Keep updating the VPM-B gradients until the start of the ascent phase of the dive. */
-				if (decoMode() == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
+				if (ds->config.mode == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
 					nuclear_regeneration(ds, t1);
 					vpmb_start_gradient(ds);
 					/* For CVA iterations, calculate next gradient */
-					if (!first_iteration || in_planner())
+					if (!first_iteration || ds->config.planner)
 						vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 				}
 				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
@@ -1101,7 +1319,7 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 					current_ceiling = entry->ceiling;
 				last_ceiling = current_ceiling;
 				/* If using VPM-B, take first_ceiling_pressure as the deepest ceiling */
-				if (decoMode() == VPMB) {
+				if (ds->config.mode == VPMB) {
 					if  (current_ceiling >= first_ceiling ||
 					     (time_deep_ceiling == t0 && entry->depth == (entry - 1)->depth)) {
 						time_deep_ceiling = t1;
@@ -1113,7 +1331,7 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 							/* For CVA calculations, deco time = dive time remaining is a good guess,
 							   but we want to over-estimate deco_time for the first iteration so it
 							   converges correctly, so add 30min*/
-							if (!in_planner())
+							if (!ds->config.planner)
 								ds->deco_time = pi->maxtime - t1 + 1800;
 							vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 						}
@@ -1125,29 +1343,30 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 						time_clear_ceiling = t1;
 				}
 			}
-			entry->surface_gf = 0.0;
-			entry->current_gf = 0.0;
+			deco->surface_gf = 0.0;
+			deco->current_gf = 0.0;
 			for (j = 0; j < 16; j++) {
-				double m_value = ds->buehlmann_inertgas_a[j] + entry->ambpressure / ds->buehlmann_inertgas_b[j];
+				double m_value = ds->buehlmann_inertgas_a[j] + deco->ambpressure / ds->buehlmann_inertgas_b[j];
 				double surface_m_value = ds->buehlmann_inertgas_a[j] + surface_pressure / ds->buehlmann_inertgas_b[j];
-				entry->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
-				double current_gf = (ds->tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure);
-				entry->percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
-					lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
+				deco->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
+				double current_gf = (ds->tissue_inertgas_saturation[j] - deco->ambpressure) / (m_value - deco->ambpressure);
+				deco->percentages[j] = ds->tissue_inertgas_saturation[j] < deco->ambpressure ?
+					lrint(ds->tissue_inertgas_saturation[j] / deco->ambpressure * AMB_PERCENTAGE) :
 					lrint(AMB_PERCENTAGE + current_gf * (100.0 - AMB_PERCENTAGE));
-				if (current_gf > entry->current_gf)
-					entry->current_gf = current_gf;
+				if (current_gf > deco->current_gf)
+					deco->current_gf = current_gf;
 				double surface_gf = 100.0 * (ds->tissue_inertgas_saturation[j] - surface_pressure) / (surface_m_value - surface_pressure);
-				if (surface_gf > entry->surface_gf)
-					entry->surface_gf = surface_gf;
+				if (surface_gf > deco->surface_gf)
+					deco->surface_gf = surface_gf;
 			}
 
 			/* should we do more calculations?
 			* We don't for print-mode because this info doesn't show up there
 			* If the ceiling hasn't cleared by the last data point, we need tts for VPM-B CVA calculation
-			* It is not necessary to do these calculation on the first VPMB iteration, except for the last data point */
-			if ((prefs.calcndltts && !print_mode && (decoMode() != VPMB || in_planner() || !first_iteration)) ||
-			    (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)) {
+			* It is not necessary to do these calculation on the VPMB iterations, except for the last data point,
+			* only on the replay of the converged iteration */
+			if ((prefs.calcndltts && !print_mode && (!cva || replay)) ||
+			    (cva && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
 					struct plot_data *prev_entry = (entry - 1);
@@ -1162,16 +1381,27 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 				/* We are going to mess up deco state, so store it for later restore */
 				struct deco_state *cache_data = NULL;
 				cache_deco_state(ds, &cache_data);
-				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode);
-				if (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)
+				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode, &hint);
+				if (cva && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				restore_deco_state(cache_data, ds, decoMode() == VPMB);
+				restore_deco_state(cache_data, ds, ds->config.mode == VPMB);
 				free(cache_data);
 			}
 		}
-		if (decoMode() == VPMB && !in_planner()) {
+		if (aborted)
+			break;
+		if (cva) {
 			int this_deco_time;
+			/* The next gradients depend on the tissues at the end of the dive, which the passes
+			 * after the first one only know the loadings of. Take the rest from the first pass. */
+			if (first_iteration) {
+				cache_deco_state(ds, &end_of_first_pass);
+			} else {
+				this_deco_time = ds->deco_time;
+				restore_deco_state(end_of_first_pass, ds, true);
+				ds->deco_time = this_deco_time;
+			}
 			prev_deco_time = ds->deco_time;
 			// Do we need to update deco_time?
 			if (final_tts > 0)
@@ -1191,6 +1421,15 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 			this_deco_time = ds->deco_time;
 			restore_deco_state(cache_data_initial, ds, true);
 			ds->deco_time = this_deco_time;
+			/* The replay ends in the same state as the iteration it repeats */
+			if (replay)
+				break;
+			if (checkpoint && !checkpoint_first_iteration &&
+			    (abs(prev_deco_time - ds->deco_time) < 30 || count_iteration >= 10)) {
+				restore_deco_state(checkpoint, ds, false);
+				time_deep_ceiling = checkpoint_time_deep_ceiling;
+				replay = true;
+			}
 		} else {
 			// With Buhlmann iterating isn't needed.  This makes the while condition false.
 			prev_deco_time = ds->deco_time = 0;
@@ -1198,10 +1437,14 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 	}
 
 	free(cache_data_initial);
+	free(checkpoint);
+	free(end_of_first_pass);
+	free(loadings);
+	free_ndl_tts_hint(&hint);
 #if DECO_CALC_DEBUG & 1
 	dump_tissues(ds);
 #endif
-	unlock_planner();
+	return !aborted;
 }
 #endif
 
@@ -1256,9 +1499,12 @@ static void calculate_gas_information_new(struct dive *dive, struct divecomputer
 	const struct event *evg = NULL, *evd = NULL;
 	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
 
+	if (!pi->gas)
+		pi->gas = calloc(pi->nr, sizeof(*pi->gas));
 	for (i = 1; i < pi->nr; i++) {
 		int fn2, fhe;
 		struct plot_data *entry = pi->entry + i;
+		struct plot_gas_data *gas = pi->gas + i;
 
 		gasmix = get_gasmix(dive, dc, entry->sec, &evg, gasmix);
 		amb_pressure = depth_to_bar(entry->depth, dive);
@@ -1276,23 +1522,23 @@ static void calculate_gas_information_new(struct dive *dive, struct divecomputer
 		 * END takes O₂ + N₂ (air) into account ("Narcotic" for trimix dives)
 		 * EAD just uses N₂ ("Air" for nitrox dives) */
 		pressure_t modpO2 = { .mbar = (int)(prefs.modpO2 * 1000) };
-		entry->mod = (double)gas_mod(gasmix, modpO2, dive, 1).mm;
-		entry->end = (entry->depth + 10000) * (1000 - fhe) / 1000.0 - 10000;
-		entry->ead = (entry->depth + 10000) * fn2 / (double)N2_IN_AIR - 10000;
-		entry->eadd = (entry->depth + 10000) *
+		gas->mod = (double)gas_mod(gasmix, modpO2, dive, 1).mm;
+		gas->end = (entry->depth + 10000) * (1000 - fhe) / 1000.0 - 10000;
+		gas->ead = (entry->depth + 10000) * fn2 / (double)N2_IN_AIR - 10000;
+		gas->eadd = (entry->depth + 10000) *
 				      (entry->pressures.o2 / amb_pressure * O2_DENSITY +
 				       entry->pressures.n2 / amb_pressure * N2_DENSITY +
 				       entry->pressures.he / amb_pressure * HE_DENSITY) /
 				      (O2_IN_AIR * O2_DENSITY + N2_IN_AIR * N2_DENSITY) * 1000 - 10000;
-		entry->density = gas_density(gasmix, depth_to_mbar(entry->depth, dive));
-		if (entry->mod < 0)
-			entry->mod = 0;
-		if (entry->ead < 0)
-			entry->ead = 0;
-		if (entry->end < 0)
-			entry->end = 0;
-		if (entry->eadd < 0)
-			entry->eadd = 0;
+		gas->density = gas_density(gasmix, depth_to_mbar(entry->depth, dive));
+		if (gas->mod < 0)
+			gas->mod = 0;
+		if (gas->ead < 0)
+			gas->ead = 0;
+		if (gas->end < 0)
+			gas->end = 0;
+		if (gas->eadd < 0)
+			gas->eadd = 0;
 	}
 }
 
@@ -1335,7 +1581,7 @@ void fill_o2_values(struct dive *dive, struct divecomputer *dc, struct plot_info
 
 #ifdef DEBUG_GAS
 /* A CCR debug function that writes the cylinder pressure and the oxygen values to the file debug_print_profiledata.dat:
- * Called in create_plot_info_new()
+ * Called in plot_info_need()
  */
 static void debug_print_profiledata(struct plot_info *pi)
 {
@@ -1365,6 +1611,83 @@ void init_plot_info(struct plot_info *pi)
 	memset(pi, 0, sizeof(*pi));
 }
 
+/*
+ * Calculate the requested derived data of a plot info that have not yet
+ * been calculated. The dive and dive computer the plot info was created
+ * from must still exist.
+ */
+void plot_info_need(struct plot_info *pi, unsigned int channels)
+{
+	plot_info_need_from_tissues(pi, channels, NULL, NULL, NULL);
+}
+
+/*
+ * Same as plot_info_need(), but if initial_ds is not NULL, the deco
+ * calculation starts from these tissues instead of replaying the
+ * preceding dives. Then, only the dive of the plot info is accessed,
+ * which makes it possible to calculate a copy of a dive in a worker
+ * thread. Such a calculation can be abandoned with the cancelled
+ * callback, see calculate_deco_information(). The deco channel then
+ * remains uncalculated.
+ */
+void plot_info_need_from_tissues(struct plot_info *pi, unsigned int channels, const struct deco_state *initial_ds,
+				 bool (*cancelled)(void *), void *cancel_data)
+{
+	struct dive *dive = pi->dive;
+	struct divecomputer *dc = pi->dc;
+	struct event_lookups lookups;
+
+	/* The deco calculation uses the SAC rate, which is calculated from the cylinder pressures */
+	if (channels & PLOT_DECO)
+		channels |= PLOT_SAC;
+
+	/* Without the interpolated pressures, the SAC rate (and therefore
+	 * the deco) was calculated from the sensor pressures only. */
+	if ((channels & PLOT_PRESSURE) && !(pi->channels & PLOT_PRESSURE) && (pi->channels & PLOT_SAC)) {
+		channels |= pi->channels & (PLOT_SAC | PLOT_DECO);
+		pi->channels &= ~(PLOT_SAC | PLOT_DECO);
+	}
+
+	channels &= ~pi->channels;
+	if (!channels || !pi->entry)
+		return;
+
+	/* The calculations below look up the gas and the dive mode of every entry */
+	begin_event_lookups(&lookups, dc);
+	if (channels & PLOT_PRESSURE)
+		populate_pressure_information(dive, dc, pi);
+	if (channels & PLOT_SAC)
+		calculate_sac(dive, dc, pi);
+#ifndef SUBSURFACE_MOBILE
+	if (channels & PLOT_DECO) {
+		struct deco_state plot_deco_state;
+		if (initial_ds) {
+			plot_deco_state = *initial_ds;
+		} else {
+			init_deco_config(&plot_deco_state.config, in_planner());
+			init_decompression(&plot_deco_state, dive);
+		}
+		/* and ceiling information, using gradient factor values in Preferences) */
+		if (!calculate_deco_information(&plot_deco_state, pi->planner_ds, dive, dc, pi, false, cancelled, cancel_data))
+			channels &= ~PLOT_DECO;
+	}
+#else
+	UNUSED(initial_ds);
+	UNUSED(cancelled);
+	UNUSED(cancel_data);
+#endif
+	if (channels & PLOT_GAS)
+		calculate_gas_information_new(dive, dc, pi);	 /* Calculate gas partial pressures */
+
+	end_event_lookups(&lookups);
+
+#ifdef DEBUG_GAS
+	debug_print_profiledata(pi);
+#endif
+
+	pi->channels |= channels;
+}
+
 /*
  * Create a plot-info with smoothing and ranged min/max
  *
@@ -1372,18 +1695,17 @@ void init_plot_info(struct plot_info *pi)
  * sides, so that you can do end-points without having to worry
  * about it.
  *
+ * Of the derived data, only the requested channels are calculated.
+ * Further channels can be calculated with plot_info_need() as long
+ * as the dive exists.
+ *
  * The old data will be freed. Before the first call, the plot
  * info must be initialized with init_plot_info().
  */
-void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds)
+void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, unsigned int channels, const struct deco_state *planner_ds)
 {
 	int o2, he, o2max;
-#ifndef SUBSURFACE_MOBILE
-	struct deco_state plot_deco_state;
-	init_decompression(&plot_deco_state, dive);
-#else
-	UNUSED(planner_ds);
-#endif
+
 	free_plot_info_data(pi);
 	calculate_max_limits_new(dive, dc, pi);
 	get_dive_gas(dive, &o2, &he, &o2max);
@@ -1402,23 +1724,15 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 
 	check_setpoint_events(dive, dc, pi);     /* Populate setpoints */
 	setup_gas_sensor_pressure(dive, dc, pi); /* Try to populate our gas pressure knowledge */
-	if (!fast) {
-		for (int cyl = 0; cyl < pi->nr_cylinders; cyl++)
-			populate_pressure_information(dive, dc, pi, cyl);
-	}
 	fill_o2_values(dive, dc, pi);			 /* .. and insert the O2 sensor data having 0 values. */
-	calculate_sac(dive, dc, pi);			 /* Calculate sac */
-#ifndef SUBSURFACE_MOBILE
-	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
-#endif
-	calculate_gas_information_new(dive, dc, pi);	 /* Calculate gas partial pressures */
-
-#ifdef DEBUG_GAS
-	debug_print_profiledata(pi);
-#endif
 
 	pi->meandepth = dive->dc.meandepth.mm;
 	analyze_plot_info(pi);
+
+	pi->dive = dive;
+	pi->dc = dc;
+	pi->planner_ds = planner_ds;
+	plot_info_need(pi, channels);
 }
 
 struct divecomputer *select_dc(struct dive *dive)
@@ -1441,6 +1755,8 @@ static void plot_string(struct plot_info *pi, int idx, struct membuffer *b)
 	int decimals, cyl;
 	const char *unit;
 	struct plot_data *entry = pi->entry + idx;
+	const struct plot_deco_data *deco = get_plot_deco_data(pi, idx);
+	const struct plot_gas_data *gas = get_plot_gas_data(pi, idx);
 
 	depthvalue = get_depth_units(entry->depth, NULL, &depth_unit);
 	put_format_loc(b, translate("gettextFromC", "@: %d:%02d\nD: %.1f%s\n"), FRACTION(entry->sec, 60), depthvalue, depth_unit);
@@ -1475,29 +1791,29 @@ static void plot_string(struct plot_info *pi, int idx, struct membuffer *b)
 		put_format_loc(b, translate("gettextFromC", "pN₂: %.2fbar\n"), entry->pressures.n2);
 	if (prefs.pp_graphs.phe && entry->pressures.he > 0)
 		put_format_loc(b, translate("gettextFromC", "pHe: %.2fbar\n"), entry->pressures.he);
-	if (prefs.mod && entry->mod > 0) {
-		mod = lrint(get_depth_units(lrint(entry->mod), NULL, &depth_unit));
+	if (prefs.mod && gas->mod > 0) {
+		mod = lrint(get_depth_units(lrint(gas->mod), NULL, &depth_unit));
 		put_format_loc(b, translate("gettextFromC", "MOD: %d%s\n"), mod, depth_unit);
 	}
-	eadd = lrint(get_depth_units(lrint(entry->eadd), NULL, &depth_unit));
+	eadd = lrint(get_depth_units(lrint(gas->eadd), NULL, &depth_unit));
 
 	if (prefs.ead) {
 		switch (pi->dive_type) {
 		case NITROX:
-			if (entry->ead > 0) {
-				ead = lrint(get_depth_units(lrint(entry->ead), NULL, &depth_unit));
-				put_format_loc(b, translate("gettextFromC", "EAD: %d%s\nEADD: %d%s / %.1fg/ℓ\n"), ead, depth_unit, eadd, depth_unit, entry->density);
+			if (gas->ead > 0) {
+				ead = lrint(get_depth_units(lrint(gas->ead), NULL, &depth_unit));
+				put_format_loc(b, translate("gettextFromC", "EAD: %d%s\nEADD: %d%s / %.1fg/ℓ\n"), ead, depth_unit, eadd, depth_unit, gas->density);
 				break;
 			}
 		case TRIMIX:
-			if (entry->end > 0) {
-				end = lrint(get_depth_units(lrint(entry->end), NULL, &depth_unit));
-				put_format_loc(b, translate("gettextFromC", "END: %d%s\nEADD: %d%s / %.1fg/ℓ\n"), end, depth_unit, eadd, depth_unit, entry->density);
+			if (gas->end > 0) {
+				end = lrint(get_depth_units(lrint(gas->end), NULL, &depth_unit));
+				put_format_loc(b, translate("gettextFromC", "END: %d%s\nEADD: %d%s / %.1fg/ℓ\n"), end, depth_unit, eadd, depth_unit, gas->density);
 				break;
 			}
 		case AIR:
-			if (entry->density > 0) {
-				put_format_loc(b, translate("gettextFromC", "Density: %.1fg/ℓ\n"), entry->density);
+			if (gas->density > 0) {
+				put_format_loc(b, translate("gettextFromC", "Density: %.1fg/ℓ\n"), gas->density);
 			}
 		case FREEDIVING:
 			/* nothing */
@@ -1556,18 +1872,18 @@ static void plot_string(struct plot_info *pi, int idx, struct membuffer *b)
 	if (entry->rbt)
 		put_format_loc(b, translate("gettextFromC", "RBT: %umin\n"), DIV_UP(entry->rbt, 60));
 	if (prefs.decoinfo) {
-		if (entry->current_gf > 0.0)
-			put_format(b, translate("gettextFromC", "GF %d%%\n"), (int)(100.0 * entry->current_gf));
-		if (entry->surface_gf > 0.0)
-			put_format(b, translate("gettextFromC", "Surface GF %.0f%%\n"), entry->surface_gf);
+		if (deco->current_gf > 0.0)
+			put_format(b, translate("gettextFromC", "GF %d%%\n"), (int)(100.0 * deco->current_gf));
+		if (deco->surface_gf > 0.0)
+			put_format(b, translate("gettextFromC", "Surface GF %.0f%%\n"), deco->surface_gf);
 		if (entry->ceiling) {
 			depthvalue = get_depth_units(entry->ceiling, NULL, &depth_unit);
 			put_format_loc(b, translate("gettextFromC", "Calculated ceiling %.0f%s\n"), depthvalue, depth_unit);
 			if (prefs.calcalltissues) {
 				int k;
 				for (k = 0; k < 16; k++) {
-					if (entry->ceilings[k]) {
-						depthvalue = get_depth_units(entry->ceilings[k], NULL, &depth_unit);
+					if (deco->ceilings[k]) {
+						depthvalue = get_depth_units(deco->ceilings[k], NULL, &depth_unit);
 						put_format_loc(b, translate("gettextFromC", "Tissue %.0fmin: %.1f%s\n"), buehlmann_N2_t_halflife[k], depthvalue, depth_unit);
 					}
 				}
@@ -23,6 +23,19 @@ enum plot_pressure {
 	NUM_PLOT_PRESSURES = 2
 };
 
+/*
+ * The derived data of the plot entries. These are only calculated when
+ * requested, either when creating the plot info or later with
+ * plot_info_need(), and then kept until the plot info is freed.
+ */
+enum plot_channel {
+	PLOT_PRESSURE = 1 << 0,	/* interpolated cylinder pressures */
+	PLOT_SAC = 1 << 1,	/* SAC rate */
+	PLOT_DECO = 1 << 2,	/* ceilings, tissue saturation, GF and calculated NDL/TTS */
+	PLOT_GAS = 1 << 3	/* partial pressures, MOD, EAD, END, EADD and gas density */
+};
+#define PLOT_ALL (PLOT_PRESSURE | PLOT_SAC | PLOT_DECO | PLOT_GAS)
+
 struct membuffer;
 struct deco_state;
 struct divecomputer;
@@ -35,15 +48,21 @@ struct plot_pressure_data {
 	int data[NUM_PLOT_PRESSURES];
 };
 
+/*
+ * The per-entry data of the plot info. The deco and gas data that are only
+ * needed by some graphs and the export are kept in separate arrays, see
+ * get_plot_deco_data() and get_plot_gas_data().
+ */
 struct plot_data {
 	unsigned int in_deco : 1;
+	/* values calculated by us */
+	unsigned int in_deco_calc : 1;
+	unsigned int icd_warning : 1;
 	int sec;
 	int temperature;
 	/* Depth info */
 	int depth;
 	int ceiling;
-	int ceilings[16];
-	int percentages[16];
 	int ndl;
 	int tts;
 	int rbt;
@@ -58,13 +77,10 @@ struct plot_data {
 	pressure_t o2sensor[3]; //for rebreathers with up to 3 PO2 sensors
 	pressure_t o2setpoint;
 	pressure_t scr_OC_pO2;
-	double mod, ead, end, eadd;
 	velocity_t velocity;
 	int speed;
 	// stats over 9 minute window:
 	int min, max;	// indices into pi->entry[]
-	/* values calculated by us */
-	unsigned int in_deco_calc : 1;
 	int ndl_calc;
 	int tts_calc;
 	int stoptime_calc;
@@ -72,12 +88,22 @@ struct plot_data {
 	int pressure_time;
 	int heartbeat;
 	int bearing;
+};
+
+/* Filled in by the deco calculation (PLOT_DECO) */
+struct plot_deco_data {
+	int ceilings[16];
+	int percentages[16];
 	double ambpressure;
 	double gfline;
 	double surface_gf;
 	double current_gf;
+};
+
+/* Filled in by the gas calculation (PLOT_GAS) */
+struct plot_gas_data {
+	double mod, ead, end, eadd;
 	double density;
-	bool icd_warning;
 };
 
 struct ev_select {
@@ -88,10 +114,15 @@ struct ev_select {
 extern void compare_samples(struct plot_info *p1, int idx1, int idx2, char *buf, int bufsize, bool sum);
 extern struct plot_info *analyze_plot_info(struct plot_info *pi);
 extern void init_plot_info(struct plot_info *pi);
-extern void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds);
-extern void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_de, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+extern void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, unsigned int channels, const struct deco_state *planner_ds);
+extern void plot_info_need(struct plot_info *pi, unsigned int channels);
+extern void plot_info_need_from_tissues(struct plot_info *pi, unsigned int channels, const struct deco_state *initial_ds,
+					bool (*cancelled)(void *), void *cancel_data);
+extern bool calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_de, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode,
+				       bool (*cancelled)(void *), void *cancel_data);
 extern int get_plot_details_new(struct plot_info *pi, int time, struct membuffer *);
 extern void free_plot_info_data(struct plot_info *pi);
+extern void copy_plot_info_data(struct plot_info *dst, const struct plot_info *src);
 
 /*
  * When showing dive profiles, we scale things to the
@@ -134,6 +165,19 @@ static inline int get_plot_pressure(const struct plot_info *pi, int idx, int cyl
 	return res ? res : get_plot_interpolated_pressure(pi, idx, cylinder);
 }
 
+/* The deco and gas data of an entry. All zero if they were not calculated. */
+static inline const struct plot_deco_data *get_plot_deco_data(const struct plot_info *pi, int idx)
+{
+	static const struct plot_deco_data none = { { 0 } };
+	return pi->deco ? pi->deco + idx : &none;
+}
+
+static inline const struct plot_gas_data *get_plot_gas_data(const struct plot_info *pi, int idx)
+{
+	static const struct plot_gas_data none = { 0 };
+	return pi->gas ? pi->gas + idx : &none;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,7 @@
 #include <QProgressDialog>	// TODO: remove with convertThumbnails()
 #include <cstdarg>
 #include <cstdint>
+#include <vector>
 
 #include <libxslt/documents.h>
 
@@ -1627,6 +1628,28 @@ extern "C" void unlock_planner()
 	planLock.unlock();
 }
 
+namespace {
+	struct ParallelItem {
+		void (*fn)(void *);
+		void *item;
+	};
+}
+
+static void runParallelItem(ParallelItem &item)
+{
+	item.fn(item.item);
+}
+
+// Calls fn for each of the nr items of size item_size in the global thread pool and waits for completion
+extern "C" void run_in_parallel(void (*fn)(void *item), void *items, size_t item_size, int nr)
+{
+	std::vector<ParallelItem> work;
+	work.reserve(nr);
+	for (int i = 0; i < nr; ++i)
+		work.push_back({ fn, static_cast<char *>(items) + i * item_size });
+	QtConcurrent::blockingMap(work, runParallelItem);
+}
+
 char *copy_qstring(const QString &s)
 {
 	return strdup(qPrintable(s));
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0
+/* samplecolumns.c */
+
+#include <stddef.h>
+#include "samplecolumns.h"
+
+/* Description of a channel: position and size of the field in struct sample */
+struct sample_channel_info {
+	size_t offset, size;
+};
+
+#define CHANNEL(field) { offsetof(struct sample, field), sizeof(((struct sample *)0)->field) }
+
+static const struct sample_channel_info channel_info[NUM_SAMPLE_CHANNELS] = {
+	[SAMPLE_CHANNEL_TIME] = CHANNEL(time),
+	[SAMPLE_CHANNEL_STOPTIME] = CHANNEL(stoptime),
+	[SAMPLE_CHANNEL_NDL] = CHANNEL(ndl),
+	[SAMPLE_CHANNEL_TTS] = CHANNEL(tts),
+	[SAMPLE_CHANNEL_RBT] = CHANNEL(rbt),
+	[SAMPLE_CHANNEL_DEPTH] = CHANNEL(depth),
+	[SAMPLE_CHANNEL_STOPDEPTH] = CHANNEL(stopdepth),
+	[SAMPLE_CHANNEL_TEMPERATURE] = CHANNEL(temperature),
+	[SAMPLE_CHANNEL_PRESSURE0] = CHANNEL(pressure[0]),
+	[SAMPLE_CHANNEL_PRESSURE1] = CHANNEL(pressure[1]),
+	[SAMPLE_CHANNEL_SETPOINT] = CHANNEL(setpoint),
+	[SAMPLE_CHANNEL_O2SENSOR0] = CHANNEL(o2sensor[0]),
+	[SAMPLE_CHANNEL_O2SENSOR1] = CHANNEL(o2sensor[1]),
+	[SAMPLE_CHANNEL_O2SENSOR2] = CHANNEL(o2sensor[2]),
+	[SAMPLE_CHANNEL_BEARING] = CHANNEL(bearing),
+	[SAMPLE_CHANNEL_SENSOR0] = CHANNEL(sensor[0]),
+	[SAMPLE_CHANNEL_SENSOR1] = CHANNEL(sensor[1]),
+	[SAMPLE_CHANNEL_CNS] = CHANNEL(cns),
+	[SAMPLE_CHANNEL_HEARTBEAT] = CHANNEL(heartbeat),
+	[SAMPLE_CHANNEL_SAC] = CHANNEL(sac),
+	[SAMPLE_CHANNEL_IN_DECO] = CHANNEL(in_deco),
+	[SAMPLE_CHANNEL_MANUALLY_ENTERED] = CHANNEL(manually_entered)
+};
+
+#undef CHANNEL
+
+/* Constant channels are stored in a uint32_t, so no field of struct sample may be larger */
+#define CHANNEL_FITS(field) _Static_assert(sizeof(((struct sample *)0)->field) <= sizeof(uint32_t), \
+					   "sample field " #field " does not fit into a constant channel")
+CHANNEL_FITS(time);
+CHANNEL_FITS(stoptime);
+CHANNEL_FITS(ndl);
+CHANNEL_FITS(tts);
+CHANNEL_FITS(rbt);
+CHANNEL_FITS(depth);
+CHANNEL_FITS(stopdepth);
+CHANNEL_FITS(temperature);
+CHANNEL_FITS(pressure[0]);
+CHANNEL_FITS(pressure[1]);
+CHANNEL_FITS(setpoint);
+CHANNEL_FITS(o2sensor[0]);
+CHANNEL_FITS(o2sensor[1]);
+CHANNEL_FITS(o2sensor[2]);
+CHANNEL_FITS(bearing);
+CHANNEL_FITS(sensor[0]);
+CHANNEL_FITS(sensor[1]);
+CHANNEL_FITS(cns);
+CHANNEL_FITS(heartbeat);
+CHANNEL_FITS(sac);
+CHANNEL_FITS(in_deco);
+CHANNEL_FITS(manually_entered);
+#undef CHANNEL_FITS
+
+static inline const void *sample_field(const struct sample *s, int channel)
+{
+	return (const char *)s + channel_info[channel].offset;
+}
+
+void pack_sample_columns(struct sample_columns *cols, const struct sample *samples, int nr)
+{
+	int channel, i;
+
+	memset(cols, 0, sizeof(*cols));
+	cols->nr = nr;
+	if (!nr)
+		return;
+
+	for (channel = 0; channel < NUM_SAMPLE_CHANNELS; channel++) {
+		size_t size = channel_info[channel].size;
+		const void *first = sample_field(samples, channel);
+		char *data;
+
+		for (i = 1; i < nr; i++) {
+			if (memcmp(sample_field(samples + i, channel), first, size))
+				break;
+		}
+		if (i == nr) {
+			/* Channel is constant - only remember its value */
+			memcpy(&cols->constant[channel], first, size);
+			continue;
+		}
+
+		data = malloc(nr * size);
+		if (!data)
+			exit(1);
+		for (i = 0; i < nr; i++)
+			memcpy(data + i * size, sample_field(samples + i, channel), size);
+		cols->data[channel] = data;
+	}
+}
+
+static void read_sample(const struct sample_columns *cols, int idx, struct sample *s)
+{
+	int channel;
+
+	memset(s, 0, sizeof(*s));
+	for (channel = 0; channel < NUM_SAMPLE_CHANNELS; channel++) {
+		size_t size = channel_info[channel].size;
+		const void *src = cols->data[channel] ? (const char *)cols->data[channel] + idx * size
+						      : (const void *)&cols->constant[channel];
+		memcpy((char *)s + channel_info[channel].offset, src, size);
+	}
+}
+
+/* Unpack into an array of cols->nr samples provided by the caller */
+void unpack_sample_columns(const struct sample_columns *cols, struct sample *samples)
+{
+	int i;
+	for (i = 0; i < cols->nr; i++)
+		read_sample(cols, i, samples + i);
+}
+
+struct sample get_sample_from_columns(const struct sample_columns *cols, int idx)
+{
+	struct sample s;
+	read_sample(cols, idx, &s);
+	return s;
+}
+
+struct sample_column get_sample_column(const struct divecomputer *dc, enum sample_channel channel)
+{
+	struct sample_column res = { NULL, 0 };
+	const struct sample_columns *cols = dc->packed_samples;
+
+	if (cols) {
+		if (cols->data[channel]) {
+			res.data = cols->data[channel];
+			res.stride = channel_info[channel].size;
+		} else {
+			res.data = (const char *)&cols->constant[channel];
+		}
+	} else if (dc->sample) {
+		res.data = (const char *)dc->sample + channel_info[channel].offset;
+		res.stride = sizeof(struct sample);
+	}
+	return res;
+}
+
+bool sample_channel_is_constant(const struct sample_columns *cols, enum sample_channel channel)
+{
+	return !cols->data[channel];
+}
+
+void free_sample_columns(struct sample_columns *cols)
+{
+	int channel;
+	for (channel = 0; channel < NUM_SAMPLE_CHANNELS; channel++)
+		free(cols->data[channel]);
+	memset(cols, 0, sizeof(*cols));
+}
+
+/* Memory used by the sample data, for statistics and tests */
+size_t sample_columns_size(const struct sample_columns *cols)
+{
+	int channel;
+	size_t res = sizeof(*cols);
+	for (channel = 0; channel < NUM_SAMPLE_CHANNELS; channel++) {
+		if (cols->data[channel])
+			res += cols->nr * channel_info[channel].size;
+	}
+	return res;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLECOLUMNS_H
+#define SAMPLECOLUMNS_H
+
+#include "dive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Columnar ("structure of arrays") storage of the samples of a dive computer.
+ *
+ * Every field of struct sample is a channel. Most dive computers fill only a
+ * few of them (time, depth, temperature, one pressure) and leave the others
+ * at a constant value. Therefore, an array is only allocated for channels
+ * whose value actually changes during the dive. For constant channels only
+ * the value is stored.
+ *
+ * Packing and unpacking are lossless: get_sample_from_columns(cols, i)
+ * returns a sample that equals dc->sample[i] at the time of packing.
+ */
+enum sample_channel {
+	SAMPLE_CHANNEL_TIME,
+	SAMPLE_CHANNEL_STOPTIME,
+	SAMPLE_CHANNEL_NDL,
+	SAMPLE_CHANNEL_TTS,
+	SAMPLE_CHANNEL_RBT,
+	SAMPLE_CHANNEL_DEPTH,
+	SAMPLE_CHANNEL_STOPDEPTH,
+	SAMPLE_CHANNEL_TEMPERATURE,
+	SAMPLE_CHANNEL_PRESSURE0,
+	SAMPLE_CHANNEL_PRESSURE1,
+	SAMPLE_CHANNEL_SETPOINT,
+	SAMPLE_CHANNEL_O2SENSOR0,
+	SAMPLE_CHANNEL_O2SENSOR1,
+	SAMPLE_CHANNEL_O2SENSOR2,
+	SAMPLE_CHANNEL_BEARING,
+	SAMPLE_CHANNEL_SENSOR0,
+	SAMPLE_CHANNEL_SENSOR1,
+	SAMPLE_CHANNEL_CNS,
+	SAMPLE_CHANNEL_HEARTBEAT,
+	SAMPLE_CHANNEL_SAC,
+	SAMPLE_CHANNEL_IN_DECO,
+	SAMPLE_CHANNEL_MANUALLY_ENTERED,
+	NUM_SAMPLE_CHANNELS
+};
+
+struct sample_columns {
+	int nr;
+	void *data[NUM_SAMPLE_CHANNELS];		/* NULL for constant channels */
+	uint32_t constant[NUM_SAMPLE_CHANNELS];	/* raw value of constant channels */
+};
+
+/*
+ * Typed access to one channel of the samples of a dive computer, no matter
+ * whether they are packed or in the dc->sample array. Loops that only need
+ * a few channels read just these:
+ *
+ *     struct sample_column time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+ *     struct sample_column depth = get_sample_column(dc, SAMPLE_CHANNEL_DEPTH);
+ *     for (i = 0; i < dc->samples; i++)
+ *         ... SAMPLE_VALUE(time, duration_t, i).seconds, SAMPLE_VALUE(depth, depth_t, i).mm ...
+ *
+ * The type must be the type of the field in struct sample. A constant
+ * channel has a stride of zero.
+ */
+struct sample_column {
+	const char *data;
+	size_t stride;
+};
+
+#define SAMPLE_VALUE(col, type, idx) (*(const type *)((col).data + (size_t)(idx) * (col).stride))
+
+extern struct sample_column get_sample_column(const struct divecomputer *dc, enum sample_channel channel);
+extern void pack_sample_columns(struct sample_columns *cols, const struct sample *samples, int nr);
+extern void unpack_sample_columns(const struct sample_columns *cols, struct sample *samples);
+extern void free_sample_columns(struct sample_columns *cols);
+extern struct sample get_sample_from_columns(const struct sample_columns *cols, int idx);
+extern bool sample_channel_is_constant(const struct sample_columns *cols, enum sample_channel channel);
+extern size_t sample_columns_size(const struct sample_columns *cols);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLECOLUMNS_H
@@ -345,9 +345,8 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 
 static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
 {
-	int nr;
+	int i;
 	int o2sensor;
-	struct sample *s;
 	struct sample dummy = { .bearing.degrees = -1, .ndl.seconds = -1 };
 
 	/* Is this a CCR dive with the old-style "o2pressure" sensor? */
@@ -357,11 +356,9 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		dummy.sensor[1] = o2sensor;
 	}
 
-	s = dc->sample;
-	nr = dc->samples;
-	while (--nr >= 0) {
-		save_sample(b, s, &dummy, o2sensor);
-		s++;
+	for (i = 0; i < dc->samples; i++) {
+		struct sample s = get_sample(dc, i);
+		save_sample(b, &s, &dummy, o2sensor);
 	}
 }
 
@@ -35,6 +35,8 @@ static void put_video_time(struct membuffer *b, int secs)
 static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 {
 	const struct plot_data *entry = pi->entry + idx;
+	const struct plot_deco_data *deco = get_plot_deco_data(pi, idx);
+	const struct plot_gas_data *gas = get_plot_gas_data(pi, idx);
 
 	put_int(b, entry->in_deco);
 	put_int(b,  entry->sec);
@@ -46,9 +48,9 @@ static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 	put_int(b, entry->depth);
 	put_int(b, entry->ceiling);
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->ceilings[i]);
+		put_int(b, deco->ceilings[i]);
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->percentages[i]);
+		put_int(b, deco->percentages[i]);
 	put_int(b, entry->ndl);
 	put_int(b, entry->tts);
 	put_int(b, entry->rbt);
@@ -67,10 +69,10 @@ static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 	put_int(b, entry->o2sensor[2].mbar);
 	put_int(b, entry->o2setpoint.mbar);
 	put_int(b, entry->scr_OC_pO2.mbar);
-	put_double(b, entry->mod);
-	put_double(b, entry->ead);
-	put_double(b, entry->end);
-	put_double(b, entry->eadd);
+	put_double(b, gas->mod);
+	put_double(b, gas->ead);
+	put_double(b, gas->end);
+	put_double(b, gas->eadd);
 	switch (entry->velocity) {
 	case STABLE:
 		put_csv_string(b, "STABLE");
@@ -97,10 +99,10 @@ static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 	put_int(b, entry->pressure_time);
 	put_int(b, entry->heartbeat);
 	put_int(b, entry->bearing);
-	put_double(b, entry->ambpressure);
-	put_double(b, entry->gfline);
-	put_double(b, entry->surface_gf);
-	put_double(b, entry->density);
+	put_double(b, deco->ambpressure);
+	put_double(b, deco->gfline);
+	put_double(b, deco->surface_gf);
+	put_double(b, gas->density);
 	put_int(b, entry->icd_warning ? 1 : 0);
 }
 
@@ -158,8 +160,10 @@ static void put_headers(struct membuffer *b, int nr_cylinders)
 	put_csv_string(b, "icd_warning");
 }
 
-static void put_st_event(struct membuffer *b, struct plot_data *entry, int offset, int length)
+static void put_st_event(struct membuffer *b, const struct plot_info *pi, int idx, int offset, int length)
 {
+	const struct plot_data *entry = pi->entry + idx;
+	const struct plot_deco_data *deco = get_plot_deco_data(pi, idx);
 	double value;
 	int decimals;
 	const char *unit;
@@ -186,8 +190,8 @@ static void put_st_event(struct membuffer *b, struct plot_data *entry, int offse
 			if (entry->tts_calc > 0)
 				put_format(b, "TTS=%d:%02d ", FRACTION(entry->tts_calc, 60));
 	}
-	if (entry->surface_gf > 0.0) {
-		put_format(b, "sGF=%.1f%% ", entry->surface_gf);
+	if (deco->surface_gf > 0.0) {
+		put_format(b, "sGF=%.1f%% ", deco->surface_gf);
 	}
 	put_format(b, "\n");
 }
@@ -203,7 +207,7 @@ static void save_profiles_buffer(struct membuffer *b, bool select_only)
 	for_each_dive(i, dive) {
 		if (select_only && !dive->selected)
 			continue;
-		create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
+		create_plot_info_new(dive, &dive->dc, &pi, PLOT_ALL, planner_deco_state);
 		put_headers(b, pi.nr_cylinders);
 		put_format(b, "\n");
 
@@ -222,7 +226,8 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 	struct deco_state *planner_deco_state = NULL;
 
 	init_plot_info(&pi);
-	create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
+	/* The subtitles show the calculated NDL/TTS and surface GF only */
+	create_plot_info_new(dive, &dive->dc, &pi, PLOT_DECO, planner_deco_state);
 
 	put_format(b, "[Script Info]\n");
 	put_format(b, "; Script generated by Subsurface %s\n", subsurface_canonical_version());
@@ -232,7 +237,7 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 	put_format(b, "[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
 
 	for (int i = 0; i < pi.nr; i++) {
-		put_st_event(b, &pi.entry[i], offset, length);
+		put_st_event(b, &pi, i, offset, length);
 	}
 	put_format(b, "\n");
 
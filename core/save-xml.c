@@ -403,9 +403,8 @@ static void show_date(struct membuffer *b, timestamp_t when)
 
 static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
 {
-	int nr;
+	int i;
 	int o2sensor;
-	struct sample *s;
 	struct sample dummy = { .bearing.degrees = -1, .ndl.seconds = -1 };
 
 	/* Set up default pressure sensor indexes */
@@ -415,11 +414,9 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		dummy.sensor[1] = o2sensor;
 	}
 
-	s = dc->sample;
-	nr = dc->samples;
-	while (--nr >= 0) {
-		save_sample(b, s, &dummy, o2sensor);
-		s++;
+	for (i = 0; i < dc->samples; i++) {
+		struct sample s = get_sample(dc, i);
+		save_sample(b, &s, &dummy, o2sensor);
 	}
 }
 
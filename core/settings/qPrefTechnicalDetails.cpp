@@ -1,7 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "qPrefTechnicalDetails.h"
 #include "qPrefPrivate.h"
-#include "core/deco.h"
 
 static const QString group = QStringLiteral("TecDetails");
 
@@ -73,7 +72,6 @@ void qPrefTechnicalDetails::disk_gfhigh(bool doSync)
 			qPrefPrivate::propSetValue(keyFromGroupAndName(group, "gfhigh"), prefs.gfhigh, default_prefs.gfhigh);
 	} else {
 		prefs.gfhigh = qPrefPrivate::propValue(keyFromGroupAndName(group, "gfhigh"), default_prefs.gfhigh).toInt();
-		set_gf(-1, prefs.gfhigh);
 	}
 }
 
@@ -93,7 +91,6 @@ void qPrefTechnicalDetails::disk_gflow(bool doSync)
 			qPrefPrivate::propSetValue(keyFromGroupAndName(group, "gflow"), prefs.gflow, default_prefs.gflow);
 	} else {
 		prefs.gflow = qPrefPrivate::propValue(keyFromGroupAndName(group, "gflow"), default_prefs.gflow).toInt();
-		set_gf(prefs.gflow, -1);
 	}
 }
 
@@ -141,7 +138,6 @@ void qPrefTechnicalDetails::disk_vpmb_conservatism(bool doSync)
 			qPrefPrivate::propSetValue(keyFromGroupAndName(group, "vpmb_conservatism"), prefs.vpmb_conservatism, default_prefs.vpmb_conservatism);
 	} else {
 		prefs.vpmb_conservatism = qPrefPrivate::propValue(keyFromGroupAndName(group, "vpmb_conservatism"), default_prefs.vpmb_conservatism).toInt();
-		set_vpmb_conservatism(prefs.vpmb_conservatism);
 	}
 }
 
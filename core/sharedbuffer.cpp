@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "sharedbuffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdlib.h>
+
+// The reference count is stored in front of the data. The header is padded
+// so that the data keeps the alignment guaranteed by malloc().
+namespace {
+	union BufferHeader {
+		std::atomic<int> refcount;
+		std::max_align_t align;
+		BufferHeader() : refcount(1) {}
+	};
+}
+
+static BufferHeader *header(const void *buf)
+{
+	return reinterpret_cast<BufferHeader *>(const_cast<char *>(static_cast<const char *>(buf))) - 1;
+}
+
+extern "C" void *alloc_shared_buffer(size_t size)
+{
+	void *mem = malloc(sizeof(BufferHeader) + size);
+	if (!mem)
+		exit(1);
+	return new (mem) BufferHeader + 1;
+}
+
+// Only unique buffers may be resized
+extern "C" void *realloc_shared_buffer(void *buf, size_t size)
+{
+	if (!buf)
+		return alloc_shared_buffer(size);
+	void *mem = realloc(header(buf), sizeof(BufferHeader) + size);
+	if (!mem)
+		exit(1);
+	return new (mem) BufferHeader + 1;
+}
+
+extern "C" void *share_buffer(void *buf)
+{
+	if (buf)
+		header(buf)->refcount.fetch_add(1, std::memory_order_relaxed);
+	return buf;
+}
+
+extern "C" void release_shared_buffer(void *buf)
+{
+	if (!buf)
+		return;
+	BufferHeader *h = header(buf);
+	if (h->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		h->~BufferHeader();
+		free(h);
+	}
+}
+
+extern "C" bool shared_buffer_is_unique(const void *buf)
+{
+	return !buf || header(buf)->refcount.load(std::memory_order_acquire) == 1;
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Reference-counted memory blocks for copy-on-write sharing.
+ *
+ * A shared buffer is allocated with alloc_shared_buffer() and behaves like a
+ * malloc()ed block, except that it must be released with
+ * release_shared_buffer() and resized with realloc_shared_buffer().
+ * share_buffer() adds a reference. Code that wants to write to a buffer must
+ * first check shared_buffer_is_unique() and make a private copy otherwise.
+ *
+ * The reference counts are atomic, i.e. buffers may be shared across threads.
+ */
+#ifndef SHAREDBUFFER_H
+#define SHAREDBUFFER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void *alloc_shared_buffer(size_t size);
+extern void *realloc_shared_buffer(void *buf, size_t size);
+extern void *share_buffer(void *buf);
+extern void release_shared_buffer(void *buf);
+extern bool shared_buffer_is_unique(const void *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHAREDBUFFER_H
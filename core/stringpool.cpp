@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "stringpool.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdlib.h>
+
+// The strings are the keys of a node based hash map. Since the nodes never
+// move, the buffers of the keys can be handed out as interned strings.
+// The value is the reference count.
+static std::unordered_map<std::string, int> pool;
+static std::mutex poolLock;
+
+extern "C" char *intern_string(const char *s)
+{
+	if (!s)
+		return nullptr;
+	std::lock_guard<std::mutex> guard(poolLock);
+	auto it = pool.emplace(s, 0).first;
+	++it->second;
+	return const_cast<char *>(it->first.c_str());
+}
+
+// Intern a malloc()ed (or already interned) string and release the original
+extern "C" char *intern_owned_string(char *s)
+{
+	char *res = intern_string(s);
+	release_string(s);
+	return res;
+}
+
+extern "C" void release_string(const char *s)
+{
+	if (!s)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(poolLock);
+		auto it = pool.find(s);
+		if (it != pool.end() && it->first.c_str() == s) {
+			if (--it->second <= 0)
+				pool.erase(it);
+			return;
+		}
+	}
+	// Not an interned string
+	free((void *)s);
+}
+
+extern "C" bool is_interned_string(const char *s)
+{
+	if (!s)
+		return false;
+	std::lock_guard<std::mutex> guard(poolLock);
+	auto it = pool.find(s);
+	return it != pool.end() && it->first.c_str() == s;
+}
+
+extern "C" int interned_string_count()
+{
+	std::lock_guard<std::mutex> guard(poolLock);
+	return (int)pool.size();
+}
+
+char *intern_qstring(const QString &s)
+{
+	return intern_string(qPrintable(s));
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pool of interned, reference-counted strings.
+ *
+ * Strings like the buddy, the suit or the dive computer model are repeated
+ * over and over in a logbook. intern_string() returns a shared copy of its
+ * argument, so that equal strings share storage and can be compared by
+ * pointer. Interned strings must not be modified and must be freed with
+ * release_string(). release_string() also accepts plain malloc()ed strings,
+ * therefore fields that may contain interned strings can be freed with
+ * release_string() regardless of how they were allocated.
+ *
+ * The functions are thread safe.
+ */
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern char *intern_string(const char *s);
+extern char *intern_owned_string(char *s);
+extern void release_string(const char *s);
+extern bool is_interned_string(const char *s);
+extern int interned_string_count(void);
+
+#ifdef __cplusplus
+}
+
+#include <QString>
+char *intern_qstring(const QString &s);
+#endif
+
+#endif // STRINGPOOL_H
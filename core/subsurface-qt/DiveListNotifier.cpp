@@ -1,4 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "DiveListNotifier.h"
+#include "core/plotinfocache.h"
+#include "core/tissuecache.h"
 
 DiveListNotifier diveListNotifier;
+
+static void invalidateCaches(const QVector<dive *> &dives)
+{
+	for (const dive *d: dives) {
+		invalidate_tissue_cache(d);
+		invalidate_plot_info_cache(d);
+	}
+}
+
+DiveListNotifier::DiveListNotifier() : commandExecuting(false)
+{
+	// The tissue loading and therefore the profile of a dive depend on all dives
+	// before it. Insertions and removals are handled by the dive table, edits
+	// are announced here.
+	connect(this, &DiveListNotifier::divesChanged, [](const QVector<dive *> &dives, DiveField) { invalidateCaches(dives); });
+	connect(this, &DiveListNotifier::divesTimeChanged, [](timestamp_t, const QVector<dive *> &dives) { invalidateCaches(dives); });
+	connect(this, &DiveListNotifier::divesMovedBetweenTrips, [](dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives)
+		{ invalidateCaches(dives); });
+	connect(this, &DiveListNotifier::cylindersReset, &invalidateCaches);
+}
@@ -143,6 +143,8 @@ public:
 	// 	... do work ...
 	// }
 	InCommandMarker enterCommand();
+
+	DiveListNotifier();
 private:
 	friend InCommandMarker;
 	bool commandExecuting;
@@ -150,6 +152,7 @@ private:
 
 // The DiveListNotifier class has only trivial state.
 // We can simply define it as a global object.
+// On construction, it connects the caches of the core to its signals.
 extern DiveListNotifier diveListNotifier;
 
 // InCommandMarker is so trivial that the functions can be inlined.
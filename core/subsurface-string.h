@@ -32,7 +32,7 @@ extern "C" {
 
 static inline bool same_string(const char *a, const char *b)
 {
-	return !strcmp(a ?: "", b ?: "");
+	return a == b || !strcmp(a ?: "", b ?: "");
 }
 
 static inline bool same_string_caseinsensitive(const char *a, const char *b)
@@ -23,42 +23,55 @@
 	}
 
 /* get the index where we want to insert an object so that everything stays
- * ordered according to a comparison function() */
+ * ordered according to a comparison function(). The object is inserted after
+ * all objects that compare as equal. This assumes that the table is sorted. */
 #define MAKE_GET_INSERTION_INDEX(table_type, item_type, array_name, fun)		\
 	int table_type##_get_insertion_index(struct table_type *table, item_type item)	\
 	{										\
-		/* we might want to use binary search here */				\
-		for (int i = 0; i < table->nr; i++) {					\
-			if (fun(item, table->array_name[i]))				\
-				return i;						\
+		int lo = 0, hi = table->nr;						\
+		while (lo < hi) {							\
+			int mid = lo + (hi - lo) / 2;					\
+			if (fun(item, table->array_name[mid]))				\
+				hi = mid;						\
+			else								\
+				lo = mid + 1;						\
 		}									\
-		return table->nr;							\
+		return lo;								\
 	}
 
+/* Some tables keep auxiliary data, such as a lookup index, in sync with the
+ * array. The "_WITH_HOOK" variants of the macros below call "hook(table, idx)"
+ * after the entries starting at position "idx" have changed. Note that the
+ * hook of a removal is called after the item is gone. */
+#define TABLE_NO_HOOK(table, idx) do { (void)(table); (void)(idx); } while (0)
+
 /* add object at the given index to a table. */
-#define MAKE_ADD_TO(table_type, item_type, array_name)					\
+#define MAKE_ADD_TO_WITH_HOOK(table_type, item_type, array_name, hook)			\
 	void add_to_##table_type(struct table_type *table, int idx, item_type item)	\
 	{										\
-		int i;									\
 		grow_##table_type(table);						\
+		memmove(&table->array_name[idx + 1], &table->array_name[idx],		\
+			(table->nr - idx) * sizeof(item_type));				\
+		table->array_name[idx] = item;						\
 		table->nr++;								\
-											\
-		for (i = idx; i < table->nr; i++) {					\
-			item_type tmp = table->array_name[i];				\
-			table->array_name[i] = item;					\
-			item = tmp;							\
-		}									\
+		hook(table, idx);							\
 	}
 
-#define MAKE_REMOVE_FROM(table_type, array_name)						\
+#define MAKE_ADD_TO(table_type, item_type, array_name)					\
+	MAKE_ADD_TO_WITH_HOOK(table_type, item_type, array_name, TABLE_NO_HOOK)
+
+#define MAKE_REMOVE_FROM_WITH_HOOK(table_type, array_name, hook)				\
 	void remove_from_##table_type(struct table_type *table, int idx)			\
 	{											\
-		int i;										\
-		for (i = idx; i < table->nr - 1; i++)						\
-			table->array_name[i] = table->array_name[i + 1];			\
+		memmove(&table->array_name[idx], &table->array_name[idx + 1],		\
+			(table->nr - idx - 1) * sizeof(table->array_name[0]));			\
 		memset(&table->array_name[--table->nr], 0, sizeof(table->array_name[0]));	\
+		hook(table, idx);								\
 	}
 
+#define MAKE_REMOVE_FROM(table_type, array_name)						\
+	MAKE_REMOVE_FROM_WITH_HOOK(table_type, array_name, TABLE_NO_HOOK)
+
 #define MAKE_GET_IDX(table_type, item_type, array_name)						\
 	int get_idx_in_##table_type(const struct table_type *table, const item_type item)	\
 	{											\
@@ -69,7 +82,7 @@
 		return -1;									\
 	}
 
-#define MAKE_SORT(table_type, item_type, array_name, fun)					\
+#define MAKE_SORT_WITH_HOOK(table_type, item_type, array_name, fun, hook)			\
 	static int sortfn_##table_type(const void *_a, const void *_b)				\
 	{											\
 		const item_type a = (const item_type)*(const void **)_a;			\
@@ -80,8 +93,57 @@
 	void sort_##table_type(struct table_type *table)					\
 	{											\
 		qsort(table->array_name, table->nr, sizeof(item_type), sortfn_##table_type);	\
+		hook(table, 0);									\
 	}
 
+#define MAKE_SORT(table_type, item_type, array_name, fun)					\
+	MAKE_SORT_WITH_HOOK(table_type, item_type, array_name, fun, TABLE_NO_HOOK)
+
+/* Add a number of objects to a sorted table. Instead of inserting the objects
+ * one-by-one, which is quadratic in the number of objects, they are sorted
+ * once and then merged with the existing objects from the back. As with
+ * the insertion index, added objects are placed after objects that compare
+ * as equal. The array of objects to add is sorted in the process. */
+#define MAKE_ADD_ITEMS_WITH_HOOK(table_type, item_type, array_name, fun, hook)		\
+	static int sortfn_add_##table_type(const void *_a, const void *_b)			\
+	{											\
+		const item_type a = (const item_type)*(const void **)_a;			\
+		const item_type b = (const item_type)*(const void **)_b;			\
+		return fun(a, b) ? -1 : fun(b, a) ? 1 : 0;					\
+	}											\
+												\
+	void add_items_to_##table_type(struct table_type *table, item_type *items, int nr)	\
+	{											\
+		int i, j, k, first;								\
+		if (nr <= 0)									\
+			return;									\
+		qsort(items, nr, sizeof(item_type), sortfn_add_##table_type);			\
+		if (table->nr + nr > table->allocated) {					\
+			table->allocated = (table->nr + nr + 32) * 3 / 2;			\
+			table->array_name = realloc(table->array_name,				\
+						    table->allocated * sizeof(item_type));	\
+			if (!table->array_name)							\
+				exit(1);							\
+		}										\
+		i = table->nr - 1;								\
+		j = nr - 1;									\
+		k = table->nr + nr - 1;								\
+		first = k;									\
+		while (j >= 0) {								\
+			if (i >= 0 && fun(items[j], table->array_name[i])) {			\
+				table->array_name[k--] = table->array_name[i--];		\
+			} else {								\
+				first = k;							\
+				table->array_name[k--] = items[j--];				\
+			}									\
+		}										\
+		table->nr += nr;								\
+		hook(table, first);								\
+	}
+
+#define MAKE_ADD_ITEMS(table_type, item_type, array_name, fun)				\
+	MAKE_ADD_ITEMS_WITH_HOOK(table_type, item_type, array_name, fun, TABLE_NO_HOOK)
+
 #define MAKE_REMOVE(table_type, item_type, item_name)				\
 	int remove_##item_name(const item_type item, struct table_type *table)	\
 	{									\
@@ -91,16 +153,20 @@
 		return idx;							\
 	}
 
-#define MAKE_CLEAR_TABLE(table_type, array_name, item_name)			\
+#define MAKE_CLEAR_TABLE_WITH_HOOK(table_type, array_name, item_name, hook)	\
 	void clear_##table_type(struct table_type *table)			\
 	{									\
 		for (int i = 0; i < table->nr; i++)				\
 			free_##item_name(table->array_name[i]);			\
 		table->nr = 0;							\
+		hook(table, 0);							\
 	}
 
+#define MAKE_CLEAR_TABLE(table_type, array_name, item_name)			\
+	MAKE_CLEAR_TABLE_WITH_HOOK(table_type, array_name, item_name, TABLE_NO_HOOK)
+
 /* Move data of one table to the other - source table is empty after call. */
-#define MAKE_MOVE_TABLE(table_type, array_name)					\
+#define MAKE_MOVE_TABLE_WITH_HOOK(table_type, array_name, hook)			\
 	void move_##table_type(struct table_type *src, struct table_type *dst)	\
 	{									\
 		clear_##table_type(dst);					\
@@ -108,6 +174,11 @@
 		*dst = *src;							\
 		src->nr = src->allocated = 0;					\
 		src->array_name = NULL;						\
+		hook(src, 0);							\
+		hook(dst, 0);							\
 	}
 
+#define MAKE_MOVE_TABLE(table_type, array_name)					\
+	MAKE_MOVE_TABLE_WITH_HOOK(table_type, array_name, TABLE_NO_HOOK)
+
 #endif
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "tissuecache.h"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace {
+	struct TissueCacheEntry {
+		// The fields of the dive that the state was calculated with, as a
+		// safeguard against modifications that did not invalidate the cache.
+		timestamp_t when;
+		int duration;
+		int samples;
+
+		bool has_tissues;
+		enum divemode_t divemode;
+		int sac;
+		struct deco_state ds;
+
+		bool has_cns;
+		double cns;
+
+		// Position in the list of recently used entries
+		std::list<std::pair<int, const struct dive_trip *>>::iterator lru;
+	};
+
+	// Keyed by dive id and the trip that the replay was restricted to
+	using Key = std::pair<int, const struct dive_trip *>;
+}
+
+// After loading, update_all_derived_dive_data() stores the states of all
+// dives that are followed by another dive within 48 hours. Should the log
+// be larger than that, the least recently used entries are evicted. This
+// only makes replays start further back, since a missing state is simply
+// recalculated from an earlier one.
+static const size_t max_entries = 4096;
+
+static std::mutex lock;
+static std::map<Key, TissueCacheEntry> cache;
+static std::list<Key> lru; // most recently used first
+
+// Must be called with the lock held
+static void touch(TissueCacheEntry &entry)
+{
+	lru.splice(lru.begin(), lru, entry.lru);
+}
+
+static bool same_config(const struct deco_config &c1, const struct deco_config &c2)
+{
+	return c1.mode == c2.mode && c1.planner == c2.planner &&
+	       c1.gf_low == c2.gf_low && c1.gf_high == c2.gf_high &&
+	       c1.vpmb_conservatism == c2.vpmb_conservatism;
+}
+
+static bool same_dive(const TissueCacheEntry &entry, const struct dive *dive)
+{
+	return entry.when == dive->when && entry.duration == (int)dive->dc.duration.seconds &&
+	       entry.samples == dive->dc.samples;
+}
+
+// Returns the entry of the dive, which is reset if the dive changed. Must be called with the lock held.
+static TissueCacheEntry &get_entry(const struct dive *dive, const struct dive_trip *trip)
+{
+	Key key(dive->id, trip);
+	auto it = cache.find(key);
+	if (it == cache.end()) {
+		if (cache.size() >= max_entries) {
+			cache.erase(lru.back());
+			lru.pop_back();
+		}
+		lru.push_front(key);
+		it = cache.emplace(key, TissueCacheEntry()).first;
+		it->second.lru = lru.begin();
+	} else {
+		touch(it->second);
+	}
+	TissueCacheEntry &entry = it->second;
+	if (!same_dive(entry, dive)) {
+		entry.when = dive->when;
+		entry.duration = dive->dc.duration.seconds;
+		entry.samples = dive->dc.samples;
+		entry.has_tissues = entry.has_cns = false;
+	}
+	return entry;
+}
+
+extern "C" bool get_cached_tissues(const struct dive *dive, const struct dive_trip *trip, enum divemode_t divemode, int sac, struct deco_state *ds)
+{
+	std::lock_guard<std::mutex> l(lock);
+	auto it = cache.find(Key(dive->id, trip));
+	if (it == cache.end())
+		return false;
+	TissueCacheEntry &entry = it->second;
+	if (!entry.has_tissues || !same_dive(entry, dive) || entry.divemode != divemode ||
+	    entry.sac != sac || !same_config(entry.ds.config, ds->config))
+		return false;
+	touch(entry);
+	*ds = entry.ds;
+	return true;
+}
+
+extern "C" void cache_tissues(const struct dive *dive, const struct dive_trip *trip, enum divemode_t divemode, int sac, const struct deco_state *ds)
+{
+	std::lock_guard<std::mutex> l(lock);
+	TissueCacheEntry &entry = get_entry(dive, trip);
+	entry.has_tissues = true;
+	entry.divemode = divemode;
+	entry.sac = sac;
+	entry.ds = *ds;
+}
+
+extern "C" bool get_cached_cns(const struct dive *dive, const struct dive_trip *trip, double *cns)
+{
+	std::lock_guard<std::mutex> l(lock);
+	auto it = cache.find(Key(dive->id, trip));
+	if (it == cache.end() || !it->second.has_cns || !same_dive(it->second, dive))
+		return false;
+	touch(it->second);
+	*cns = it->second.cns;
+	return true;
+}
+
+extern "C" void cache_cns(const struct dive *dive, const struct dive_trip *trip, double cns)
+{
+	std::lock_guard<std::mutex> l(lock);
+	TissueCacheEntry &entry = get_entry(dive, trip);
+	entry.has_cns = true;
+	entry.cns = cns;
+}
+
+// Must be called with the lock held
+static void drop_entries_from(timestamp_t when)
+{
+	for (auto it = cache.begin(); it != cache.end(); ) {
+		if (it->second.when >= when) {
+			lru.erase(it->second.lru);
+			it = cache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+extern "C" void invalidate_tissue_cache(const struct dive *dive)
+{
+	std::lock_guard<std::mutex> l(lock);
+
+	// If the start time of the dive changed, the states between the old
+	// and the new time are also affected. Note that if the dive was part
+	// of a replay, it has an entry with the old time.
+	timestamp_t when = dive->when;
+	for (auto it = cache.lower_bound(Key(dive->id, nullptr)); it != cache.end() && it->first.first == dive->id; ++it) {
+		if (it->second.when < when)
+			when = it->second.when;
+	}
+	drop_entries_from(when);
+}
+
+extern "C" void invalidate_tissue_cache_from(timestamp_t when)
+{
+	std::lock_guard<std::mutex> l(lock);
+	drop_entries_from(when);
+}
+
+extern "C" void clear_tissue_cache()
+{
+	std::lock_guard<std::mutex> l(lock);
+	cache.clear();
+	lru.clear();
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Cache of the tissue loading and CNS at the end of dives.
+ *
+ * To initialize the tissues for a dive, init_decompression() replays all
+ * dives of the preceding 48 hours, calculate_cns() those of the preceding
+ * 12 hours. These replays store the state after each dive they pass, so
+ * that later calculations only have to start at the closest cached
+ * predecessor. After loading a log, update_all_derived_dive_data() fills
+ * the cache for all dives in one pass.
+ *
+ * A cached state depends on the dive itself, on all dives before it and
+ * on the trip the replay was restricted to. The state of a dive is only
+ * stored together with the states of its predecessors. Therefore, when a
+ * dive changes, it is sufficient to drop the states of all dives starting
+ * at or after that dive: invalidate_tissue_cache() does that for dives
+ * in the dive table and the dive table functions do it for insertions and
+ * removals.
+ *
+ * The cache may be accessed from different threads.
+ */
+#ifndef TISSUECACHE_H
+#define TISSUECACHE_H
+
+#include "deco.h"
+#include "dive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The surface intervals are added with the divemode of the calculated dive and the deco SAC */
+extern bool get_cached_tissues(const struct dive *dive, const struct dive_trip *trip, enum divemode_t divemode, int sac, struct deco_state *ds);
+extern void cache_tissues(const struct dive *dive, const struct dive_trip *trip, enum divemode_t divemode, int sac, const struct deco_state *ds);
+extern bool get_cached_cns(const struct dive *dive, const struct dive_trip *trip, double *cns);
+extern void cache_cns(const struct dive *dive, const struct dive_trip *trip, double cns);
+extern void invalidate_tissue_cache(const struct dive *dive);
+extern void invalidate_tissue_cache_from(timestamp_t when);
+extern void clear_tissue_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TISSUECACHE_H
@@ -49,6 +49,7 @@ static MAKE_GET_INSERTION_INDEX(trip_table, struct dive_trip *, trips, trip_less
 static MAKE_ADD_TO(trip_table, struct dive_trip *, trips)
 static MAKE_REMOVE_FROM(trip_table, trips)
 MAKE_SORT(trip_table, struct dive_trip *, trips, comp_trips)
+MAKE_ADD_ITEMS(trip_table, struct dive_trip *, trips, trip_less_than)
 MAKE_REMOVE(trip_table, struct dive_trip *, trip)
 MAKE_CLEAR_TABLE(trip_table, trips, trip)
 
@@ -138,6 +139,15 @@ void insert_trip(dive_trip_t *dive_trip, struct trip_table *trip_table_arg)
 #endif
 }
 
+/* insert a number of trips into the trip table. Note: the "trips" array is sorted. */
+void insert_trips(dive_trip_t **trips, int nr, struct trip_table *trip_table_arg)
+{
+	add_items_to_trip_table(trip_table_arg, trips, nr);
+#ifdef DEBUG_TRIP
+	dump_trip_list();
+#endif
+}
+
 dive_trip_t *create_trip_from_dive(struct dive *dive)
 {
 	dive_trip_t *trip;
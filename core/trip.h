@@ -29,6 +29,7 @@ extern struct dive_trip *unregister_dive_from_trip(struct dive *dive);
 extern void remove_dive_from_trip(struct dive *dive, struct trip_table *trip_table_arg);
 
 extern void insert_trip(dive_trip_t *trip, struct trip_table *trip_table_arg);
+extern void insert_trips(dive_trip_t **trips, int nr, struct trip_table *trip_table_arg);
 extern int remove_trip(const dive_trip_t *trip, struct trip_table *trip_table_arg);
 extern void free_trip(dive_trip_t *trip);
 extern timestamp_t trip_date(const struct dive_trip *trip);
@@ -29,6 +29,7 @@
 #include "errorhelper.h"
 #include "file.h"
 #include "tag.h"
+#include "stringpool.h"
 #include "core/subsurface-string.h"
 
 #define ERR_FS_ALMOST_FULL QT_TRANSLATE_NOOP("gettextFromC", "Uemis Zurich: the file system is almost full.\nDisconnect/reconnect the dive computer\nand click \'Retry\'")
@@ -856,11 +857,11 @@ static bool uemis_delete_dive(device_data_t *devdata, uint32_t diveid)
 	if (dive) {
 		devdata->download_table->dives[--devdata->download_table->nr] = NULL;
 
-		free(dive->dc.sample);
+		free_samples(&dive->dc);
 		free((void *)dive->notes);
-		free((void *)dive->divemaster);
-		free((void *)dive->buddy);
-		free((void *)dive->suit);
+		release_string(dive->divemaster);
+		release_string(dive->buddy);
+		release_string(dive->suit);
 		taglist_free(dive->tag_list);
 		free(dive);
 
@@ -246,7 +246,7 @@ void TabDiveEquipment::acceptChanges()
 		while(tdc && sdc) {
 			free_events(tdc->events);
 			copy_events(sdc, tdc);
-			free(tdc->sample);
+			free_samples(tdc);
 			copy_samples(sdc, tdc);
 			tdc = tdc->next;
 			sdc = sdc->next;
@@ -34,6 +34,7 @@
 #include "core/membuffer.h"
 #include "core/downloadfromdcthread.h"
 #include "core/subsurface-string.h"
+#include "core/stringpool.h"
 #include "core/pref.h"
 #include "core/selection.h"
 #include "core/ssrf.h"
@@ -1188,24 +1189,24 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 	}
 	if (myDive.suit != suit) {
 		diveChanged = true;
-		free(d->suit);
-		d->suit = copy_qstring(suit);
+		release_string(d->suit);
+		d->suit = intern_qstring(suit);
 	}
 	if (myDive.buddy != buddy) {
 		if (buddy.contains(",")){
 			buddy = buddy.replace(QRegExp("\\s*,\\s*"), ", ");
 		}
 		diveChanged = true;
-		free(d->buddy);
-		d->buddy = copy_qstring(buddy);
+		release_string(d->buddy);
+		d->buddy = intern_qstring(buddy);
 	}
 	if (myDive.divemaster != diveMaster) {
 		if (diveMaster.contains(",")){
 			diveMaster = diveMaster.replace(QRegExp("\\s*,\\s*"), ", ");
 		}
 		diveChanged = true;
-		free(d->divemaster);
-		d->divemaster = copy_qstring(diveMaster);
+		release_string(d->divemaster);
+		d->divemaster = intern_qstring(diveMaster);
 	}
 	if (myDive.rating != rating) {
 		diveChanged = true;
@@ -66,18 +66,25 @@ SOURCES += ../../subsurface-mobile-main.cpp \
 	../../core/ostctools.c \
 	../../core/planner.c \
 	../../core/save-xml.c \
+	../../core/samplecolumns.c \
+	../../core/arena.c \
 	../../core/cochran.c \
 	../../core/deco.c \
 	../../core/divesite.c \
 	../../core/equipment.c \
+	../../core/eventindex.c \
 	../../core/gas.c \
 	../../core/membuffer.c \
 	../../core/selection.cpp \
 	../../core/sha1.c \
+	../../core/sharedbuffer.cpp \
 	../../core/strtod.c \
+	../../core/stringpool.cpp \
 	../../core/tag.c \
 	../../core/taxonomy.c \
 	../../core/time.c \
+	../../core/tissuecache.cpp \
+	../../core/plotinfocache.cpp \
 	../../core/trip.c \
 	../../core/units.c \
 	../../core/uemis.c \
@@ -169,6 +176,7 @@ HEADERS += \
 	../../core/device.h \
 	../../core/devicedetails.h \
 	../../core/dive.h \
+	../../core/eventindex.h \
 	../../core/git-access.h \
 	../../core/gpslocation.h \
 	../../core/imagedownloader.h \
@@ -203,10 +211,14 @@ HEADERS += \
 	../../core/selection.h \
 	../../core/divecomputer.h \
 	../../core/sha1.h \
+	../../core/sharedbuffer.h \
 	../../core/strndup.h \
+	../../core/stringpool.h \
 	../../core/subsurfacestartup.h \
 	../../core/subsurfacesysinfo.h \
 	../../core/taxonomy.h \
+	../../core/tissuecache.h \
+	../../core/plotinfocache.h \
 	../../core/uemis.h \
 	../../core/webservice.h \
 	../../core/windowtitleupdate.h \
@@ -217,6 +229,8 @@ HEADERS += \
 	../../core/connectionlistmodel.h \
 	../../core/qt-ble.h \
 	../../core/save-profiledata.h \
+	../../core/samplecolumns.h \
+	../../core/arena.h \
 	../../core/uploadDiveShare.h \
 	../../core/uploadDiveLogsDE.h \
 	../../core/settings/qPref.h \
@@ -234,10 +234,9 @@ bool DiveEventItem::shouldBeHidden()
 	 * Some gas change events are special. Some dive computers just tell us the initial gas this way.
 	 * Don't bother showing those
 	 */
-	struct sample *first_sample = &dc->sample[0];
 	if (!strcmp(event->name, "gaschange") &&
 	    (event->time.seconds == 0 ||
-	     (first_sample && event->time.seconds == first_sample->time.seconds) ||
+	     (dc->samples && event->time.seconds == get_sample(dc, 0).time.seconds) ||
 	     depthAtTime(event->time.seconds) < SURFACE_THRESHOLD))
 		return true;
 
@@ -4,6 +4,7 @@
 #include "profile-widget/divecartesianaxis.h"
 #include "profile-widget/divetextitem.h"
 #include "profile-widget/animationfunctions.h"
+#include "core/eventindex.h"
 #include "core/profile.h"
 #ifndef SUBSURFACE_MOBILE
 #include "desktop-widgets/preferences/preferencesdialog.h"
@@ -14,6 +15,57 @@
 #include "core/settings/qPrefLog.h"
 #include "libdivecomputer/parser.h"
 #include "profile-widget/profilewidget2.h"
+#include <QPainter>
+#include <cmath>
+
+const QVector<int> &PolylineLod::indices(const QPolygonF &poly, const QPainter *painter)
+{
+	// The polygons are only replaced, never modified. Thus, a new polyline has new data.
+	if (poly.constData() != source.constData() || poly.size() != source.size()) {
+		source = poly;
+		levels.clear();
+	}
+
+	// Use pixel columns of a power of two width in item coordinates, so that
+	// a zoom level can be reused for all scales up to the next power of two.
+	// The columns are along the time axis, so only the horizontal scale counts.
+	qreal scale = fabs(painter->worldTransform().m11());
+	int level = scale > 0.0 ? (int)floor(log2(1.0 / scale)) : 0;
+	auto it = levels.find(level);
+	if (it != levels.end())
+		return it->second;
+
+	QVector<int> &res = levels[level];
+	qreal width = ldexp(1.0, level);
+	for (int i = 0, n = poly.size(); i < n; ) {
+		qreal column = floor(poly[i].x() / width);
+		int first = i, lowest = i, highest = i;
+		for (++i; i < n && floor(poly[i].x() / width) == column; ++i) {
+			if (poly[i].y() < poly[lowest].y())
+				lowest = i;
+			if (poly[i].y() > poly[highest].y())
+				highest = i;
+		}
+		// Keep the points in the order of the polyline
+		for (int idx: { first, std::min(lowest, highest), std::max(lowest, highest), i - 1 }) {
+			if (res.isEmpty() || idx > res.last())
+				res.append(idx);
+		}
+	}
+	return res;
+}
+
+QPolygonF PolylineLod::polyline(const QPolygonF &poly, const QPainter *painter)
+{
+	const QVector<int> &idx = indices(poly, painter);
+	if (idx.size() == poly.size())
+		return poly;
+	QPolygonF res;
+	res.reserve(idx.size());
+	for (int i: idx)
+		res.append(poly[i]);
+	return res;
+}
 
 AbstractProfilePolygonItem::AbstractProfilePolygonItem() : QObject(), QGraphicsPolygonItem(), hAxis(NULL), vAxis(NULL), dataModel(NULL), hDataColumn(-1), vDataColumn(-1)
 {
@@ -91,6 +143,20 @@ bool AbstractProfilePolygonItem::shouldCalculateStuff(const QModelIndex &topLeft
 	return true;
 }
 
+QPolygonF AbstractProfilePolygonItem::lodPolygon(const QPainter *painter)
+{
+	return lod.polyline(polygon(), painter);
+}
+
+void AbstractProfilePolygonItem::paintLodPolygon(QPainter *painter)
+{
+	painter->save();
+	painter->setPen(pen());
+	painter->setBrush(brush());
+	painter->drawPolygon(lodPolygon(painter), fillRule());
+	painter->restore();
+}
+
 void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex&, const QModelIndex&)
 {
 	// Calculate the polygon. This is the polygon that will be painted on screen
@@ -122,7 +188,7 @@ void DiveProfileItem::settingsToggled(bool)
 	settingsChanged();
 }
 
-void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
 	if (polygon().isEmpty())
 		return;
@@ -131,21 +197,23 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	// This paints the Polygon + Background. I'm setting the pen to QPen() so we don't get a black line here,
 	// after all we need to plot the correct velocities colors later.
 	setPen(Qt::NoPen);
-	QGraphicsPolygonItem::paint(painter, option, widget);
+	paintLodPolygon(painter);
 
 	// Here we actually paint the boundaries of the Polygon using the colors that the model provides.
-	// Those are the speed colors of the dives.
+	// Those are the speed colors of the dives. Of the segments simplified into one, the color of
+	// the last one is used.
 	QPen pen;
 	pen.setCosmetic(true);
 	pen.setWidth(2);
-	QPolygonF poly = polygon();
+	const QPolygonF poly = polygon();
+	const QVector<int> &idx = lod.indices(poly, painter);
 	// This paints the colors of the velocities.
-	for (int i = 1, count = dataModel->rowCount(); i < count; i++) {
+	for (int j = 1, count = dataModel->rowCount(); j < idx.size() && idx[j] < count; j++) {
+		int i = idx[j];
 		QModelIndex colorIndex = dataModel->index(i, DivePlotDataModel::COLOR);
 		pen.setBrush(QBrush(colorIndex.data(Qt::BackgroundRole).value<QColor>()));
 		painter->setPen(pen);
-		if (i < poly.count())
-			painter->drawLine(poly[i - 1], poly[i]);
+		painter->drawLine(poly[idx[j - 1]], poly[i]);
 	}
 	painter->restore();
 }
@@ -153,10 +221,10 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 int DiveProfileItem::maxCeiling(int row)
 {
 	int max = -1;
-	plot_data *entry = dataModel->data().entry + row;
+	const plot_deco_data *deco = get_plot_deco_data(&dataModel->data(), row);
 	for (int tissue = 0; tissue < 16; tissue++) {
-		if (max < entry->ceilings[tissue])
-			max = entry->ceilings[tissue];
+		if (max < deco->ceilings[tissue])
+			max = deco->ceilings[tissue];
 	}
 	return max;
 }
@@ -343,7 +411,7 @@ void DiveHeartrateItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*
 		return;
 	painter->save();
 	painter->setPen(pen());
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 	painter->restore();
 }
 
@@ -407,9 +475,13 @@ void DivePercentageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem
 	QPen mypen;
 	mypen.setCapStyle(Qt::FlatCap);
 	mypen.setCosmetic(false);
-	QPolygonF poly = polygon();
-	for (int i = 1, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		if (i < poly.count()) {
+	const QPolygonF poly = polygon();
+	const QVector<int> &idx = lod.indices(poly, painter);
+	struct event_lookups lookups;
+	begin_event_lookups(&lookups, displayed_dc);
+	for (int j = 1, modelDataCount = dataModel->rowCount(); j < idx.size(); j++) {
+		int i = idx[j];
+		if (i < modelDataCount) {
 			double value = dataModel->index(i, vDataColumn).data().toDouble();
 			struct gasmix gasmix = gasmix_air;
 			const struct event *ev = NULL;
@@ -418,9 +490,10 @@ void DivePercentageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem
 			int inert = 1000 - get_o2(gasmix);
 			mypen.setBrush(QBrush(ColorScale(value, inert)));
 			painter->setPen(mypen);
-			painter->drawLine(poly[i - 1], poly[i]);
+			painter->drawLine(poly[idx[j - 1]], poly[i]);
 		}
 	}
+	end_event_lookups(&lookups);
 	painter->restore();
 }
 
@@ -464,7 +537,7 @@ void DiveAmbPressureItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 		return;
 	painter->save();
 	painter->setPen(pen());
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 	painter->restore();
 	connect(qPrefTechnicalDetails::instance(), &qPrefTechnicalDetails::percentagegraphChanged, this, &DiveAmbPressureItem::setVisible);
 }
@@ -509,7 +582,7 @@ void DiveGFLineItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*, Q
 		return;
 	painter->save();
 	painter->setPen(pen());
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 	painter->restore();
 	connect(qPrefTechnicalDetails::instance(), &qPrefTechnicalDetails::percentagegraphChanged, this, &DiveAmbPressureItem::setVisible);
 }
@@ -589,7 +662,7 @@ void DiveTemperatureItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 		return;
 	painter->save();
 	painter->setPen(pen());
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 	painter->restore();
 }
 
@@ -634,7 +707,7 @@ void DiveMeanDepthItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*
 		return;
 	painter->save();
 	painter->setPen(pen());
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 	painter->restore();
 	connect(qPrefLog::instance(), &qPrefLog::show_average_depthChanged, this, &DiveAmbPressureItem::setVisible);
 }
@@ -801,10 +874,14 @@ void DiveGasPressureItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 	pen.setCosmetic(true);
 	pen.setWidth(2);
 	painter->save();
-	struct plot_data *entry;
-	Q_FOREACH (const QPolygonF &poly, polygons) {
-		entry = dataModel->data().entry;
-		for (int i = 1, count = poly.count(); i < count; i++, entry++) {
+	polygonLods.resize(polygons.size());
+	for (int p = 0; p < polygons.size(); p++) {
+		const QPolygonF &poly = polygons[p];
+		const QVector<int> &idx = polygonLods[p].indices(poly, painter);
+		for (int j = 1; j < idx.size(); j++) {
+			int i = idx[j];
+			const struct plot_data *entry = dataModel->data().entry + i - 1;
+			const struct plot_gas_data *gas = get_plot_gas_data(&dataModel->data(), i - 1);
 			if (!in_planner()) {
 				if (entry->sac)
 					pen.setBrush(getSacColor(entry->sac, displayed_dive.sac));
@@ -814,10 +891,10 @@ void DiveGasPressureItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 				if (vAxis->valueAt(poly[i]) < 0)
 					pen.setBrush(MAGENTA);
 				else
-					pen.setBrush(getPressureColor(entry->density));
+					pen.setBrush(getPressureColor(gas->density));
 			}
 			painter->setPen(pen);
-			painter->drawLine(poly[i - 1], poly[i]);
+			painter->drawLine(poly[idx[j - 1]], poly[i]);
 		}
 	}
 	painter->restore();
@@ -858,11 +935,11 @@ void DiveCalculatedCeiling::modelDataChanged(const QModelIndex &topLeft, const Q
 	setBrush(pat);
 }
 
-void DiveCalculatedCeiling::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+void DiveCalculatedCeiling::paint(QPainter *painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
 	if (polygon().isEmpty())
 		return;
-	QGraphicsPolygonItem::paint(painter, option, widget);
+	paintLodPolygon(painter);
 }
 
 DiveCalculatedTissue::DiveCalculatedTissue(ProfileWidget2 *widget) : DiveCalculatedCeiling(widget)
@@ -934,11 +1011,11 @@ void DiveCalculatedCeiling::settingsChanged()
 	is3mIncrement = prefs.calcceiling3m;
 }
 
-void DiveReportedCeiling::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+void DiveReportedCeiling::paint(QPainter *painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
 	if (polygon().isEmpty())
 		return;
-	QGraphicsPolygonItem::paint(painter, option, widget);
+	paintLodPolygon(painter);
 }
 
 void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
@@ -996,12 +1073,12 @@ void PartialPressureGasItem::paint(QPainter *painter, const QStyleOptionGraphics
 	const qreal pWidth = 0.0;
 	painter->save();
 	painter->setPen(QPen(normalColor, pWidth));
-	painter->drawPolyline(polygon());
+	painter->drawPolyline(lodPolygon(painter));
 
-	QPolygonF poly;
 	painter->setPen(QPen(alertColor, pWidth));
-	Q_FOREACH (const QPolygonF &poly, alertPolygons)
-		painter->drawPolyline(poly);
+	alertPolygonLods.resize(alertPolygons.size());
+	for (int i = 0; i < alertPolygons.size(); i++)
+		painter->drawPolyline(alertPolygonLods[i].polyline(alertPolygons[i], painter));
 	painter->restore();
 }
 
@@ -5,6 +5,8 @@
 #include <QObject>
 #include <QGraphicsPolygonItem>
 #include <QModelIndex>
+#include <map>
+#include <vector>
 
 #include "divelineitem.h"
 
@@ -29,6 +31,22 @@ class DiveCartesianAxis;
 class QAbstractTableModel;
 struct plot_data;
 
+// Simplified versions of a polyline for painting at the current zoom level.
+// Of consecutive points that fall into the same pixel column, only the first,
+// the last, the lowest and the highest are kept. That looks the same as the
+// full polyline, but the painting cost scales with the width of the view
+// instead of the number of samples. The simplification for a zoom level is
+// calculated when it is first painted and kept until the polyline changes.
+class PolylineLod {
+public:
+	// Indices of the points that are painted at the horizontal scale of the painter
+	const QVector<int> &indices(const QPolygonF &poly, const QPainter *painter);
+	QPolygonF polyline(const QPolygonF &poly, const QPainter *painter);
+private:
+	QPolygonF source;
+	std::map<int, QVector<int>> levels; // indexed by the binary logarithm of the column width
+};
+
 class AbstractProfilePolygonItem : public QObject, public QGraphicsPolygonItem {
 	Q_OBJECT
 	Q_PROPERTY(QPointF pos WRITE setPos READ pos)
@@ -58,6 +76,10 @@ protected:
 	 * 'do not recalculate, we already have the right data.
 	 */
 	bool shouldCalculateStuff(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+	// The polygon of the item, simplified for the current zoom level
+	QPolygonF lodPolygon(const QPainter *painter);
+	// Paints the simplified polygon with the pen and brush of the item
+	void paintLodPolygon(QPainter *painter);
 
 	DiveCartesianAxis *hAxis;
 	DiveCartesianAxis *vAxis;
@@ -65,6 +87,7 @@ protected:
 	int hDataColumn;
 	int vDataColumn;
 	QList<DiveTextItem *> texts;
+	PolylineLod lod;
 };
 
 class DiveProfileItem : public AbstractProfilePolygonItem {
@@ -168,6 +191,7 @@ private:
 	void plotPressureValue(int mbar, int sec, QFlags<Qt::AlignmentFlag> align, double offset);
 	void plotGasValue(int mbar, int sec, struct gasmix gasmix, QFlags<Qt::AlignmentFlag> align, double offset);
 	QVector<QPolygonF> polygons;
+	std::vector<PolylineLod> polygonLods;
 };
 
 class DiveCalculatedCeiling : public AbstractProfilePolygonItem {
@@ -219,6 +243,7 @@ public:
 
 private:
 	QVector<QPolygonF> alertPolygons;
+	std::vector<PolylineLod> alertPolygonLods;
 	const double *thresholdPtrMin;
 	const double *thresholdPtrMax;
 	QString visibilityKey;
@@ -218,14 +218,16 @@ void ToolTipItem::readPos()
 	setPos(value);
 }
 
-void ToolTipItem::setPlotInfo(const plot_info &plot)
+void ToolTipItem::setPlotInfo(plot_info &plot, unsigned int pendingChannelsIn)
 {
-	pInfo = plot;
+	pInfo = &plot;
+	pendingChannels = pendingChannelsIn;
 }
 
 void ToolTipItem::clearPlotInfo()
 {
-	memset(&pInfo, 0, sizeof(pInfo));
+	pInfo = nullptr;
+	pendingChannels = 0;
 }
 
 void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
@@ -249,7 +251,13 @@ void ToolTipItem::refresh(const QPointF &pos)
 	clear();
 
 	mb.len = 0;
-	int idx = get_plot_details_new(&pInfo, time, &mb);
+	int idx = 0;
+	if (pInfo) {
+		// The tissue graph and the details need the deco and gas data, even if no graph shows them.
+		// Data that are calculated in the background are shown when the profile hands them over.
+		plot_info_need(pInfo, (PLOT_DECO | PLOT_GAS) & ~pendingChannels);
+		idx = get_plot_details_new(pInfo, time, &mb);
+	}
 
 	tissues.fill();
 	painter.setPen(QColor(0, 0, 0, 0));
@@ -263,15 +271,18 @@ void ToolTipItem::refresh(const QPointF &pos)
 		ProfileWidget2 *view = qobject_cast<ProfileWidget2*>(scene()->views().first());
 		Q_ASSERT(view);
 
-		const struct plot_data *entry = &pInfo.entry[idx];
-		painter.setPen(QColor(0, 0, 0, 255));
-		if (decoMode() == BUEHLMANN)
-			painter.drawLine(0, lrint(60 - entry->gfline / 2), 16, lrint(60 - entry->gfline / 2));
-		painter.drawLine(0, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure / 2),
-				16, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure /2));
-		painter.setPen(QColor(0, 0, 0, 127));
-		for (int i=0; i<16; i++) {
-			painter.drawLine(i, 60, i, 60 - entry->percentages[i] / 2);
+		const struct plot_data *entry = &pInfo->entry[idx];
+		const struct plot_deco_data *deco = get_plot_deco_data(pInfo, idx);
+		if (pInfo->channels & PLOT_DECO) {
+			painter.setPen(QColor(0, 0, 0, 255));
+			if (decoMode() == BUEHLMANN)
+				painter.drawLine(0, lrint(60 - deco->gfline / 2), 16, lrint(60 - deco->gfline / 2));
+			painter.drawLine(0, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / deco->ambpressure / 2),
+					16, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / deco->ambpressure /2));
+			painter.setPen(QColor(0, 0, 0, 127));
+			for (int i=0; i<16; i++) {
+				painter.drawLine(i, 60, i, 60 - deco->percentages[i] / 2);
+			}
 		}
 		entryToolTip.second->setText(QString::fromUtf8(mb.buffer, mb.len));
 	}
@@ -43,7 +43,7 @@ public:
 	void mousePressEvent(QGraphicsSceneMouseEvent *event);
 	void mouseReleaseEvent(QGraphicsSceneMouseEvent *event);
 	void setTimeAxis(DiveCartesianAxis *axis);
-	void setPlotInfo(const plot_info &plot);
+	void setPlotInfo(plot_info &plot, unsigned int pendingChannels = 0);
 	void clearPlotInfo();
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
 public
@@ -59,7 +59,8 @@ private:
 	QRectF rectangle;
 	QRectF nextRectangle;
 	DiveCartesianAxis *timeAxis;
-	plot_info pInfo;
+	plot_info *pInfo; // the plot info of the profile, which calculates missing data on demand
+	unsigned int pendingChannels; // the data that are being calculated in the background
 	int lastTime;
 	QTime refreshTime;
 	QList<QGraphicsItem*> oldSelection;
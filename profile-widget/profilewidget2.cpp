@@ -4,6 +4,8 @@
 #include "core/subsurface-string.h"
 #include "core/qthelper.h"
 #include "core/profile.h"
+#include "core/plotinfocache.h"
+#include "core/deco.h"
 #include "core/settings/qPrefDisplay.h"
 #include "core/settings/qPrefTechnicalDetails.h"
 #include "core/settings/qPrefPartialPressureGas.h"
@@ -39,7 +41,7 @@
 #include <QDebug>
 #include <QWheelEvent>
 #include <QMenu>
-#include <QElapsedTimer>
+#include <QtConcurrentRun>
 
 #ifndef QT_NO_DEBUG
 #include <QTableView>
@@ -51,6 +53,20 @@
 
 #define PP_GRAPHS_ENABLED (prefs.pp_graphs.po2 || prefs.pp_graphs.pn2 || prefs.pp_graphs.phe)
 
+// The derived plot data that the graphs shown with the current preferences need.
+// The tool tip calculates the data that only it shows when it is first displayed.
+static unsigned int plotChannels(bool fast)
+{
+	unsigned int channels = PLOT_SAC;
+	if (!fast)
+		channels |= PLOT_PRESSURE;
+	if (in_planner() || prefs.calcceiling || prefs.calcalltissues || prefs.calcndltts || prefs.percentagegraph)
+		channels |= PLOT_DECO;
+	if (in_planner() || PP_GRAPHS_ENABLED || prefs.show_scr_ocpo2)
+		channels |= PLOT_GAS;
+	return channels;
+}
+
 // a couple of helpers we need
 extern bool haveFilesOnCommandLine();
 
@@ -137,6 +153,7 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	mouseFollowerVertical(new DiveLineItem()),
 	mouseFollowerHorizontal(new DiveLineItem()),
 	rulerItem(new RulerItem2()),
+	pendingChannels(0),
 #endif
 	tankItem(new TankItem()),
 	isGrayscale(false),
@@ -169,6 +186,7 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	connect(DivePictureModel::instance(), &DivePictureModel::rowsInserted, this, &ProfileWidget2::plotPictures);
 	connect(DivePictureModel::instance(), &DivePictureModel::picturesRemoved, this, &ProfileWidget2::removePictures);
 	connect(DivePictureModel::instance(), &DivePictureModel::modelReset, this, &ProfileWidget2::plotPictures);
+	connect(&plotWatcher, &QFutureWatcher<std::shared_ptr<PlotCalculation>>::finished, this, &ProfileWidget2::backgroundCalculationDone);
 #endif // SUBSURFACE_MOBILE
 
 #if !defined(QT_NO_DEBUG) && defined(SHOW_PLOT_INFO_TABLE)
@@ -180,6 +198,9 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 
 ProfileWidget2::~ProfileWidget2()
 {
+#ifndef SUBSURFACE_MOBILE
+	cancelBackgroundCalculation();
+#endif
 	free_plot_info_data(&plotInfo);
 }
 
@@ -557,10 +578,7 @@ void ProfileWidget2::resetZoom()
 void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPictures, bool instant)
 {
 	static bool firstCall = true;
-#ifndef SUBSURFACE_MOBILE
-	QElapsedTimer measureDuration; // let's measure how long this takes us (maybe we'll turn of TTL calculation later
-	measureDuration.start();
-#else
+#ifdef SUBSURFACE_MOBILE
 	Q_UNUSED(doClearPictures);
 #endif
 	if (currentState != ADD && currentState != PLAN) {
@@ -643,9 +661,24 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 
 	// create_plot_info_new() automatically frees old plot data
 #ifndef SUBSURFACE_MOBILE
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, &DivePlannerPointsModel::instance()->final_deco_state);
+	// When viewing a dive, the deco data, which take by far the longest to calculate,
+	// are calculated in the background. The profile is first shown without them.
+	// The plot infos of recently viewed dives are taken from the cache.
+	unsigned int channels = plotChannels(!shouldCalculateMaxDepth);
+	bool background = (channels & PLOT_DECO) && currentState != ADD && currentState != PLAN && !printMode;
+	if (background && get_cached_plot_info(&displayed_dive, currentdc, dc_number, channels, &plotInfo)) {
+		cancelBackgroundCalculation();
+		plotInfo.planner_ds = &DivePlannerPointsModel::instance()->final_deco_state;
+		background = false;
+	} else if (background) {
+		create_plot_info_new(&displayed_dive, currentdc, &plotInfo, channels & ~PLOT_DECO, &DivePlannerPointsModel::instance()->final_deco_state);
+		calculateInBackground();
+	} else {
+		cancelBackgroundCalculation();
+		create_plot_info_new(&displayed_dive, currentdc, &plotInfo, channels, &DivePlannerPointsModel::instance()->final_deco_state);
+	}
 #else
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, nullptr);
+	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, plotChannels(!shouldCalculateMaxDepth), nullptr);
 #endif
 	int newMaxtime = get_maxtime(&plotInfo);
 	if (shouldCalculateMaxTime || newMaxtime > maxtime)
@@ -666,7 +699,7 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 
 	dataModel->setDive(&displayed_dive, plotInfo);
 #ifndef SUBSURFACE_MOBILE
-	toolTipItem->setPlotInfo(plotInfo);
+	toolTipItem->setPlotInfo(plotInfo, pendingChannels);
 #endif
 	// It seems that I'll have a lot of boilerplate setting the model / axis for
 	// each item, I'll mostly like to fix this in the future, but I'll keep at this for now.
@@ -833,17 +866,96 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 
 	toolTipItem->refresh(mapToScene(mapFromGlobal(QCursor::pos())));
 #endif
+}
 
-	// OK, how long did this take us? Anything above the second is way too long,
-	// so if we are calculation TTS / NDL then let's force that off.
 #ifndef SUBSURFACE_MOBILE
-	if (measureDuration.elapsed() > 1000 && prefs.calcndltts) {
-		qPrefTechnicalDetails::set_calcndltts(false);
-		report_error(qPrintable(tr("Show NDL / TTS was disabled because of excessive processing time")));
+// A copy of the displayed dive and its plot info, which is calculated in a worker thread.
+struct ProfileWidget2::PlotCalculation {
+	struct dive *dive;
+	struct plot_info pi;
+	CancellationToken cancelled;
+	PlotCalculation(CancellationToken cancelledIn) : dive(alloc_dive()), cancelled(cancelledIn)
+	{
+		init_plot_info(&pi);
 	}
-#endif
+	~PlotCalculation()
+	{
+		free_plot_info_data(&pi);
+		free_dive(dive);
+	}
+};
+
+// Cancels the running background calculation and, if any, throws away its result.
+void ProfileWidget2::cancelBackgroundCalculation()
+{
+	if (plotCancelled)
+		*plotCancelled = true;
+	plotCancelled.reset();
+	pendingChannels = 0;
 }
 
+static bool calculationCancelled(void *cancelled)
+{
+	return *static_cast<const std::atomic<bool> *>(cancelled);
+}
+
+// Starts the calculation of the deco data of the displayed dive in a worker thread.
+// The worker continues from a copy of the plot info of the profile, which refers to a copy
+// of the dive, so that the displayed dive may change in the meantime. The tissues at the
+// start of the dive are calculated here, because that accesses the other dives of the log.
+// Thanks to the tissue cache, that is fast.
+void ProfileWidget2::calculateInBackground()
+{
+	cancelBackgroundCalculation();
+	plotCancelled = std::make_shared<std::atomic<bool>>(false);
+	pendingChannels = PLOT_DECO;
+
+	auto calc = std::make_shared<PlotCalculation>(plotCancelled);
+	copy_dive(&displayed_dive, calc->dive);
+	copy_plot_info_data(&calc->pi, &plotInfo);
+	calc->pi.dive = calc->dive;
+	calc->pi.dc = get_dive_dc(calc->dive, dc_number);
+	calc->pi.planner_ds = nullptr;
+	struct deco_state ds;
+	init_deco_config(&ds.config, in_planner());
+	init_decompression(&ds, &displayed_dive);
+
+	plotWatcher.setFuture(QtConcurrent::run([calc, ds]() {
+		if (!*calc->cancelled)
+			plot_info_need_from_tissues(&calc->pi, PLOT_DECO, &ds, calculationCancelled, calc->cancelled.get());
+		return calc;
+	}));
+}
+
+void ProfileWidget2::backgroundCalculationDone()
+{
+	std::shared_ptr<PlotCalculation> calc = plotWatcher.result();
+	if (!calc || *calc->cancelled || calc->cancelled != plotCancelled)
+		return;
+	plotCancelled.reset();
+	pendingChannels = 0;
+
+	// Take over the plot info and make it refer to the displayed dive, which equals the copy.
+	// The tool tip may have calculated further channels in the meantime.
+	unsigned int channels = plotInfo.channels;
+	free_plot_info_data(&plotInfo);
+	plotInfo = calc->pi;
+	init_plot_info(&calc->pi);
+	plotInfo.dive = &displayed_dive;
+	plotInfo.dc = select_dc(&displayed_dive);
+	plotInfo.planner_ds = &DivePlannerPointsModel::instance()->final_deco_state;
+	plot_info_need(&plotInfo, channels);
+	cache_plot_info(&displayed_dive, dc_number, &plotInfo);
+
+	dataModel->setDive(&displayed_dive, plotInfo);
+	toolTipItem->setPlotInfo(plotInfo);
+	rulerItem->setPlotInfo(plotInfo);
+	tankItem->setData(dataModel, &plotInfo, &displayed_dive);
+	dataModel->emitDataChanged();
+	toolTipItem->refresh(mapToScene(mapFromGlobal(QCursor::pos())));
+}
+#endif
+
 void ProfileWidget2::dateTimeChanged()
 {
 	emit dateTimeChangedItems();
@@ -866,6 +978,13 @@ void ProfileWidget2::settingsChanged()
 		needReplot = true;
 	else
 		needReplot = prefs.calcceiling;
+	// newly enabled graphs may need data that were not calculated
+	unsigned int channels = plotInfo.channels;
+#ifndef SUBSURFACE_MOBILE
+	channels |= pendingChannels;
+#endif
+	if (plotChannels(false) & ~channels)
+		needReplot = true;
 #ifndef SUBSURFACE_MOBILE
 	gasYAxis->settingsChanged();	// Initialize ticks of partial pressure graph
 	if ((prefs.percentagegraph||prefs.hrgraph) && PP_GRAPHS_ENABLED) {
@@ -1109,6 +1228,9 @@ void ProfileWidget2::setEmptyState()
 		return;
 
 	disconnectTemporaryConnections();
+#ifndef SUBSURFACE_MOBILE
+	cancelBackgroundCalculation();
+#endif
 	setBackgroundBrush(getColor(::BACKGROUND, isGrayscale));
 	dataModel->clear();
 	currentState = EMPTY;
@@ -3,8 +3,10 @@
 #define PROFILEWIDGET2_H
 
 #include <QGraphicsView>
+#include <QFutureWatcher>
 #include <vector>
 #include <memory>
+#include <atomic>
 
 // /* The idea of this widget is to display and edit the profile.
 //  * It has:
@@ -175,6 +177,13 @@ private: /*methods*/
 			 const double *thresholdSettingsMin, const double *thresholdSettingsMax);
 	void clearPictures();
 	void plotPicturesInternal(const struct dive *d, bool synchronous);
+#ifndef SUBSURFACE_MOBILE
+	struct PlotCalculation;
+	using CancellationToken = std::shared_ptr<std::atomic<bool>>;
+	void calculateInBackground();
+	void cancelBackgroundCalculation();
+	void backgroundCalculationDone();
+#endif
 private:
 	DivePlotDataModel *dataModel;
 	int zoomLevel;
@@ -223,6 +232,11 @@ private:
 	DiveLineItem *mouseFollowerVertical;
 	DiveLineItem *mouseFollowerHorizontal;
 	RulerItem2 *rulerItem;
+	// The deco data of the displayed dive are calculated in a worker thread
+	// from a copy of the dive and swapped into plotInfo once they are ready.
+	QFutureWatcher<std::shared_ptr<PlotCalculation>> plotWatcher;
+	CancellationToken plotCancelled;
+	unsigned int pendingChannels;
 #endif
 	TankItem *tankItem;
 	bool isGrayscale;
@@ -15,6 +15,7 @@
 #include <QApplication>
 #include <QTextDocument>
 #include <QtConcurrent>
+#include <vector>
 
 #define VARIATIONS_IN_BACKGROUND 1
 
@@ -104,7 +105,7 @@ void DivePlannerPointsModel::loadFromDive(dive *d)
 	bool hasMarkedSamples = false;
 
 	if (dc->samples)
-		hasMarkedSamples = dc->sample[0].manually_entered;
+		hasMarkedSamples = get_sample(dc, 0).manually_entered;
 	else
 		fake_dc(dc);
 
@@ -118,8 +119,8 @@ void DivePlannerPointsModel::loadFromDive(dive *d)
 		if (dc->last_manual_time.seconds && dc->last_manual_time.seconds > 120 && lasttime.seconds >= dc->last_manual_time.seconds)
 			break;
 		while (j * plansamples <= i * dc->samples) {
-			const sample &s = dc->sample[j];
-			const sample &prev = dc->sample[j-1];
+			const sample s = get_sample(dc, j);
+			const sample prev = get_sample(dc, j > 0 ? j - 1 : 0);
 			if (s.time.seconds != 0 && (!hasMarkedSamples || s.manually_entered)) {
 				depthsum += s.depth.mm;
 				last_sp = prev.setpoint;
@@ -216,12 +217,6 @@ void DivePlannerPointsModel::addCylinder_clicked()
 void DivePlannerPointsModel::setPlanMode(Mode m)
 {
 	mode = m;
-	// the planner may reset our GF settings that are used to show deco
-	// reset them to what's in the preferences
-	if (m != PLAN) {
-		set_gf(prefs.gflow, prefs.gfhigh);
-		set_vpmb_conservatism(prefs.vpmb_conservatism);
-	}
 }
 
 bool DivePlannerPointsModel::isPlanner()
@@ -914,22 +909,26 @@ void DivePlannerPointsModel::createTemporaryPlan()
 	if (recalcQ() && !diveplan_empty(&diveplan)) {
 		struct decostop stoptable[60];
 		struct deco_state plan_deco_state;
-		struct diveplan *plan_copy;
+
+		struct plan_config config;
 
 		memset(&plan_deco_state, 0, sizeof(struct deco_state));
-		plan(&plan_deco_state, &diveplan, &displayed_dive, DECOTIMESTEP, stoptable, &cache, isPlanner(), false);
-		plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
-		lock_planner();
-		cloneDiveplan(&diveplan, plan_copy);
-		unlock_planner();
+		init_plan_config(&config, in_planner());
+		plan(&plan_deco_state, &diveplan, &displayed_dive, &config, DECOTIMESTEP, stoptable, &cache, isPlanner(), false);
+		CancellationToken cancelled = newVariationsToken();
+		if (showVariations()) {
+			struct diveplan *plan_copy = copyPlan();
+			struct dive *dive = alloc_dive();
+			copy_dive(&displayed_dive, dive);
 #ifdef VARIATIONS_IN_BACKGROUND
-		// Since we're calling computeVariations asynchronously and plan_deco_state is allocated
-		// on the stack, it must be copied and freed by the worker-thread.
-		struct deco_state *plan_deco_state_copy = new deco_state(plan_deco_state);
-		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, plan_deco_state_copy);
+			// Since we're calling computeVariations asynchronously and plan_deco_state is allocated
+			// on the stack, it must be copied and freed by the worker-thread.
+			struct deco_state *plan_deco_state_copy = new deco_state(plan_deco_state);
+			QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, dive, plan_deco_state_copy, config, cancelled);
 #else
-		computeVariations(plan_copy, &plan_deco_state);
+			computeVariations(plan_copy, dive, &plan_deco_state, config, cancelled);
 #endif
+		}
 		final_deco_state = plan_deco_state;
 		emit calculatedPlanNotes();
 	}
@@ -1011,36 +1010,85 @@ int DivePlannerPointsModel::analyzeVariations(struct decostop *min, struct decos
 	return (leftsum + rightsum) / 2;
 }
 
-void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct deco_state *previous_ds)
+void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct dive *dive, struct deco_state *previous_ds, struct plan_config config, CancellationToken cancelled)
 {
-	computeVariations(original_plan, previous_ds);
+	computeVariations(original_plan, dive, previous_ds, config, cancelled);
 	delete previous_ds;
 }
 
-void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds)
+// Cancels the running variations computation and returns the token for a new one
+DivePlannerPointsModel::CancellationToken DivePlannerPointsModel::newVariationsToken()
 {
-	// nothing to do unless there's an original plan
-	if (!original_plan)
-		return;
+	if (variationsCancelled)
+		*variationsCancelled = true;
+	variationsCancelled = std::make_shared<std::atomic<bool>>(false);
+	return variationsCancelled;
+}
+
+namespace {
+	// The variations of a plan are independent: each one works on its
+	// own copy of the dive, the plan and the deco state.
+	struct PlanVariation {
+		struct diveplan plan;
+		struct decostop stoptable[60];
+		const struct dive *dive;
+		const struct deco_state *ds;
+		const struct plan_config *config;
+		const std::atomic<bool> *cancelled;
+	};
+
+	enum Variation {
+		ORIGINAL,
+		DEEPER,
+		SHALLOWER,
+		LONGER,
+		SHORTER,
+		VARIATION_COUNT
+	};
+}
 
+static void computePlanVariation(PlanVariation &variation)
+{
+	if (*variation.cancelled)
+		return;
 	struct dive *dive = alloc_dive();
-	copy_dive(&displayed_dive, dive);
-	struct decostop original[60], deeper[60], shallower[60], shorter[60], longer[60];
-	struct deco_state *cache = NULL, *save = NULL;
-	struct diveplan plan_copy;
-	struct divedatapoint *last_segment;
-	struct deco_state ds = *previous_ds;
+	copy_dive(variation.dive, dive);
+	struct deco_state ds = *variation.ds;
+	struct deco_state *cache = NULL;
+	plan(&ds, &variation.plan, dive, variation.config, 1, variation.stoptable, &cache, true, false);
+	free(cache);
+	free_dive(dive);
+}
+
+bool DivePlannerPointsModel::showVariations() const
+{
+	return in_planner() && prefs.display_variations && decoMode() != RECREATIONAL;
+}
 
-	if (in_planner() && prefs.display_variations && decoMode() != RECREATIONAL) {
-		int my_instance = ++instanceCounter;
-		cache_deco_state(&ds, &save);
+struct diveplan *DivePlannerPointsModel::copyPlan()
+{
+	struct diveplan *plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
+	lock_planner();
+	cloneDiveplan(&diveplan, plan_copy);
+	unlock_planner();
+	return plan_copy;
+}
 
+// Takes ownership of original_plan and dive. This may run off the GUI thread, and does not access
+// any global state: the dive and the plan are private copies made by the caller, the configuration
+// is a snapshot of the preferences and every variation plans on its own copies of the plan, the
+// dive and the deco state. The only shared data are the dive table and the tissue cache, through
+// the replay of the previous dives: the dive id index is only read on lookup and the tissue cache
+// is protected by a mutex.
+void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, struct dive *dive, const struct deco_state *previous_ds, const struct plan_config &config, CancellationToken cancelled)
+{
+	if (!*cancelled) {
 		duration_t delta_time = { .seconds = 60 };
 		QString time_units = tr("min");
 		depth_t delta_depth;
 		QString depth_units;
 
-		if (prefs.units.length == units::METERS) {
+		if (config.metric_stops) {
 			delta_depth.mm = 1000; // 1m
 			depth_units = tr("m");
 		} else {
@@ -1048,65 +1096,47 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 			depth_units = tr("ft");
 		}
 
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		if (!last_segment)
-			goto finish;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, original, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm += delta_depth.mm;
-		last_segment->next->depth.mm += delta_depth.mm;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, deeper, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm -= delta_depth.mm;
-		last_segment->next->depth.mm -= delta_depth.mm;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shallower, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time += delta_time.seconds;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, longer, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time -= delta_time.seconds;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shorter, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		char buf[200];
-		sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
-			FRACTION(analyzeVariations(shallower, original, deeper, qPrintable(depth_units)), 60), qPrintable(depth_units),
-			FRACTION(analyzeVariations(shorter, original, longer, qPrintable(time_units)), 60));
-
-		emit variationsComputed(QString(buf));
+		std::vector<PlanVariation> variations(VARIATION_COUNT);
+		struct divedatapoint *last_segment[VARIATION_COUNT];
+		for (int i = 0; i < VARIATION_COUNT; ++i) {
+			variations[i].dive = dive;
+			variations[i].ds = previous_ds;
+			variations[i].config = &config;
+			variations[i].cancelled = cancelled.get();
+			last_segment[i] = cloneDiveplan(original_plan, &variations[i].plan);
+		}
+
+		// All clones have the same structure
+		if (last_segment[ORIGINAL]) {
+			last_segment[DEEPER]->depth.mm += delta_depth.mm;
+			last_segment[DEEPER]->next->depth.mm += delta_depth.mm;
+			last_segment[SHALLOWER]->depth.mm -= delta_depth.mm;
+			last_segment[SHALLOWER]->next->depth.mm -= delta_depth.mm;
+			last_segment[LONGER]->next->time += delta_time.seconds;
+			last_segment[SHORTER]->next->time -= delta_time.seconds;
+
+			QtConcurrent::blockingMap(variations, computePlanVariation);
+
+			if (!*cancelled) {
+				char buf[200];
+				sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
+					FRACTION(analyzeVariations(variations[SHALLOWER].stoptable, variations[ORIGINAL].stoptable,
+								   variations[DEEPER].stoptable, qPrintable(depth_units)), 60), qPrintable(depth_units),
+					FRACTION(analyzeVariations(variations[SHORTER].stoptable, variations[ORIGINAL].stoptable,
+								   variations[LONGER].stoptable, qPrintable(time_units)), 60));
+
+				emit variationsComputed(QString(buf));
+			}
+		}
+		for (PlanVariation &variation: variations)
+			free_dps(&variation.plan);
 #ifdef DEBUG_STOPVAR
 		printf("\n\n");
 #endif
 	}
-finish:
 	free_dps(original_plan);
 	free(original_plan);
-	free(save);
-	free(cache);
-	free(dive);
+	free_dive(dive);
 //	setRecalc(oldRecalc);
 }
 
@@ -1121,13 +1151,15 @@ void DivePlannerPointsModel::createPlan(bool replanCopy)
 
 	//TODO: C-based function here?
 	struct decostop stoptable[60];
-	plan(&ds_after_previous_dives, &diveplan, &displayed_dive, DECOTIMESTEP, stoptable, &cache, isPlanner(), true);
-	struct diveplan *plan_copy;
-	plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
-	lock_planner();
-	cloneDiveplan(&diveplan, plan_copy);
-	unlock_planner();
-	computeVariations(plan_copy, &ds_after_previous_dives);
+	struct plan_config config;
+	init_plan_config(&config, in_planner());
+	plan(&ds_after_previous_dives, &diveplan, &displayed_dive, &config, DECOTIMESTEP, stoptable, &cache, isPlanner(), true);
+	CancellationToken cancelled = newVariationsToken();
+	if (showVariations()) {
+		struct dive *dive = alloc_dive();
+		copy_dive(&displayed_dive, dive);
+		computeVariations(copyPlan(), dive, &ds_after_previous_dives, config, cancelled);
+	}
 
 	free(cache);
 
@@ -4,6 +4,8 @@
 
 #include <QAbstractTableModel>
 #include <QDateTime>
+#include <atomic>
+#include <memory>
 
 #include "core/deco.h"
 #include "core/planner.h"
@@ -117,14 +119,19 @@ private:
 	void createPlan(bool replanCopy);
 	struct diveplan diveplan;
 	struct divedatapoint *cloneDiveplan(struct diveplan *plan_src, struct diveplan *plan_copy);
-	void computeVariations(struct diveplan *diveplan, const struct deco_state *ds);
-	void computeVariationsFreeDeco(struct diveplan *diveplan, struct deco_state *ds);
+	// Set when the variations are outdated, because a new computation was started
+	using CancellationToken = std::shared_ptr<std::atomic<bool>>;
+	CancellationToken newVariationsToken();
+	bool showVariations() const;
+	struct diveplan *copyPlan();
+	void computeVariations(struct diveplan *diveplan, struct dive *dive, const struct deco_state *ds, const struct plan_config &config, CancellationToken cancelled);
+	void computeVariationsFreeDeco(struct diveplan *diveplan, struct dive *dive, struct deco_state *ds, struct plan_config config, CancellationToken cancelled);
 	int analyzeVariations(struct decostop *min, struct decostop *mid, struct decostop *max, const char *unit);
 	Mode mode;
 	bool recalc;
 	QVector<divedatapoint> divepoints;
 	QDateTime startTime;
-	int instanceCounter = 0;
+	CancellationToken variationsCancelled;
 	struct deco_state ds_after_previous_dives;
 };
 
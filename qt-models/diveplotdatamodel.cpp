@@ -3,7 +3,9 @@
 #include "qt-models/diveplannermodel.h"
 #include "core/profile.h"
 #include "core/divelist.h"
+#include "core/eventindex.h"
 #include "core/color.h"
+#include "core/qthelper.h"
 
 DivePlotDataModel::DivePlotDataModel(QObject *parent) :
 	QAbstractTableModel(parent),
@@ -30,6 +32,7 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 		return QVariant();
 
 	plot_data item = pInfo.entry[index.row()];
+	const plot_deco_data &deco = *get_plot_deco_data(&pInfo, index.row());
 	if (role == Qt::DisplayRole) {
 		switch (index.column()) {
 		case DEPTH:
@@ -73,18 +76,18 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 		case AMBPRESSURE:
 			return AMB_PERCENTAGE;
 		case GFLINE:
-			return item.gfline;
+			return deco.gfline;
 		case INSTANT_MEANDEPTH:
 			return item.running_sum;
 		}
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= TISSUE_1 && index.column() <= TISSUE_16) {
-		return item.ceilings[index.column() - TISSUE_1];
+		return deco.ceilings[index.column() - TISSUE_1];
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= PERCENTAGE_1 && index.column() <= PERCENTAGE_16) {
-		return item.percentages[index.column() - PERCENTAGE_1];
+		return deco.percentages[index.column() - PERCENTAGE_1];
 	}
 
 	if (role == Qt::BackgroundRole) {
@@ -174,8 +177,12 @@ void DivePlotDataModel::clear()
 		pInfo.nr = 0;
 		free(pInfo.entry);
 		free(pInfo.pressures);
+		free(pInfo.deco);
+		free(pInfo.gas);
 		pInfo.entry = nullptr;
 		pInfo.pressures = nullptr;
+		pInfo.deco = nullptr;
+		pInfo.gas = nullptr;
 		diveId = -1;
 		dcNr = -1;
 		endRemoveRows();
@@ -187,13 +194,7 @@ void DivePlotDataModel::setDive(dive *d, const plot_info &info)
 	beginResetModel();
 	diveId = d->id;
 	dcNr = dc_number;
-	free(pInfo.entry);
-	free(pInfo.pressures);
-	pInfo = info;
-	pInfo.entry = (plot_data *)malloc(sizeof(plot_data) * pInfo.nr);
-	memcpy(pInfo.entry, info.entry, sizeof(plot_data) * pInfo.nr);
-	pInfo.pressures = (plot_pressure_data *)malloc(sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
-	memcpy(pInfo.pressures, info.pressures, sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
+	copy_plot_info_data(&pInfo, &info);
 	endResetModel();
 }
 
@@ -226,8 +227,12 @@ void DivePlotDataModel::emitDataChanged()
 void DivePlotDataModel::calculateDecompression()
 {
 	struct divecomputer *dc = select_dc(&displayed_dive);
+	init_deco_config(&plot_deco_state.config, in_planner());
 	init_decompression(&plot_deco_state, &displayed_dive);
-	calculate_deco_information(&plot_deco_state, &(DivePlannerPointsModel::instance()->final_deco_state), &displayed_dive, dc, &pInfo, false);
+	struct event_lookups lookups;
+	begin_event_lookups(&lookups, dc);
+	calculate_deco_information(&plot_deco_state, &(DivePlannerPointsModel::instance()->final_deco_state), &displayed_dive, dc, &pInfo, false, nullptr, nullptr);
+	end_event_lookups(&lookups);
 	dataChanged(index(0, CEILING), index(pInfo.nr - 1, TISSUE_16));
 }
 #endif
@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdecoperformance.h"
+#include "core/deco.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/planner.h"
+#include "core/profile.h"
+#include "core/qthelper.h"
+#include "core/subsurfacestartup.h"
+#include "core/tissuecache.h"
+#include "core/version.h"
+#include "core/applicationstate.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cmath>
+#include <vector>
+
+// Benchmarks of the decompression calculations on synthetic dives. Besides the
+// QBENCHMARK output, the timings are written as JSON to the file given by the
+// SUBSURFACE_BENCHMARK_JSON environment variable, if set, so that they can be
+// compared between releases.
+
+// Number of days of the synthetic log used for init_decompression(), with one of each dive per day
+#define LOG_DAYS 14
+
+static void setupRecreational(struct dive *d, struct diveplan *dp)
+{
+	struct gasmix ean32 = {{320}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(d, 0);
+	cyl0->gasmix = ean32;
+	cyl0->type.size.mliter = 12000;
+	cyl0->type.workingpressure.mbar = 232000;
+	reset_cylinders(d, true);
+
+	plan_add_segment(dp, 60, 18000, 0, 0, 1, OC);
+	plan_add_segment(dp, 20 * 60, 18000, 0, 0, 1, OC);
+	plan_add_segment(dp, 60, 14000, 0, 0, 1, OC);
+	plan_add_segment(dp, 15 * 60, 14000, 0, 0, 1, OC);
+	plan_add_segment(dp, 60, 10000, 0, 0, 1, OC);
+	plan_add_segment(dp, 10 * 60, 10000, 0, 0, 1, OC);
+}
+
+static void setupDeepTrimix(struct dive *d, struct diveplan *dp)
+{
+	struct gasmix tx12_60 = {{120}, {600}};
+	struct gasmix tx21_35 = {{210}, {350}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(d, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(d, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(d, 2);
+	cylinder_t *cyl3 = get_or_create_cylinder(d, 3);
+	cyl0->gasmix = tx12_60;
+	cyl0->type.size.mliter = 24000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = tx21_35;
+	cyl1->type.size.mliter = 11000;
+	cyl1->type.workingpressure.mbar = 200000;
+	cyl2->gasmix = ean50;
+	cyl2->type.size.mliter = 11000;
+	cyl2->type.workingpressure.mbar = 200000;
+	cyl3->gasmix = oxygen;
+	cyl3->type.size.mliter = 11000;
+	cyl3->type.workingpressure.mbar = 200000;
+	reset_cylinders(d, true);
+
+	plan_add_segment(dp, 0, gas_mod(tx21_35, po2, d, 3000).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, d, 3000).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, d, 3000).mm, 3, 0, 1, OC);
+	plan_add_segment(dp, 5 * 60, 90000, 0, 0, 1, OC);
+	plan_add_segment(dp, 20 * 60, 90000, 0, 0, 1, OC);
+}
+
+// The setpoint is switched from low to high at depth and raised for the shallower part of the dive
+static void setupCcr(struct dive *d, struct diveplan *dp)
+{
+	struct gasmix diluent = {{100}, {700}};
+	struct gasmix oxygen = {{1000}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(d, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(d, 1);
+	cyl0->gasmix = diluent;
+	cyl0->type.size.mliter = 3000;
+	cyl0->type.workingpressure.mbar = 200000;
+	cyl0->cylinder_use = DILUENT;
+	cyl1->gasmix = oxygen;
+	cyl1->type.size.mliter = 3000;
+	cyl1->type.workingpressure.mbar = 200000;
+	cyl1->cylinder_use = OXYGEN;
+	d->dc.divemode = CCR;
+	reset_cylinders(d, true);
+
+	plan_add_segment(dp, 2 * 60, 20000, 0, 700, 1, CCR);
+	plan_add_segment(dp, 3 * 60, 80000, 0, 1300, 1, CCR);
+	plan_add_segment(dp, 30 * 60, 80000, 0, 1300, 1, CCR);
+	plan_add_segment(dp, 3 * 60, 50000, 0, 1400, 1, CCR);
+	plan_add_segment(dp, 10 * 60, 50000, 0, 1400, 1, CCR);
+}
+
+// Nine hours at changing depths, followed by about an hour of deco
+static void setupCave(struct dive *d, struct diveplan *dp)
+{
+	const int depths[] = { 25000, 30000, 20000 };
+	struct gasmix ean32 = {{320}, {0}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(d, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(d, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(d, 2);
+	cyl0->gasmix = ean32;
+	cyl0->type.size.mliter = 200000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	cyl1->type.size.mliter = 11000;
+	cyl1->type.workingpressure.mbar = 200000;
+	cyl2->gasmix = oxygen;
+	cyl2->type.size.mliter = 11000;
+	cyl2->type.workingpressure.mbar = 200000;
+	reset_cylinders(d, true);
+
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, d, 3000).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, d, 3000).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, 2 * 60, depths[0], 0, 0, 1, OC);
+	for (int i = 0; i < 18; i++) {
+		plan_add_segment(dp, 60, depths[i % 3], 0, 0, 1, OC);
+		plan_add_segment(dp, 29 * 60, depths[i % 3], 0, 0, 1, OC);
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*setup)(struct dive *d, struct diveplan *dp);
+} syntheticDives[] = {
+	{ "recreational", setupRecreational },
+	{ "deep OC trimix", setupDeepTrimix },
+	{ "CCR", setupCcr },
+	{ "cave", setupCave }
+};
+
+#define NUM_DIVES (int)(sizeof(syntheticDives) / sizeof(syntheticDives[0]))
+
+static const char *modeName(enum deco_mode mode)
+{
+	return mode == VPMB ? "VPM-B" : "Buehlmann";
+}
+
+// The synthetic dives, planned with the Bühlmann model
+static std::vector<struct dive *> dives;
+
+// The constant depth steps between the plot entries of a dive, replayed by the
+// add_segment() and tissue_tolerance_calc() benchmarks
+struct Segment {
+	double pressure;
+	struct gasmix gasmix;
+	int duration;
+	int setpoint;
+};
+static std::vector<std::vector<Segment>> segments;
+
+static QJsonArray results;
+
+static void planSyntheticDive(int idx, struct dive *d, enum deco_mode mode)
+{
+	struct diveplan dp = {};
+	struct decostop stoptable[60];
+	struct deco_state ds;
+	struct deco_state *cache = NULL;
+
+	setAppState(ApplicationState::PlanDive);
+	prefs.planner_deco_mode = mode;
+	clear_dive(d);
+	d->surface_pressure.mbar = 1013;
+	dp.salinity = 10300;
+	dp.surface_pressure = 1013;
+	dp.gflow = prefs.gflow;
+	dp.gfhigh = prefs.gfhigh;
+	dp.vpmb_conservatism = prefs.vpmb_conservatism;
+	dp.bottomsac = prefs.bottomsac;
+	dp.decosac = prefs.decosac;
+	syntheticDives[idx].setup(d, &dp);
+	struct plan_config config;
+	init_plan_config(&config, true);
+	plan(&ds, &dp, d, &config, 60, stoptable, &cache, true, false);
+	free(cache);
+	free_dps(&dp);
+	setAppState(ApplicationState::Default);
+}
+
+static std::vector<Segment> diveSegments(struct dive *d)
+{
+	std::vector<Segment> res;
+	struct plot_info pi;
+
+	init_plot_info(&pi);
+	create_plot_info_new(d, &d->dc, &pi, 0, nullptr);
+	for (int i = 1; i < pi.nr; i++) {
+		const struct plot_data &entry = pi.entry[i];
+		if (entry.sec == pi.entry[i - 1].sec)
+			continue;
+		res.push_back({ depth_to_bar(entry.depth, d), get_gasmix_at_time(d, &d->dc, { entry.sec }),
+				entry.sec - pi.entry[i - 1].sec, entry.o2pressure.mbar });
+	}
+	free_plot_info_data(&pi);
+	return res;
+}
+
+static void addResult(const char *benchmark, const char *dive, const char *mode, qint64 nsecs, int runs)
+{
+	QJsonObject result;
+	result["benchmark"] = benchmark;
+	result["dive"] = dive;
+	if (mode)
+		result["model"] = mode;
+	result["iterations"] = runs;
+	result["msecs"] = nsecs / runs / 1000000.0;
+	results.append(result);
+}
+
+static void addDiveColumn()
+{
+	QTest::addColumn<int>("dive");
+	for (int i = 0; i < NUM_DIVES; i++)
+		QTest::newRow(syntheticDives[i].name) << i;
+}
+
+static void addDiveAndModelColumns()
+{
+	QTest::addColumn<int>("dive");
+	QTest::addColumn<int>("mode");
+	for (int i = 0; i < NUM_DIVES; i++) {
+		for (enum deco_mode mode: { BUEHLMANN, VPMB })
+			QTest::newRow(qPrintable(QString("%1, %2").arg(syntheticDives[i].name, modeName(mode)))) << i << (int)mode;
+	}
+}
+
+void TestDecoPerformance::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	prefs.display_deco_mode = BUEHLMANN;
+	prefs.calcndltts = true;
+	for (int i = 0; i < NUM_DIVES; i++) {
+		struct dive *d = alloc_dive();
+		planSyntheticDive(i, d, BUEHLMANN);
+		QVERIFY(d->dc.samples > 0);
+		dives.push_back(d);
+		segments.push_back(diveSegments(d));
+	}
+	QVERIFY(dives[3]->dc.duration.seconds >= 10 * 3600);
+}
+
+void TestDecoPerformance::cleanupTestCase()
+{
+	for (struct dive *d: dives)
+		free_dive(d);
+	dives.clear();
+	segments.clear();
+	clear_dive_file_data();
+
+	QString fileName = qgetenv("SUBSURFACE_BENCHMARK_JSON");
+	if (fileName.isEmpty())
+		return;
+
+	QJsonObject root;
+	root["version"] = subsurface_git_version();
+	root["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	root["results"] = results;
+
+	QFile file(fileName);
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write(QJsonDocument(root).toJson());
+}
+
+void TestDecoPerformance::addSegment_data()
+{
+	addDiveColumn();
+}
+
+void TestDecoPerformance::addSegment()
+{
+	QFETCH(int, dive);
+	const std::vector<Segment> &steps = segments[dive];
+	enum divemode_t divemode = dives[dive]->dc.divemode;
+	struct deco_state ds;
+	qint64 nsecs = 0;
+	int runs = 0;
+
+	QBENCHMARK {
+		QElapsedTimer timer;
+		timer.start();
+		init_deco_config(&ds.config, false);
+		clear_deco(&ds, 1.013);
+		for (const Segment &step: steps)
+			add_segment(&ds, step.pressure, step.gasmix, step.duration, step.setpoint, divemode, prefs.bottomsac);
+		nsecs += timer.nsecsElapsed();
+		++runs;
+	}
+	addResult("add_segment", syntheticDives[dive].name, nullptr, nsecs, runs);
+}
+
+void TestDecoPerformance::tissueToleranceCalc_data()
+{
+	addDiveAndModelColumns();
+}
+
+void TestDecoPerformance::tissueToleranceCalc()
+{
+	QFETCH(int, dive);
+	QFETCH(int, mode);
+	const std::vector<Segment> &steps = segments[dive];
+	struct dive *d = dives[dive];
+	std::vector<deco_state> stepStates;
+	struct deco_state ds;
+	double sum = 0.0;
+	qint64 nsecs = 0;
+	int runs = 0;
+
+	// The deco state after each step, with the gradients of the first ceiling for VPM-B
+	prefs.display_deco_mode = (enum deco_mode)mode;
+	init_deco_config(&ds.config, false);
+	clear_deco(&ds, 1.013);
+	for (const Segment &step: steps) {
+		add_segment(&ds, step.pressure, step.gasmix, step.duration, step.setpoint, d->dc.divemode, prefs.bottomsac);
+		if (mode == VPMB && !ds.first_ceiling_pressure.mbar) {
+			double ceiling = tissue_tolerance_calc(&ds, d, step.pressure);
+			if (ceiling > 1.013) {
+				ds.first_ceiling_pressure.mbar = lrint(ceiling * 1000.0);
+				vpmb_start_gradient(&ds);
+			}
+		}
+		stepStates.push_back(ds);
+	}
+	prefs.display_deco_mode = BUEHLMANN;
+
+	QBENCHMARK {
+		QElapsedTimer timer;
+		timer.start();
+		for (size_t i = 0; i < stepStates.size(); i++)
+			sum += tissue_tolerance_calc(&stepStates[i], d, steps[i].pressure);
+		nsecs += timer.nsecsElapsed();
+		++runs;
+	}
+	QVERIFY(sum > 0.0);
+	addResult("tissue_tolerance_calc", syntheticDives[dive].name, modeName((enum deco_mode)mode), nsecs, runs);
+}
+
+void TestDecoPerformance::planDive_data()
+{
+	addDiveAndModelColumns();
+}
+
+void TestDecoPerformance::planDive()
+{
+	QFETCH(int, dive);
+	QFETCH(int, mode);
+	struct dive *d = alloc_dive();
+	qint64 nsecs = 0;
+	int runs = 0;
+
+	QBENCHMARK {
+		QElapsedTimer timer;
+		timer.start();
+		planSyntheticDive(dive, d, (enum deco_mode)mode);
+		nsecs += timer.nsecsElapsed();
+		++runs;
+	}
+	QVERIFY(d->dc.duration.seconds > 0);
+	free_dive(d);
+	prefs.planner_deco_mode = default_prefs.planner_deco_mode;
+	addResult("plan", syntheticDives[dive].name, modeName((enum deco_mode)mode), nsecs, runs);
+}
+
+void TestDecoPerformance::createPlotInfo_data()
+{
+	addDiveAndModelColumns();
+}
+
+void TestDecoPerformance::createPlotInfo()
+{
+	QFETCH(int, dive);
+	QFETCH(int, mode);
+	struct dive *d = dives[dive];
+	struct plot_info pi;
+	qint64 nsecs = 0;
+	int runs = 0;
+
+	prefs.display_deco_mode = (enum deco_mode)mode;
+	init_plot_info(&pi);
+	QBENCHMARK {
+		QElapsedTimer timer;
+		timer.start();
+		create_plot_info_new(d, &d->dc, &pi, PLOT_ALL, nullptr);
+		nsecs += timer.nsecsElapsed();
+		++runs;
+	}
+	QVERIFY(pi.nr > 0);
+	free_plot_info_data(&pi);
+	prefs.display_deco_mode = BUEHLMANN;
+	addResult("create_plot_info_new", syntheticDives[dive].name, modeName((enum deco_mode)mode), nsecs, runs);
+}
+
+void TestDecoPerformance::initDecompression_data()
+{
+	QTest::addColumn<bool>("cached");
+	QTest::newRow("uncached") << false;
+	QTest::newRow("cached") << true;
+}
+
+void TestDecoPerformance::initDecompression()
+{
+	QFETCH(bool, cached);
+	qint64 nsecs = 0;
+	int runs = 0;
+
+	// A log of all synthetic dives every day, two hours apart
+	clear_dive_file_data();
+	for (int day = 0; day < LOG_DAYS; day++) {
+		for (int i = 0; i < NUM_DIVES; i++) {
+			struct dive *d = alloc_dive();
+			copy_dive(dives[i], d);
+			d->when = 1600000000 + day * 24 * 3600 + i * 2 * 3600;
+			append_dive(d);
+		}
+	}
+	sort_dive_table(&dive_table);
+	struct dive *last = get_dive(dive_table.nr - 1);
+
+	clear_tissue_cache();
+	QBENCHMARK {
+		struct deco_state ds;
+		if (!cached)
+			clear_tissue_cache();
+		QElapsedTimer timer;
+		timer.start();
+		init_deco_config(&ds.config, false);
+		init_decompression(&ds, last);
+		nsecs += timer.nsecsElapsed();
+		++runs;
+	}
+	clear_dive_file_data();
+	addResult("init_decompression", cached ? "log, cached" : "log", nullptr, nsecs, runs);
+}
+
+QTEST_GUILESS_MAIN(TestDecoPerformance)
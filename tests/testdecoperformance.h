@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDECOPERFORMANCE_H
+#define TESTDECOPERFORMANCE_H
+
+#include <QtTest>
+
+class TestDecoPerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void addSegment_data();
+	void addSegment();
+	void tissueToleranceCalc_data();
+	void tissueToleranceCalc();
+	void planDive_data();
+	void planDive();
+	void createPlotInfo_data();
+	void createPlotInfo();
+	void initDecompression_data();
+	void initDecompression();
+};
+
+#endif
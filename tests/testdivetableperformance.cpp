@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivetableperformance.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include <vector>
+
+// Size of the synthetic dive table and number of lookups per benchmark iteration
+#define NUM_DIVES 50000
+#define NUM_LOOKUPS 1000
+
+// Create a synthetic log of one dive every two hours
+static void create_dive_table(int nr)
+{
+	for (int i = 0; i < nr; i++) {
+		struct dive *d = alloc_dive();
+		d->when = 1000000000 + i * 7200;
+		d->number = i + 1;
+		d->duration.seconds = 3600;
+		append_dive(d);
+	}
+}
+
+// The way get_divenr() was implemented before the id index was introduced
+static int get_divenr_linear(const struct dive *dive)
+{
+	int i;
+	struct dive *d;
+	for_each_dive(i, d) {
+		if (d->id == dive->id)
+			return i;
+	}
+	return -1;
+}
+
+void TestDiveTablePerformance::initTestCase()
+{
+	create_dive_table(NUM_DIVES);
+	QCOMPARE(dive_table.nr, NUM_DIVES);
+}
+
+void TestDiveTablePerformance::cleanupTestCase()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveTablePerformance::testIdIndex()
+{
+	int i;
+	struct dive *d;
+
+	for_each_dive (i, d) {
+		QCOMPARE(get_divenr(d), i);
+		QCOMPARE(get_idx_by_uniq_id(d->id), i);
+		QCOMPARE(get_dive_by_uniq_id(d->id), d);
+	}
+
+	// The index must follow removal and re-insertion of dives
+	struct dive *removed = unregister_dive(NUM_DIVES / 2);
+	QCOMPARE(dive_table.nr, NUM_DIVES - 1);
+	QCOMPARE(get_divenr(removed), -1);
+	QVERIFY(get_dive_by_uniq_id(removed->id) == NULL);
+	QCOMPARE(get_idx_by_uniq_id(removed->id), dive_table.nr);
+	QCOMPARE(get_divenr(get_dive(NUM_DIVES / 2)), NUM_DIVES / 2);
+	QCOMPARE(get_divenr(get_dive(NUM_DIVES - 2)), NUM_DIVES - 2);
+
+	insert_dive(&dive_table, removed);
+	QCOMPARE(dive_table.nr, NUM_DIVES);
+	QCOMPARE(get_divenr(removed), NUM_DIVES / 2);
+	QCOMPARE(get_dive_by_uniq_id(removed->id), removed);
+
+	// A dive that is not in the table must not be found
+	struct dive *other = alloc_dive();
+	QCOMPARE(get_divenr(other), -1);
+	free_dive(other);
+
+	// Sorting must rebuild the index
+	get_dive(0)->when = get_dive(NUM_DIVES - 1)->when + 7200;
+	struct dive *moved = get_dive(0);
+	sort_dive_table(&dive_table);
+	QCOMPARE(get_divenr(moved), NUM_DIVES - 1);
+	for_each_dive (i, d)
+		QCOMPARE(get_divenr(d), i);
+}
+
+void TestDiveTablePerformance::lookupLinear()
+{
+	int sum = 0;
+	QBENCHMARK {
+		for (int i = 0; i < NUM_LOOKUPS; i++)
+			sum += get_divenr_linear(get_dive(i * (NUM_DIVES / NUM_LOOKUPS)));
+	}
+	QVERIFY(sum > 0);
+}
+
+void TestDiveTablePerformance::lookupIndexed()
+{
+	int sum = 0;
+	QBENCHMARK {
+		for (int i = 0; i < NUM_LOOKUPS; i++)
+			sum += get_divenr(get_dive(i * (NUM_DIVES / NUM_LOOKUPS)));
+	}
+	QVERIFY(sum > 0);
+}
+
+// Allocate dives in pseudo-random chronological order
+static std::vector<struct dive *> create_shuffled_dives(int nr)
+{
+	std::vector<struct dive *> res;
+	for (int i = 0; i < nr; i++) {
+		struct dive *d = alloc_dive();
+		d->when = 1000000000 + ((i * 7919) % nr) * 7200;
+		res.push_back(d);
+	}
+	return res;
+}
+
+static void free_dives(struct dive_table *table)
+{
+	clear_dive_table(table);
+	free(table->dives);
+	*table = { 0 };
+}
+
+void TestDiveTablePerformance::testInsertDives()
+{
+	std::vector<struct dive *> dives = create_shuffled_dives(1000);
+	struct dive_table single = { 0 }, bulk = { 0 };
+
+	// Fill both tables with the first half one-by-one,
+	// then add the second half one-by-one and in bulk, respectively.
+	for (int i = 0; i < 500; i++) {
+		insert_dive(&single, dives[i]);
+		insert_dive(&bulk, dives[i]);
+	}
+	for (int i = 500; i < 1000; i++)
+		insert_dive(&single, dives[i]);
+	insert_dives(&bulk, &dives[500], 500);
+
+	QCOMPARE(bulk.nr, single.nr);
+	for (int i = 0; i < single.nr; i++)
+		QCOMPARE(bulk.dives[i], single.dives[i]);
+	for (int i = 1; i < single.nr; i++)
+		QVERIFY(dive_less_than(single.dives[i - 1], single.dives[i]));
+
+	// Both tables reference the same dives - only free them once
+	free(bulk.dives);
+	free_dives(&single);
+}
+
+void TestDiveTablePerformance::insertSingle()
+{
+	std::vector<struct dive *> dives = create_shuffled_dives(NUM_DIVES);
+	struct dive_table table = { 0 };
+	QBENCHMARK_ONCE {
+		for (struct dive *d: dives)
+			insert_dive(&table, d);
+	}
+	QCOMPARE(table.nr, NUM_DIVES);
+	free_dives(&table);
+}
+
+void TestDiveTablePerformance::insertBulk()
+{
+	std::vector<struct dive *> dives = create_shuffled_dives(NUM_DIVES);
+	struct dive_table table = { 0 };
+	QBENCHMARK_ONCE {
+		insert_dives(&table, &dives[0], NUM_DIVES);
+	}
+	QCOMPARE(table.nr, NUM_DIVES);
+	free_dives(&table);
+}
+
+QTEST_GUILESS_MAIN(TestDiveTablePerformance)
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVETABLEPERFORMANCE_H
+#define TESTDIVETABLEPERFORMANCE_H
+
+#include <QtTest>
+
+class TestDiveTablePerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testIdIndex();
+	void lookupLinear();
+	void lookupIndexed();
+	void testInsertDives();
+	void insertSingle();
+	void insertBulk();
+};
+
+#endif
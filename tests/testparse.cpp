@@ -2,13 +2,18 @@
 #include "testparse.h"
 #include "core/divesite.h"
 #include "core/errorhelper.h"
+#include "core/eventindex.h"
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/import-csv.h"
 #include "core/parse.h"
 #include "core/qthelper.h"
+#include "core/samplecolumns.h"
+#include "core/sharedbuffer.h"
+#include "core/stringpool.h"
 #include "core/subsurface-string.h"
 #include <QTextStream>
+#include <vector>
 
 /* We have to use a macro since QCOMPARE
  * can only be called from a test method
@@ -308,6 +313,198 @@ void TestParse::testParseMerge()
 		     SUBSURFACE_TEST_DATA "/dives/mergedVyperOstc.xml");
 }
 
+static bool same_sample(const struct sample &a, const struct sample &b)
+{
+	return a.time.seconds == b.time.seconds && a.stoptime.seconds == b.stoptime.seconds &&
+	       a.ndl.seconds == b.ndl.seconds && a.tts.seconds == b.tts.seconds && a.rbt.seconds == b.rbt.seconds &&
+	       a.depth.mm == b.depth.mm && a.stopdepth.mm == b.stopdepth.mm && a.temperature.mkelvin == b.temperature.mkelvin &&
+	       a.pressure[0].mbar == b.pressure[0].mbar && a.pressure[1].mbar == b.pressure[1].mbar &&
+	       a.setpoint.mbar == b.setpoint.mbar && a.o2sensor[0].mbar == b.o2sensor[0].mbar &&
+	       a.o2sensor[1].mbar == b.o2sensor[1].mbar && a.o2sensor[2].mbar == b.o2sensor[2].mbar &&
+	       a.bearing.degrees == b.bearing.degrees && a.sensor[0] == b.sensor[0] && a.sensor[1] == b.sensor[1] &&
+	       a.cns == b.cns && a.heartbeat == b.heartbeat && a.sac.mliter == b.sac.mliter &&
+	       a.in_deco == b.in_deco && a.manually_entered == b.manually_entered;
+}
+
+void TestParse::testPackSamples()
+{
+	/*
+	 * check that packing the samples into columns and back is lossless
+	 */
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/ostc.xml", &dive_table, &trip_table, &dive_site_table), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test47c.xml", &dive_table, &trip_table, &dive_site_table), 0);
+	QVERIFY(dive_table.nr > 0);
+	for (int i = 0; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		struct divecomputer *dc = &d->dc;
+		int nr = dc->samples;
+		QVERIFY(nr > 0);
+		std::vector<struct sample> orig(dc->sample, dc->sample + nr);
+
+		pack_dive_samples(d);
+		QVERIFY(dc->packed_samples != NULL);
+		QVERIFY(dc->sample == NULL);
+		QCOMPARE(dc->samples, nr);
+		QVERIFY(sample_channel_is_constant(dc->packed_samples, SAMPLE_CHANNEL_MANUALLY_ENTERED));
+		QVERIFY(!sample_channel_is_constant(dc->packed_samples, SAMPLE_CHANNEL_DEPTH));
+		QVERIFY(sample_columns_size(dc->packed_samples) < nr * sizeof(struct sample));
+		struct sample_column time = get_sample_column(dc, SAMPLE_CHANNEL_TIME);
+		struct sample_column manual = get_sample_column(dc, SAMPLE_CHANNEL_MANUALLY_ENTERED);
+		QCOMPARE(manual.stride, (size_t)0);
+		for (int j = 0; j < nr; j++) {
+			QVERIFY(same_sample(get_sample(dc, j), orig[j]));
+			QCOMPARE(SAMPLE_VALUE(time, duration_t, j).seconds, orig[j].time.seconds);
+			QCOMPARE(SAMPLE_VALUE(manual, bool, j), orig[j].manually_entered);
+		}
+		const struct sample *array = get_sample_array(dc);
+		for (int j = 0; j < nr; j++)
+			QVERIFY(same_sample(array[j], orig[j]));
+		free_sample_array(dc, array);
+
+		// copies of packed dives are unpacked
+		struct dive *copy = alloc_dive();
+		copy_dive(d, copy);
+		QVERIFY(copy->dc.packed_samples == NULL);
+		QCOMPARE(copy->dc.samples, nr);
+		for (int j = 0; j < nr; j++)
+			QVERIFY(same_sample(copy->dc.sample[j], orig[j]));
+		free_dive(copy);
+
+		// writing to the samples unpacks them
+		unshare_samples(dc);
+		QVERIFY(dc->packed_samples == NULL);
+		QCOMPARE(dc->samples, nr);
+		for (int j = 0; j < nr; j++)
+			QVERIFY(same_sample(dc->sample[j], orig[j]));
+	}
+
+	// the dives of the dive list are packed when the logbook is loaded
+	process_loaded_dives();
+	for (int i = 0; i < dive_table.nr; i++)
+		QVERIFY(get_dive(i)->dc.packed_samples != NULL);
+}
+
+void TestParse::testInternedStrings()
+{
+	/*
+	 * check that repeated strings of a logbook share their storage
+	 */
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	QVERIFY(dive_table.nr > 1);
+	struct dive *first = get_dive(0);
+	QVERIFY(is_interned_string(first->dc.model));
+	for (int i = 1; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		if (same_string(d->dc.model, first->dc.model))
+			QVERIFY(d->dc.model == first->dc.model);
+	}
+
+	// copies share the strings, releasing the copy keeps them alive
+	struct dive *copy = alloc_dive();
+	copy_dive(first, copy);
+	QVERIFY(copy->dc.model == first->dc.model);
+	QVERIFY(copy->buddy == first->buddy);
+	free_dive(copy);
+	QVERIFY(is_interned_string(first->dc.model));
+
+	// plain strings can be released as well
+	char *s = strdup(first->dc.model);
+	QVERIFY(!is_interned_string(s));
+	char *interned = intern_owned_string(s);
+	QVERIFY(interned == first->dc.model);
+	release_string(interned);
+}
+void TestParse::testEventIndex()
+{
+	/*
+	 * check that lookups in the event index agree with walking the event list
+	 */
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/cylinder_pressures.xml", &dive_table, &trip_table, &dive_site_table), 0);
+	int gaschanges_seen = 0, modechanges_seen = 0;
+	for (int i = 0; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		struct divecomputer *dc = &d->dc;
+		struct event_index all, gaschanges;
+		build_event_index(&all, dc, NULL);
+		build_event_index(&gaschanges, dc, "gaschange");
+		gaschanges_seen += gaschanges.nr;
+
+		int nr = 0;
+		for (const struct event *ev = dc->events; ev; ev = ev->next)
+			QVERIFY(all.entries[nr++].ev == ev);
+		QCOMPARE(all.nr, nr);
+
+		std::vector<struct gasmix> gases;
+		std::vector<enum divemode_t> modes;
+		for (int j = 0; j < dc->samples; j++) {
+			int time = get_sample(dc, j).time.seconds;
+			struct gasmix gas1 = get_gasmix_at_time(d, dc, get_sample(dc, j).time);
+			struct gasmix gas2 = get_gasmix_indexed(d, dc, &gaschanges, time);
+			QVERIFY(same_gasmix(gas1, gas2));
+			const struct event *next = event_index_next_after(&all, time);
+			QVERIFY(!next || (int)next->time.seconds > time);
+			const struct event *ev = NULL;
+			enum divemode_t mode = UNDEF_COMP_TYPE;
+			gases.push_back(gas1);
+			modes.push_back(get_current_divemode(dc, time, &ev, &mode));
+		}
+		free_event_index(&all);
+		free_event_index(&gaschanges);
+		QCOMPARE(gaschanges.nr, 0);
+
+		// the same lookups through the index of the active event lookups
+		struct event_lookups lookups;
+		begin_event_lookups(&lookups, dc);
+		QVERIFY(get_active_event_index(dc, "gaschange") == &lookups.gaschanges);
+		modechanges_seen += lookups.modechanges.nr;
+		for (int j = 0; j < dc->samples; j++) {
+			const struct event *ev = NULL;
+			enum divemode_t mode = UNDEF_COMP_TYPE;
+			QVERIFY(same_gasmix(get_gasmix_at_time(d, dc, get_sample(dc, j).time), gases[j]));
+			QCOMPARE(get_current_divemode(dc, get_sample(dc, j).time.seconds, &ev, &mode), modes[j]);
+		}
+		end_event_lookups(&lookups);
+		QVERIFY(!get_active_event_index(dc, "gaschange"));
+	}
+	QVERIFY(gaschanges_seen > 0);
+	QVERIFY(modechanges_seen > 0);
+}
+
+void TestParse::testSharedSamples()
+{
+	/*
+	 * check that copies of a dive share the samples until one of them is modified
+	 */
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test47c.xml", &dive_table, &trip_table, &dive_site_table), 0);
+	QVERIFY(dive_table.nr > 0);
+	struct dive *d = get_dive(0);
+	int nr = d->dc.samples;
+	QVERIFY(nr > 0);
+	std::vector<struct sample> orig(d->dc.sample, d->dc.sample + nr);
+
+	struct dive copy = { 0 };
+	copy_dive(d, &copy);
+	QVERIFY(copy.dc.sample == d->dc.sample);
+	QVERIFY(!shared_buffer_is_unique(d->dc.sample));
+
+	struct sample *s = prepare_sample(&copy.dc);
+	QVERIFY(s != NULL);
+	s->time.seconds = orig.back().time.seconds + 10;
+	finish_sample(&copy.dc);
+	QVERIFY(copy.dc.sample != d->dc.sample);
+	QVERIFY(shared_buffer_is_unique(d->dc.sample));
+	QCOMPARE(copy.dc.samples, nr + 1);
+	QCOMPARE(d->dc.samples, nr);
+	for (int j = 0; j < nr; j++) {
+		QVERIFY(same_sample(d->dc.sample[j], orig[j]));
+		QVERIFY(same_sample(copy.dc.sample[j], orig[j]));
+	}
+
+	clear_dive(&copy);
+	QVERIFY(shared_buffer_is_unique(d->dc.sample));
+}
+
 int TestParse::parseCSVmanual(int units, std::string file)
 {
 	verbose = 1;
@@ -24,6 +24,10 @@ private slots:
 	void testParseNewFormat();
 	void testParseDLD();
 	void testParseMerge();
+	void testPackSamples();
+	void testInternedStrings();
+	void testEventIndex();
+	void testSharedSamples();
 
 	int parseCSVmanual(int, std::string);
 	void exportCSVDiveDetails();
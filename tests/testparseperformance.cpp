@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testparseperformance.h"
+#include "core/arena.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
@@ -7,6 +8,7 @@
 #include "core/settings/qPrefProxy.h"
 #include "core/settings/qPrefCloudStorage.h"
 #include <QFile>
+#include <QElapsedTimer>
 #include <QDebug>
 #include <QNetworkProxy>
 
@@ -67,6 +69,31 @@ void TestParsePerformance::parseSsrf()
 	}
 }
 
+void TestParsePerformance::loadAndClearSsrf()
+{
+	// measure loading and tearing down a large logbook separately
+	QFile largeSsrfFile(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf");
+	if (!largeSsrfFile.exists()) {
+		qDebug() << "missing large sample data file - available at " LARGE_TEST_REPO;
+		return;
+	}
+	qint64 loadTime = 0, clearTime = 0;
+	int runs = 0;
+	QBENCHMARK {
+		QElapsedTimer timer;
+		timer.start();
+		parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table, &dive_site_table);
+		loadTime += timer.nsecsElapsed();
+		QVERIFY(logbook_arena_size() > 0);
+		timer.restart();
+		clear_dive_file_data();
+		clearTime += timer.nsecsElapsed();
+		QCOMPARE(logbook_arena_size(), (size_t)0);
+		++runs;
+	}
+	qDebug() << "load:" << loadTime / runs / 1000000.0 << "ms, clear:" << clearTime / runs / 1000000.0 << "ms";
+}
+
 void TestParsePerformance::parseGit()
 {
 	// some more necessary setup
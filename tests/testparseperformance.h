@@ -12,6 +12,7 @@ private slots:
 	void cleanup();
 
 	void parseSsrf();
+	void loadAndClearSsrf();
 	void parseGit();
 };
 
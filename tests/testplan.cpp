@@ -1,20 +1,36 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testplan.h"
+#include "backend-shared/plannershared.h"
 #include "core/deco.h"
 #include "core/dive.h"
+#include "core/divelist.h"
+#include "core/membuffer.h"
 #include "core/planner.h"
+#include "core/profile.h"
 #include "core/qthelper.h"
 #include "core/subsurfacestartup.h"
 #include "core/units.h"
 #include "core/applicationstate.h"
 #include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 #define DEBUG 1
 
 // testing the dive plan algorithm
 struct decostop stoptable[60];
 struct deco_state test_deco_state;
-extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
+
+// plan with a configuration snapshot of the current preferences
+static bool planWithPrefs(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
+{
+	struct plan_config config;
+	init_plan_config(&config, in_planner());
+	return plan(ds, diveplan, dive, &config, timestep, decostoptable, cached_datap, is_planner, show_disclaimer);
+}
+
 void setupPrefs()
 {
 	copy_prefs(&default_prefs, &prefs);
@@ -372,6 +388,66 @@ void setupPlanSeveralGases(struct diveplan *dp)
 	plan_add_segment(dp, 5 * 60, 10000, 0, 0, true, OC);
 }
 
+void setupPlanTrimix(struct diveplan *dp, int depth, int duration, struct gasmix bottomgas, struct gasmix deco1, struct gasmix deco2)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gflow = 30;
+	dp->gfhigh = 70;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 200000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = deco1;
+	cyl2->gasmix = deco2;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = depth * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, 0, gas_mod(deco1, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(deco2, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, depth, 0, 0, 1, OC);
+	plan_add_segment(dp, duration - droptime, depth, 0, 0, 1, OC);
+}
+
+void setupPlanCcr100m40min(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gflow = 30;
+	dp->gfhigh = 75;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix diluent = {{100}, {700}};
+	struct gasmix oxygen = {{1000}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cyl0->gasmix = diluent;
+	cyl0->type.size.mliter = 3000;
+	cyl0->type.workingpressure.mbar = 200000;
+	cyl0->cylinder_use = DILUENT;
+	cyl1->gasmix = oxygen;
+	cyl1->type.size.mliter = 3000;
+	cyl1->type.workingpressure.mbar = 200000;
+	cyl1->cylinder_use = OXYGEN;
+	displayed_dive.dc.divemode = CCR;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(20, 66);
+	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 1300, 1, CCR);
+	plan_add_segment(dp, 40 * 60 - droptime, M_OR_FT(100, 330), 0, 1300, 1, CCR);
+}
+
 /* We compare the calculated runtimes against two values:
  * - Known runtime calculated by Subsurface previously (to detect if anything has changed)
  * - Benchmark runtime (we should be close, but not always exactly the same)
@@ -419,7 +495,7 @@ void TestPlan::testMetric()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -460,7 +536,7 @@ void TestPlan::testImperial()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -501,7 +577,7 @@ void TestPlan::testVpmbMetric45m30minTx()
 	setupPlanVpmb45m30mTx(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -532,7 +608,7 @@ void TestPlan::testVpmbMetric60m10minTx()
 	setupPlanVpmb60m10mTx(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -563,7 +639,7 @@ void TestPlan::testVpmbMetric60m30minAir()
 	setupPlanVpmb60m30minAir(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -594,7 +670,7 @@ void TestPlan::testVpmbMetric60m30minEan50()
 	setupPlanVpmb60m30minEan50(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -631,7 +707,7 @@ void TestPlan::testVpmbMetric60m30minTx()
 	setupPlanVpmb60m30minTx(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -668,7 +744,7 @@ void TestPlan::testVpmbMetric100m60min()
 	setupPlanVpmb100m60min(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -712,7 +788,7 @@ void TestPlan::testMultipleGases()
 	setupPlanSeveralGases(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -738,7 +814,7 @@ void TestPlan::testVpmbMetricMultiLevelAir()
 	setupPlanVpmbMultiLevelAir(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -769,7 +845,7 @@ void TestPlan::testVpmbMetric100m10min()
 	setupPlanVpmb100m10min(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -816,7 +892,7 @@ void TestPlan::testVpmbMetricRepeat()
 	setupPlanVpmb30m20min(&testPlan);
 	setAppState(ApplicationState::PlanDive);
 
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -837,7 +913,7 @@ void TestPlan::testVpmbMetricRepeat()
 	int firstDiveRunTimeSeconds = displayed_dive.dc.duration.seconds;
 
 	setupPlanVpmb100mTo70m30min(&testPlan);
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -874,7 +950,7 @@ void TestPlan::testVpmbMetricRepeat()
 	QVERIFY(compareDecoTime(displayed_dive.dc.duration.seconds, 127u * 60u + 20u, 127u * 60u + 20u));
 
 	setupPlanVpmb30m20min(&testPlan);
-	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -895,4 +971,534 @@ void TestPlan::testVpmbMetricRepeat()
 	QCOMPARE(finalDiveRunTimeSeconds, firstDiveRunTimeSeconds);
 }
 
+void TestPlan::testMetricRepeat()
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+
+	struct diveplan testPlan = {};
+	setupPlan(&testPlan);
+	testPlan.when = 1600000000;
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 6540u);
+
+	// Log the planned dive. The following plans start with the tissue
+	// loading of this dive, which is replayed by init_decompression().
+	// The runtimes are the ones calculated when the previous dive was
+	// replayed second by second.
+	struct dive *previous = alloc_dive();
+	int id = previous->id;
+	copy_dive(&displayed_dive, previous);
+	previous->id = id;
+	insert_dive(&dive_table, previous);
+
+	const int intervals[] = { 30, 60, 120, 240 };
+	const unsigned int runtimes[] = { 9300, 8820, 8040, 7260 };
+	for (int i = 0; i < 4; i++) {
+		free(cache);
+		cache = NULL;
+		setupPlan(&testPlan);
+		testPlan.when = dive_endtime(previous) + intervals[i] * 60;
+		planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+		QCOMPARE(displayed_dive.dc.duration.seconds, runtimes[i]);
+	}
+
+	remove_dive(previous, &dive_table);
+	free_dive(previous);
+	free(cache);
+	free_dps(&testPlan);
+}
+
+// Run a synthetic multi-gas dive through the tissue model, recording the
+// ceiling after every segment. The periods vary, so that both the one-second
+// factors and the cached factors of longer periods are exercised.
+static std::vector<double> replaySegments(struct deco_state *ds, bool reference)
+{
+	const struct gasmix gases[] = { { {180}, {450} }, { {210}, {0} }, { {500}, {0} }, { {1000}, {0} } };
+	const int periods[] = { 1, 1, 2, 10, 60, 1, 30 };
+	std::vector<double> ceilings;
+	double surface_pressure = 1.013;
+	int time = 0, depth = 0;
+
+	init_deco_config(&ds->config, in_planner());
+	clear_deco(ds, surface_pressure);
+	for (int i = 0; time < 90 * 60; i++) {
+		int period = periods[i % 7];
+		if (time < 3 * 60)
+			depth += 333 * period;
+		else if (time > 25 * 60 && depth > 0)
+			depth = std::max(depth - 150 * period, 0);
+		struct gasmix gas = gases[depth > 40000 ? 0 : depth > 21000 ? 1 : depth > 6000 ? 2 : 3];
+		double pressure = surface_pressure + depth / 10000.0;
+		if (reference)
+			add_segment_reference(ds, pressure, gas, period, 0, OC, 0);
+		else
+			add_segment(ds, pressure, gas, period, 0, OC, 0);
+		ceilings.push_back(tissue_tolerance_calc(ds, &displayed_dive, pressure));
+		time += period;
+	}
+	return ceilings;
+}
+
+static void compareSegmentKernels()
+{
+	struct deco_state ds1, ds2;
+	std::vector<double> ceilings1 = replaySegments(&ds1, false);
+	std::vector<double> ceilings2 = replaySegments(&ds2, true);
+
+	QCOMPARE(ceilings1.size(), ceilings2.size());
+	for (size_t i = 0; i < ceilings1.size(); i++)
+		QVERIFY(ceilings1[i] == ceilings2[i]);
+	QVERIFY(memcmp(ds1.tissue_n2_sat, ds2.tissue_n2_sat, sizeof(ds1.tissue_n2_sat)) == 0);
+	QVERIFY(memcmp(ds1.tissue_he_sat, ds2.tissue_he_sat, sizeof(ds1.tissue_he_sat)) == 0);
+	QVERIFY(memcmp(ds1.tissue_inertgas_saturation, ds2.tissue_inertgas_saturation, sizeof(ds1.tissue_inertgas_saturation)) == 0);
+	QCOMPARE(ds1.icd_warning, ds2.icd_warning);
+}
+
+void TestPlan::testAddSegmentKernel()
+{
+	// The tissue update must give bit-for-bit the same ceilings as the reference implementation
+	setupPrefs();
+	setAppState(ApplicationState::PlanDive);
+	compareSegmentKernels();
+
+	setupPrefsVpmb();
+	compareSegmentKernels();
+}
+
+void TestPlan::testAddSegmentLinear()
+{
+	// A linear ramp in one call must match many short constant-depth steps
+	const struct gasmix trimix = { {180}, {450} };
+	const double ramps[][2] = { { 1.013, 7.0 }, { 7.0, 7.0 }, { 7.0, 2.2 }, { 2.2, 1.013 } };
+	const int periods[] = { 180, 1200, 480, 300 };
+	struct deco_state ds1, ds2;
+
+	setupPrefs();
+	init_deco_config(&ds1.config, in_planner());
+	clear_deco(&ds1, 1.013);
+	ds2 = ds1;
+	for (int i = 0; i < 4; i++) {
+		add_segment_linear(&ds1, ramps[i][0], ramps[i][1], trimix, periods[i], 0, OC, 0);
+		// one-second steps at the pressure in the middle of the step
+		for (int t = 0; t < periods[i]; t++) {
+			double pressure = ramps[i][0] + (ramps[i][1] - ramps[i][0]) * (t + 0.5) / periods[i];
+			add_segment(&ds2, pressure, trimix, 1, 0, OC, 0);
+		}
+		for (int ci = 0; ci < 16; ci++) {
+			QVERIFY(fabs(ds1.tissue_n2_sat[ci] - ds2.tissue_n2_sat[ci]) < 1e-4);
+			QVERIFY(fabs(ds1.tissue_he_sat[ci] - ds2.tissue_he_sat[ci]) < 1e-4);
+		}
+	}
+}
+
+void TestPlan::addSegmentReference()
+{
+	struct deco_state ds;
+	setupPrefs();
+	QBENCHMARK {
+		replaySegments(&ds, true);
+	}
+}
+
+void TestPlan::addSegmentOptimized()
+{
+	struct deco_state ds;
+	setupPrefs();
+	QBENCHMARK {
+		replaySegments(&ds, false);
+	}
+}
+
+// The stop tables of the reference plans with one second resolution, as calculated
+// by the former stop length search, which narrowed down a leap from the last stop.
+static const struct decostop vpmb100m60minStops[] = {
+	{ 90000, 0 }, { 87000, 0 }, { 84000, 0 }, { 81000, 0 }, { 78000, 0 }, { 75000, 0 }, { 72000, 0 },
+	{ 69000, 0 }, { 66000, 0 }, { 63000, 34 }, { 60000, 86 }, { 57000, 101 }, { 54000, 117 },
+	{ 51000, 163 }, { 48000, 178 }, { 45000, 216 }, { 42000, 275 }, { 39000, 299 }, { 36000, 375 },
+	{ 33000, 466 }, { 30000, 510 }, { 27000, 712 }, { 24000, 820 }, { 21000, 426 }, { 18000, 608 },
+	{ 15000, 889 }, { 12000, 1199 }, { 9000, 1744 }, { 6000, 2106 }, { 3000, 3076 }
+};
+
+static const struct decostop ccr100m40minStops[] = {
+	{ 90000, 0 }, { 87000, 0 }, { 84000, 0 }, { 81000, 0 }, { 78000, 0 }, { 75000, 0 }, { 72000, 0 },
+	{ 69000, 0 }, { 66000, 62 }, { 63000, 74 }, { 60000, 118 }, { 57000, 120 }, { 54000, 130 },
+	{ 51000, 194 }, { 48000, 198 }, { 45000, 202 }, { 42000, 299 }, { 39000, 316 }, { 36000, 324 },
+	{ 33000, 486 }, { 30000, 497 }, { 27000, 596 }, { 24000, 752 }, { 21000, 892 }, { 18000, 1067 },
+	{ 15000, 1396 }, { 12000, 1772 }, { 9000, 2291 }, { 6000, 9754 }
+};
+
+// Trimix plans with nitrox deco gases: after the switches the tissues release helium while
+// some still take up nitrogen, so the ceiling needn't drop steadily during a stop. These
+// tables were calculated by trying one stop length after the other.
+static const struct decostop heliox100m25minStops[] = {
+	{ 90000, 0 }, { 87000, 0 }, { 84000, 0 }, { 81000, 0 }, { 78000, 0 }, { 75000, 0 }, { 72000, 0 },
+	{ 69000, 74 }, { 66000, 0 }, { 63000, 0 }, { 60000, 0 }, { 57000, 18 }, { 54000, 37 },
+	{ 51000, 41 }, { 48000, 45 }, { 45000, 79 }, { 42000, 88 }, { 39000, 98 }, { 36000, 109 },
+	{ 33000, 172 }, { 30000, 203 }, { 27000, 233 }, { 24000, 333 }, { 21000, 301 }, { 18000, 417 },
+	{ 15000, 679 }, { 12000, 917 }, { 9000, 1426 }, { 6000, 2489 }, { 3000, 4513 }
+};
+
+static const struct decostop trimix90m25minStops[] = {
+	{ 87000, 0 }, { 84000, 0 }, { 81000, 0 }, { 78000, 0 }, { 75000, 0 }, { 72000, 0 }, { 69000, 0 },
+	{ 66000, 0 }, { 63000, 0 }, { 60000, 0 }, { 57000, 0 }, { 54000, 93 }, { 51000, 108 },
+	{ 48000, 114 }, { 45000, 154 }, { 42000, 210 }, { 39000, 1 }, { 36000, 99 }, { 33000, 118 },
+	{ 30000, 134 }, { 27000, 206 }, { 24000, 253 }, { 21000, 313 }, { 18000, 488 }, { 15000, 592 },
+	{ 12000, 999 }, { 9000, 1555 }, { 6000, 1596 }, { 3000, 2704 }
+};
+
+static void planVpmb100m60min(struct diveplan *dp)
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+	setupPlanVpmb100m60min(dp);
+	planWithPrefs(&test_deco_state, dp, &displayed_dive, 1, stoptable, &cache, 1, 0);
+	free(cache);
+}
+
+static void planCcr100m40min(struct diveplan *dp)
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+	setupPlanCcr100m40min(dp);
+	planWithPrefs(&test_deco_state, dp, &displayed_dive, 1, stoptable, &cache, 1, 0);
+	free(cache);
+}
+
+static void planTrimix(struct diveplan *dp, int depth, int duration, struct gasmix bottomgas, struct gasmix deco1, struct gasmix deco2)
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefsVpmb();
+	prefs.planner_deco_mode = BUEHLMANN;
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+	setupPlanTrimix(dp, depth, duration, bottomgas, deco1, deco2);
+	planWithPrefs(&test_deco_state, dp, &displayed_dive, 1, stoptable, &cache, 1, 0);
+	free(cache);
+}
+
+template <size_t N>
+static void compareStopTable(const struct decostop (&expected)[N])
+{
+	for (size_t i = 0; i < N; i++) {
+		QCOMPARE(stoptable[i].depth, expected[i].depth);
+		QCOMPARE(stoptable[i].time, expected[i].time);
+	}
+	QCOMPARE(stoptable[N].depth, 0);
+}
+
+void TestPlan::testStopTableVpmb100m60min()
+{
+	struct diveplan testPlan = {};
+	planVpmb100m60min(&testPlan);
+	compareStopTable(vpmb100m60minStops);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 18722);
+	free_dps(&testPlan);
+}
+
+void TestPlan::testStopTableCcr100m40min()
+{
+	struct diveplan testPlan = {};
+	planCcr100m40min(&testPlan);
+	compareStopTable(ccr100m40minStops);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 24686);
+	free_dps(&testPlan);
+}
+
+void TestPlan::testStopTableHeliox100m25min()
+{
+	struct diveplan testPlan = {};
+	planTrimix(&testPlan, M_OR_FT(100, 330), 25 * 60, { {100}, {900} }, { {210}, {0} }, { {500}, {0} });
+	compareStopTable(heliox100m25minStops);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 14554);
+	free_dps(&testPlan);
+}
+
+void TestPlan::testStopTableTrimix90m25min()
+{
+	struct diveplan testPlan = {};
+	planTrimix(&testPlan, M_OR_FT(90, 300), 25 * 60, { {120}, {650} }, { {320}, {0} }, { {1000}, {0} });
+	compareStopTable(trimix90m25minStops);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 11897);
+	free_dps(&testPlan);
+}
+
+void TestPlan::benchmarkPlanVpmb100m60min()
+{
+	struct diveplan testPlan = {};
+	QBENCHMARK {
+		planVpmb100m60min(&testPlan);
+	}
+	free_dps(&testPlan);
+}
+
+void TestPlan::benchmarkPlanCcr100m40min()
+{
+	struct diveplan testPlan = {};
+	QBENCHMARK {
+		planCcr100m40min(&testPlan);
+	}
+	free_dps(&testPlan);
+	clear_dive(&displayed_dive);
+}
+
+void TestPlan::testCeilingCrossingTime()
+{
+	// The estimate must agree with adding one second after the other
+	const struct gasmix mixes[] = { { {210}, {0} }, { {180}, {450} } };
+	const struct gasmix ean50 = { {500}, {0} };
+	const int depths[] = { 30000, 45000 };
+
+	setupPrefs();
+	setAppState(ApplicationState::Default);
+	clear_dive(&displayed_dive);
+	displayed_dive.surface_pressure.mbar = 1013;
+	for (int i = 0; i < 2; i++) {
+		struct deco_state ds;
+		double pressure = depth_to_bar(depths[i], &displayed_dive);
+		double surface = depth_to_bar(0, &displayed_dive);
+		init_deco_config(&ds.config, false);
+		clear_deco(&ds, surface);
+
+		// no-deco limit at the bottom
+		double ndl = ceiling_crossing_time(&ds, &displayed_dive, pressure, mixes[i], 0, OC, surface, true, 7200);
+		int seconds = 0;
+		while (deco_allowed_depth(tissue_tolerance_calc(&ds, &displayed_dive, pressure), surface, &displayed_dive, 1) <= 0) {
+			add_segment(&ds, pressure, mixes[i], 1, 0, OC, 0);
+			seconds++;
+		}
+		QVERIFY(fabs(ndl - seconds) <= 1.0);
+
+		// stop at 6m until the ceiling is at 3m
+		add_segment(&ds, pressure, mixes[i], 20 * 60, 0, OC, 0);
+		double stop_pressure = depth_to_bar(6000, &displayed_dive);
+		double limit_pressure = depth_to_bar(3000, &displayed_dive);
+		tissue_tolerance_calc(&ds, &displayed_dive, stop_pressure);
+		double stop = ceiling_crossing_time(&ds, &displayed_dive, stop_pressure, ean50, 0, OC, limit_pressure, false, 7200);
+		seconds = 0;
+		while (deco_allowed_depth(tissue_tolerance_calc(&ds, &displayed_dive, stop_pressure), surface, &displayed_dive, 1) > 3000) {
+			add_segment(&ds, stop_pressure, ean50, 1, 0, OC, 0);
+			seconds++;
+		}
+		QVERIFY(stop > 0.0);
+		QVERIFY(fabs(stop - seconds) <= 1.0);
+	}
+}
+
+void TestPlan::testCeilingAfterGasSwitch()
+{
+	// The stop lengths are only bisected if the ceiling moves in one direction
+	const struct gasmix tx1845 = { {180}, {450} };
+	const struct gasmix air = { {210}, {0} };
+	const struct gasmix ean50 = { {500}, {0} };
+	struct deco_state ds;
+
+	setupPrefs();
+	setAppState(ApplicationState::Default);
+	clear_dive(&displayed_dive);
+	displayed_dive.surface_pressure.mbar = 1013;
+	double surface = depth_to_bar(0, &displayed_dive);
+	double bottom = depth_to_bar(60000, &displayed_dive);
+	double stop = depth_to_bar(21000, &displayed_dive);
+	init_deco_config(&ds.config, false);
+
+	// on trimix at the bottom, both gases enter the compartments
+	clear_deco(&ds, surface);
+	QVERIFY(ceiling_is_monotonic(&ds, bottom, tx1845, 0, OC));
+	add_segment(&ds, bottom, tx1845, 30 * 60, 0, OC, 0);
+	QVERIFY(ceiling_is_monotonic(&ds, bottom, tx1845, 0, OC));
+
+	// after the switch to nitrox, helium leaves them while nitrogen enters the slow ones
+	QVERIFY(!ceiling_is_monotonic(&ds, stop, ean50, 0, OC));
+
+	// without helium in the compartments, the switch doesn't matter
+	clear_deco(&ds, surface);
+	add_segment(&ds, depth_to_bar(40000, &displayed_dive), air, 30 * 60, 0, OC, 0);
+	QVERIFY(ceiling_is_monotonic(&ds, stop, ean50, 0, OC));
+}
+
+// The NDL/TTS of the profiles of planned dives every three minutes, as calculated
+// by the former search, which added one minute after the other. After the switch
+// from trimix to EAN50, the 60m dive takes the stepwise search again.
+struct ndlTts {
+	int sec, ndl, stopdepth, stoptime, tts;
+};
+
+static const struct ndlTts air30m20minBuehlmannNdlTts[] = {
+	{ 0, 0, 0, 0, 0 }, { 180, 480, 0, 0, 0 }, { 360, 300, 0, 0, 0 },
+	{ 540, 120, 0, 0, 0 }, { 720, 0, 3000, 60, 242 }, { 900, 0, 6000, 60, 303 },
+	{ 1080, 0, 9000, 60, 484 }, { 1260, 0, 9000, 120, 610 }, { 1440, 0, 6000, 120, 338 },
+	{ 1620, 0, 3000, 120, 139 }
+};
+
+static const struct ndlTts air30m20minVpmbNdlTts[] = {
+	{ 0, 0, 0, 0, 0 }, { 180, 480, 0, 0, 0 }, { 360, 300, 0, 0, 0 },
+	{ 540, 120, 0, 0, 0 }, { 720, 0, 0, 0, 181 }, { 900, 0, 3000, 60, 242 },
+	{ 1080, 0, 3000, 180, 362 }, { 1260, 0, 3000, 240, 368 }, { 1440, 0, 3000, 180, 199 },
+	{ 1620, 7200, 0, 0, 0 }
+};
+
+static const struct ndlTts tx60m30minBuehlmannNdlTts[] = {
+	{ 0, 0, 0, 0, 0 }, { 180, 0, 9000, 60, 605 }, { 360, 0, 15000, 60, 1327 },
+	{ 540, 0, 21000, 60, 2588 }, { 720, 0, 24000, 60, 4149 }, { 900, 0, 27000, 60, 6010 },
+	{ 1080, 0, 27000, 120, 7251 }, { 1260, 0, 30000, 60, 7252 }, { 1440, 0, 30000, 120, 7252 },
+	{ 1620, 0, 33000, 60, 7234 }, { 1800, 0, 33000, 60, 7234 }, { 1980, 0, 33000, 60, 7210 },
+	{ 2160, 0, 30000, 60, 7232 }, { 2340, 0, 27000, 60, 7213 }, { 2520, 0, 24000, 60, 4472 },
+	{ 2700, 0, 18000, 180, 4254 }, { 2880, 0, 15000, 240, 4055 }, { 3060, 0, 15000, 60, 3875 },
+	{ 3240, 0, 12000, 300, 3676 }, { 3420, 0, 12000, 60, 3496 }, { 3600, 0, 9000, 480, 3297 },
+	{ 3780, 0, 9000, 300, 3117 }, { 3960, 0, 9000, 120, 2937 }, { 4140, 0, 6000, 840, 2738 },
+	{ 4320, 0, 6000, 660, 2558 }, { 4500, 0, 6000, 480, 2318 }, { 4680, 0, 6000, 300, 2138 },
+	{ 4860, 0, 6000, 60, 1958 }, { 5040, 0, 3000, 1740, 1759 }, { 5220, 0, 3000, 1560, 1579 }
+};
+
+static const struct ndlTts tx60m30minVpmbNdlTts[] = {
+	{ 0, 0, 0, 0, 0 }, { 180, 0, 12000, 60, 726 }, { 360, 0, 21000, 60, 1388 },
+	{ 540, 0, 24000, 60, 2049 }, { 720, 0, 27000, 60, 2770 }, { 900, 0, 30000, 60, 3371 },
+	{ 1080, 0, 30000, 60, 4091 }, { 1260, 0, 30000, 60, 4751 }, { 1440, 0, 33000, 60, 5472 },
+	{ 1620, 0, 33000, 60, 6132 }, { 1800, 0, 33000, 60, 6852 }, { 1980, 0, 33000, 60, 6828 },
+	{ 2160, 0, 27000, 120, 6670 }, { 2340, 0, 24000, 120, 6452 }, { 2520, 0, 21000, 60, 2833 },
+	{ 2700, 0, 18000, 60, 2634 }, { 2880, 0, 15000, 60, 2435 }, { 3060, 0, 12000, 120, 2236 },
+	{ 3240, 0, 9000, 360, 2116 }, { 3420, 0, 9000, 180, 1917 }, { 3600, 0, 6000, 600, 1737 },
+	{ 3780, 0, 6000, 420, 1538 }, { 3960, 0, 6000, 240, 1358 }, { 4140, 0, 6000, 60, 1178 },
+	{ 4320, 0, 3000, 960, 998 }, { 4500, 0, 3000, 840, 859 }, { 4680, 0, 3000, 660, 679 },
+	{ 4860, 0, 3000, 480, 499 }, { 5040, 0, 3000, 300, 319 }, { 5220, 0, 3000, 120, 139 }
+};
+
+template <size_t N>
+static void compareNdlTts(enum deco_mode mode, const struct ndlTts (&expected)[N])
+{
+	struct plot_info pi;
+
+	setAppState(ApplicationState::Default);
+	prefs.display_deco_mode = mode;
+	prefs.calcndltts = true;
+	init_plot_info(&pi);
+	create_plot_info_new(&displayed_dive, &displayed_dive.dc, &pi, PLOT_DECO, nullptr);
+	int i = 0;
+	for (size_t j = 0; j < N; j++) {
+		// the last entry at the time
+		while (i + 1 < pi.nr && pi.entry[i + 1].sec <= expected[j].sec)
+			i++;
+		QCOMPARE(pi.entry[i].ndl_calc, expected[j].ndl);
+		QCOMPARE(pi.entry[i].stopdepth_calc, expected[j].stopdepth);
+		QCOMPARE(pi.entry[i].stoptime_calc, expected[j].stoptime);
+		QCOMPARE(pi.entry[i].tts_calc, expected[j].tts);
+	}
+	free_plot_info_data(&pi);
+}
+
+void TestPlan::testNdlTtsAir30m20min()
+{
+	struct deco_state *cache = NULL;
+	struct diveplan testPlan = {};
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+	setupPlanVpmb30m20min(&testPlan);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+	free_dps(&testPlan);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 1640);
+
+	compareNdlTts(BUEHLMANN, air30m20minBuehlmannNdlTts);
+	compareNdlTts(VPMB, air30m20minVpmbNdlTts);
+}
+
+void TestPlan::testNdlTtsTx60m30min()
+{
+	struct deco_state *cache = NULL;
+	struct diveplan testPlan = {};
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+	clear_dive(&displayed_dive);
+	setupPlanVpmb60m30minTx(&testPlan);
+	planWithPrefs(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+	free_dps(&testPlan);
+	QCOMPARE(displayed_dive.dc.duration.seconds, 5360);
+
+	compareNdlTts(BUEHLMANN, tx60m30minBuehlmannNdlTts);
+	compareNdlTts(VPMB, tx60m30minVpmbNdlTts);
+}
+
+void TestPlan::testPlanMatrix()
+{
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+
+	PlanMatrix matrix;
+	matrix.gradientFactors = { { 30, 70 }, { 50, 80 } };
+	matrix.vpmbConservatism = { 2 };
+	matrix.bottomGases = { { {180}, {450} }, { {210}, {350} } };
+	matrix.decoGases = { { { {500}, {0} }, { {1000}, {0} } }, { { {500}, {0} } } };
+	matrix.depths = { 60000, 80000 };
+	matrix.bottomTimes = { 20 * 60, 30 * 60 };
+
+	std::vector<PlanMatrixResult> results = plannerShared::computePlanMatrix(matrix);
+	QCOMPARE(results.size(), (size_t)3 * 2 * 2 * 2 * 2);
+
+	// The results are ordered by deco model, bottom gas, deco gases, depth and bottom time
+	QCOMPARE(results[0].decoMode, BUEHLMANN);
+	QCOMPARE(results[0].gflow, 30);
+	QCOMPARE(results[0].gfhigh, 70);
+	QCOMPARE(results[1].bottomTime, 30 * 60);
+	QCOMPARE(results[2].depth, 80000);
+	QCOMPARE(results[4].decoGases, 1);
+	QCOMPARE(results[8].bottomGas, 1);
+	QCOMPARE(results[16].gflow, 50);
+	QCOMPARE(results[32].decoMode, VPMB);
+	QCOMPARE(results[32].vpmbConservatism, 2);
+
+	for (size_t i = 0; i < results.size(); i += 2) {
+		const PlanMatrixResult &shorter = results[i], &longer = results[i + 1];
+		QVERIFY(shorter.runtime > shorter.bottomTime);
+		QVERIFY(longer.runtime > shorter.runtime);
+		QCOMPARE(shorter.gasUsed.size(), matrix.decoGases[shorter.decoGases].size() + 1);
+		QVERIFY(longer.gasUsed[0] > shorter.gasUsed[0]);
+		QVERIFY(!shorter.stops.empty());
+		for (size_t j = 1; j < shorter.stops.size(); j++)
+			QVERIFY(shorter.stops[j].depth < shorter.stops[j - 1].depth);
+	}
+
+	// Fewer deco gases mean longer deco
+	QVERIFY(results[4].runtime > results[0].runtime);
+	// More conservative gradient factors mean longer deco
+	QVERIFY(results[0].runtime > results[16].runtime);
+
+	// A header and one line per plan
+	struct membuffer buf = {};
+	plannerShared::planMatrixToCSV(&buf, matrix, results);
+	QStringList lines = QString(mb_cstring(&buf)).split('\n', QString::SkipEmptyParts);
+	free_buffer(&buf);
+	QCOMPARE(lines.size(), (int)results.size() + 1);
+	QVERIFY(lines[0].startsWith("model,gf_low,gf_high,conservatism,bottom_gas,deco_gases,"));
+	QVERIFY(lines[1].startsWith("Buehlmann,30,70,,"));
+	QVERIFY(lines.last().startsWith("VPM-B,,,2,"));
+}
+
 QTEST_GUILESS_MAIN(TestPlan)
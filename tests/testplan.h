@@ -18,7 +18,23 @@ private slots:
 	void testVpmbMetricMultiLevelAir();
 	void testVpmbMetric100m10min();
 	void testVpmbMetricRepeat();
+	void testMetricRepeat();
 	void testMultipleGases();
+	void testAddSegmentKernel();
+	void testAddSegmentLinear();
+	void addSegmentReference();
+	void addSegmentOptimized();
+	void testStopTableVpmb100m60min();
+	void testStopTableCcr100m40min();
+	void testStopTableHeliox100m25min();
+	void testStopTableTrimix90m25min();
+	void benchmarkPlanVpmb100m60min();
+	void benchmarkPlanCcr100m40min();
+	void testCeilingCrossingTime();
+	void testCeilingAfterGasSwitch();
+	void testNdlTtsAir30m20min();
+	void testNdlTtsTx60m30min();
+	void testPlanMatrix();
 };
 
 #endif // TESTPLAN_H
@@ -1,12 +1,443 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testprofile.h"
+#include "core/deco.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
+#include "core/plotinfocache.h"
+#include "core/tissuecache.h"
 #include "core/trip.h"
 #include "core/file.h"
+#include "core/pref.h"
+#include "core/profile.h"
+#include <cstring>
+#include <vector>
+
+void TestProfile::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestProfile::cleanup()
+{
+	clear_dive_file_data();
+}
 
 void TestProfile::testRedCeiling()
 {
 	parse_file("../dives/deep.xml", &dive_table, &trip_table, &dive_site_table);
 }
 
+static bool sameTissues(const struct deco_state &ds1, const struct deco_state &ds2)
+{
+	return !memcmp(ds1.tissue_n2_sat, ds2.tissue_n2_sat, sizeof(ds1.tissue_n2_sat)) &&
+	       !memcmp(ds1.tissue_he_sat, ds2.tissue_he_sat, sizeof(ds1.tissue_he_sat)) &&
+	       !memcmp(ds1.tolerated_by_tissue, ds2.tolerated_by_tissue, sizeof(ds1.tolerated_by_tissue));
+}
+
+// Replay the previous dives without the help of the tissue cache
+static int initDecompressionUncached(struct deco_state *ds, struct dive *d)
+{
+	clear_tissue_cache();
+	init_deco_config(&ds->config, false);
+	return init_decompression(ds, d);
+}
+
+void TestProfile::testTissueCache()
+{
+	// Contains several days with repetitive dives
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	sort_dive_table(&dive_table);
+	int nr = dive_table.nr;
+	QVERIFY(nr > 4);
+
+	std::vector<deco_state> reference(nr);
+	std::vector<int> surfaceTime(nr);
+	for (int i = 0; i < nr; ++i)
+		surfaceTime[i] = initDecompressionUncached(&reference[i], get_dive(i));
+
+	// Forwards, every dive starts from the cached state of its predecessor.
+	// Backwards, the first calculation fills the cache for all others.
+	for (int backwards = 0; backwards < 2; ++backwards) {
+		clear_tissue_cache();
+		for (int j = 0; j < nr; ++j) {
+			int i = backwards ? nr - 1 - j : j;
+			struct deco_state ds = {};
+			init_deco_config(&ds.config, false);
+			QCOMPARE(init_decompression(&ds, get_dive(i)), surfaceTime[i]);
+			QVERIFY(sameTissues(ds, reference[i]));
+		}
+	}
+
+	// Deepen the second dive of the log: the third dive must see the change
+	struct dive *d = get_dive(1);
+	QVERIFY(get_dive(2)->when - dive_endtime(d) < 48 * 60 * 60);
+	unshare_samples(&d->dc);
+	for (int i = 0; i < d->dc.samples; ++i)
+		d->dc.sample[i].depth.mm *= 2;
+	invalidate_dive_cache(d);
+
+	struct deco_state cached = {}, uncached = {};
+	init_deco_config(&cached.config, false);
+	init_decompression(&cached, get_dive(2));
+	initDecompressionUncached(&uncached, get_dive(2));
+	QVERIFY(sameTissues(cached, uncached));
+	QVERIFY(!sameTissues(cached, reference[2]));
+}
+
+static bool hasSampleCns(const struct dive *d)
+{
+	for (int i = 0; i < d->dc.samples; ++i) {
+		if (get_sample(&d->dc, i).cns)
+			return true;
+	}
+	return false;
+}
+
+void TestProfile::testDerivedDiveData()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	sort_dive_table(&dive_table);
+	int nr = dive_table.nr;
+
+	// Calculate the data of every dive on its own. The CNS is only
+	// calculated for dives where the dive computer didn't record it.
+	std::vector<deco_state> reference(nr);
+	std::vector<int> sac(nr), otu(nr), cns(nr), maxcns(nr);
+	for (int i = 0; i < nr; ++i) {
+		struct dive *d = get_dive(i);
+		initDecompressionUncached(&reference[i], d);
+		clear_tissue_cache();
+		if (!hasSampleCns(d))
+			d->cns = d->maxcns = 0;
+		update_cylinder_related_info(d);
+		sac[i] = d->sac;
+		otu[i] = d->otu;
+		cns[i] = d->cns;
+		maxcns[i] = d->maxcns;
+	}
+
+	clear_tissue_cache();
+	for (int i = 0; i < nr; ++i) {
+		struct dive *d = get_dive(i);
+		d->sac = d->otu = 0;
+		if (!hasSampleCns(d))
+			d->cns = d->maxcns = 0;
+	}
+	update_all_derived_dive_data();
+
+	for (int i = 0; i < nr; ++i) {
+		struct dive *d = get_dive(i);
+		QCOMPARE(d->sac, sac[i]);
+		QCOMPARE(d->otu, otu[i]);
+		QCOMPARE(d->cns, cns[i]);
+		QCOMPARE(d->maxcns, maxcns[i]);
+
+		// The tissues come from the cache filled by the batch pass
+		struct deco_state ds = {};
+		init_deco_config(&ds.config, false);
+		init_decompression(&ds, d);
+		QVERIFY(sameTissues(ds, reference[i]));
+	}
+}
+
+struct VpmbProfile {
+	std::vector<plot_data> entries;
+	std::vector<plot_deco_data> deco;
+};
+
+static VpmbProfile vpmbProfile(struct dive *d, bool calcndltts)
+{
+	prefs.calcndltts = calcndltts;
+	struct plot_info pi;
+	init_plot_info(&pi);
+	create_plot_info_new(d, &d->dc, &pi, PLOT_DECO, nullptr);
+	VpmbProfile res;
+	res.entries.assign(pi.entry, pi.entry + pi.nr);
+	res.deco.assign(pi.deco, pi.deco + pi.nr);
+	free_plot_info_data(&pi);
+	return res;
+}
+
+void TestProfile::testVpmbNdlTts()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	prefs.display_deco_mode = VPMB;
+
+	// The CVA iterations skip the NDL/TTS of all but the last data point
+	// and the converged iteration is replayed to calculate them. This must
+	// not change the ceilings, nor the TTS of the last data point.
+	bool hasNdlTts = false;
+	for (int i = 0; i < dive_table.nr; ++i) {
+		struct dive *d = get_dive(i);
+		VpmbProfile without = vpmbProfile(d, false);
+		VpmbProfile with = vpmbProfile(d, true);
+		QCOMPARE(with.entries.size(), without.entries.size());
+		for (size_t j = 0; j < with.entries.size(); ++j) {
+			QCOMPARE(with.entries[j].ceiling, without.entries[j].ceiling);
+			QVERIFY(!memcmp(with.deco[j].ceilings, without.deco[j].ceilings, sizeof(with.deco[j].ceilings)));
+			if (j + 1 < with.entries.size() && (with.entries[j].ndl_calc || with.entries[j].tts_calc))
+				hasNdlTts = true;
+		}
+		if (!with.entries.empty())
+			QCOMPARE(with.entries.back().tts_calc, without.entries.back().tts_calc);
+	}
+	QVERIFY(hasNdlTts);
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestProfile::testVpmbNdlTtsReference()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	prefs.display_deco_mode = VPMB;
+
+	// Sums of ndl, tts, stoptime and stopdepth and number of entries in deco, per dive.
+	// Calculated by running the NDL/TTS in every CVA iteration, as before the replay
+	// of the converged iteration, but resetting the results of the previous iteration.
+	// The TTS is the same without the reset; the other values of entries that were in
+	// deco in an earlier iteration only were left over from that iteration.
+	struct NdlTtsSums {
+		long ndl, tts, stoptime, stopdepth, in_deco;
+	};
+	static const NdlTtsSums expected[] = {
+		{ 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0 },
+		{ 2760660, 0, 0, 0, 0 },
+		{ 764520, 0, 0, 0, 0 },
+		{ 2156940, 0, 0, 0, 0 },
+		{ 2630340, 0, 0, 0, 0 },
+		{ 2234040, 0, 0, 0, 0 },
+		{ 1326600, 142457, 25080, 1941000, 43 },
+		{ 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0 },
+		{ 758460, 502183, 124620, 4428000, 111 },
+		{ 322920, 447752, 111000, 4089000, 109 },
+		{ 194400, 669830, 102840, 5742000, 109 },
+		{ 456120, 296298, 84180, 2877000, 92 },
+		{ 3377940, 0, 0, 0, 0 },
+		{ 4628400, 0, 0, 0, 0 },
+		{ 4514400, 0, 0, 0, 0 },
+		{ 1111680, 47574, 0, 0, 64 },
+		{ 3299580, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0 },
+		{ 4483680, 0, 0, 0, 0 },
+		{ 6273600, 0, 0, 0, 0 },
+		{ 3652380, 0, 0, 0, 0 },
+		{ 3803820, 0, 0, 0, 0 },
+		{ 3897000, 0, 0, 0, 0 },
+		{ 2628000, 149357, 32520, 1896000, 27 },
+		{ 0, 0, 0, 0, 0 }
+	};
+	QCOMPARE(dive_table.nr, (int)(sizeof(expected) / sizeof(expected[0])));
+	for (int i = 0; i < dive_table.nr; ++i) {
+		VpmbProfile profile = vpmbProfile(get_dive(i), true);
+		NdlTtsSums sums = { 0, 0, 0, 0, 0 };
+		for (const plot_data &entry: profile.entries) {
+			sums.ndl += entry.ndl_calc;
+			sums.tts += entry.tts_calc;
+			sums.stoptime += entry.stoptime_calc;
+			sums.stopdepth += entry.stopdepth_calc;
+			sums.in_deco += entry.in_deco_calc;
+		}
+		QCOMPARE(sums.ndl, expected[i].ndl);
+		QCOMPARE(sums.tts, expected[i].tts);
+		QCOMPARE(sums.stoptime, expected[i].stoptime);
+		QCOMPARE(sums.stopdepth, expected[i].stopdepth);
+		QCOMPARE(sums.in_deco, expected[i].in_deco);
+	}
+	copy_prefs(&default_prefs, &prefs);
+}
+
+static bool samePlotInfo(const struct plot_info &pi1, const struct plot_info &pi2)
+{
+	return pi1.nr == pi2.nr && pi1.channels == pi2.channels &&
+	       !memcmp(pi1.entry, pi2.entry, pi1.nr * sizeof(struct plot_data)) &&
+	       !memcmp(pi1.deco, pi2.deco, pi1.nr * sizeof(struct plot_deco_data)) &&
+	       !memcmp(pi1.gas, pi2.gas, pi1.nr * sizeof(struct plot_gas_data));
+}
+
+void TestProfile::testPlotInfoCache()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	sort_dive_table(&dive_table);
+	QVERIFY(dive_table.nr > 2);
+	clear_plot_info_cache();
+	int hits0, misses0;
+	get_plot_info_cache_stats(&hits0, &misses0);
+
+	struct dive *d = get_dive(2);
+	struct plot_info pi, cached;
+	init_plot_info(&pi);
+	init_plot_info(&cached);
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+	create_plot_info_new(d, &d->dc, &pi, PLOT_DECO | PLOT_GAS, nullptr);
+	cache_plot_info(d, 0, &pi);
+
+	// Only the same dive computer and channels that were calculated are found
+	QVERIFY(get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+	QVERIFY(samePlotInfo(pi, cached));
+	QVERIFY(cached.dive == d && cached.dc == &d->dc);
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 1, PLOT_DECO, &cached));
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 0, PLOT_PRESSURE, &cached));
+
+	// Different deco settings need a new calculation
+	prefs.gflow += 5;
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+	prefs.gflow -= 5;
+	QVERIFY(get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+
+	// The TTS depends on the ascent rates
+	prefs.ascratestops += 1;
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+	prefs.ascratestops -= 1;
+
+	int hits, misses;
+	get_plot_info_cache_stats(&hits, &misses);
+	QCOMPARE(hits - hits0, 2);
+	QCOMPARE(misses - misses0, 5);
+
+	// Editing a previous dive changes the tissues and therefore the profile
+	invalidate_dive_cache(get_dive(1));
+	QVERIFY(!get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+	cache_plot_info(d, 0, &pi);
+	invalidate_dive_cache(get_dive(3));
+	QVERIFY(get_cached_plot_info(d, &d->dc, 0, PLOT_DECO, &cached));
+
+	free_plot_info_data(&pi);
+	free_plot_info_data(&cached);
+	clear_plot_info_cache();
+}
+
+// The straightforward min/max search, which scans the whole 9 minute
+// interval around every entry, as reference for analyze_plot_info()
+static void minMaxReference(const struct plot_info &pi, int idx, int &min, int &max)
+{
+	int start = pi.entry[idx].sec - 9 * 30, end = pi.entry[idx].sec + 9 * 30;
+	while (idx > 0 && pi.entry[idx - 1].sec >= start)
+		idx--;
+	min = max = idx;
+	for (; idx < pi.nr && pi.entry[idx].sec <= end; idx++) {
+		if (pi.entry[idx].depth < pi.entry[min].depth)
+			min = idx;
+		if (pi.entry[idx].depth > pi.entry[max].depth)
+			max = idx;
+	}
+}
+
+void TestProfile::testAnalyzePlotInfo()
+{
+	const char *files[] = {
+		"/dives/SampleDivesV2.ssrf", "/dives/DL7.xml", "/dives/mergedVyperOstc.xml",
+		"/dives/ostc.xml", "/dives/sac-test.xml", "/dives/tank_pressure.xml", "/dives/TestDiveDM5.xml"
+	};
+	int entries = 0;
+	for (const char *file: files) {
+		QCOMPARE(parse_file(qPrintable(SUBSURFACE_TEST_DATA + QString(file)), &dive_table, &trip_table, &dive_site_table), 0);
+		for (int i = 0; i < dive_table.nr; ++i) {
+			struct dive *d = get_dive(i);
+			for (struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+				struct plot_info pi;
+				init_plot_info(&pi);
+				create_plot_info_new(d, dc, &pi, 0, nullptr);
+				for (int j = 0; j < pi.nr; ++j) {
+					int min, max;
+					minMaxReference(pi, j, min, max);
+					QCOMPARE(pi.entry[j].min, min);
+					QCOMPARE(pi.entry[j].max, max);
+				}
+
+				// The analysis must not depend on the previously calculated data
+				std::vector<plot_data> analyzed(pi.entry, pi.entry + pi.nr);
+				for (int j = 0; j < pi.nr; ++j) {
+					pi.entry[j].min = pi.entry[j].max = -1;
+					pi.entry[j].speed = pi.entry[j].smoothed = 0;
+				}
+				analyze_plot_info(&pi);
+				QVERIFY(!memcmp(analyzed.data(), pi.entry, pi.nr * sizeof(struct plot_data)));
+				entries += pi.nr;
+				free_plot_info_data(&pi);
+			}
+		}
+		clear_dive_file_data();
+	}
+	QVERIFY(entries > 0);
+}
+
+void TestProfile::testInterpolatedPressures()
+{
+	// Number, sum and time weighted sum of the interpolated pressures, per dive, dive
+	// computer and cylinder. Calculated by the interpolation that followed the pressure
+	// segments in a linked list, one cylinder after the other. cylinder_pressures.xml
+	// contains a CCR dive with an open circuit bailout and a sidemount dive.
+	struct PressureSums {
+		int dive, dc, cylinder, entries;
+		long long sum, moment;
+	};
+	static const PressureSums tankPressure[] = {
+		{ 0, 0, 0, 47, 3900547, 1094540480 },
+		{ 0, 0, 1, 121, 15803912, 12184372280 }
+	};
+	static const PressureSums sacTest[] = {
+		{ 0, 0, 0, 153, 23252160, 15426691600 },
+		{ 1, 0, 0, 153, 23248350, 15142756260 },
+		{ 2, 0, 0, 104, 15937650, 6974896950 },
+		{ 2, 0, 1, 49, 7005005, 8673718210 },
+		{ 3, 0, 0, 134, 19193100, 10788607500 },
+		{ 3, 0, 1, 49, 7005005, 10775219710 },
+		{ 4, 0, 0, 0, 0, 0 }
+	};
+	static const PressureSums cylinderPressures[] = {
+		{ 0, 0, 0, 0, 0, 0 },
+		{ 0, 0, 1, 878, 162430000, 344838890000 },
+		{ 0, 0, 2, 0, 0, 0 },
+		{ 1, 0, 0, 181, 20084349, 20593174420 },
+		{ 1, 0, 1, 60, 12000000, 25172000000 }
+	};
+	const struct {
+		const char *file;
+		const PressureSums *expected;
+		size_t nr;
+	} files[] = {
+		{ "/dives/tank_pressure.xml", tankPressure, sizeof(tankPressure) / sizeof(tankPressure[0]) },
+		{ "/dives/sac-test.xml", sacTest, sizeof(sacTest) / sizeof(sacTest[0]) },
+		{ "/dives/cylinder_pressures.xml", cylinderPressures, sizeof(cylinderPressures) / sizeof(cylinderPressures[0]) }
+	};
+	for (const auto &file: files) {
+		QCOMPARE(parse_file(qPrintable(SUBSURFACE_TEST_DATA + QString(file.file)), &dive_table, &trip_table, &dive_site_table), 0);
+		size_t n = 0;
+		for (int i = 0; i < dive_table.nr; ++i) {
+			struct dive *d = get_dive(i);
+			int dcnr = 0;
+			for (struct divecomputer *dc = &d->dc; dc; dc = dc->next, ++dcnr) {
+				struct plot_info pi;
+				init_plot_info(&pi);
+				create_plot_info_new(d, dc, &pi, PLOT_PRESSURE, nullptr);
+				for (int cyl = 0; cyl < pi.nr_cylinders; ++cyl) {
+					PressureSums sums = { i, dcnr, cyl, 0, 0, 0 };
+					for (int j = 0; j < pi.nr; ++j) {
+						int pressure = get_plot_interpolated_pressure(&pi, j, cyl);
+						if (!pressure)
+							continue;
+						sums.entries++;
+						sums.sum += pressure;
+						sums.moment += (long long)pi.entry[j].sec * pressure;
+					}
+					QVERIFY(n < file.nr);
+					const PressureSums &expected = file.expected[n++];
+					QCOMPARE(sums.dive, expected.dive);
+					QCOMPARE(sums.dc, expected.dc);
+					QCOMPARE(sums.cylinder, expected.cylinder);
+					QCOMPARE(sums.entries, expected.entries);
+					QCOMPARE(sums.sum, expected.sum);
+					QCOMPARE(sums.moment, expected.moment);
+				}
+				free_plot_info_data(&pi);
+			}
+		}
+		QCOMPARE(n, file.nr);
+		clear_dive_file_data();
+	}
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
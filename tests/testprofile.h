@@ -8,7 +8,16 @@
 class TestProfile : public QObject {
 	Q_OBJECT
 private slots:
+	void initTestCase();
+	void cleanup();
 	void testRedCeiling();
+	void testTissueCache();
+	void testDerivedDiveData();
+	void testVpmbNdlTts();
+	void testVpmbNdlTtsReference();
+	void testPlotInfoCache();
+	void testAnalyzePlotInfo();
+	void testInterpolatedPressures();
 };
 
 #endif